@@ -1,11 +1,15 @@
 #include <math.h>
 #include <assert.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define HAVE_X86_KERNELS
+	#include <immintrin.h>
+#endif
 
 #include "Algebra.h"
 
 #define PI 3.14159265358979323846264338327950288
 
-GLfloat *Add3(GLfloat result[3], const GLfloat v1[3], const GLfloat v2[3])
+Scalar *Add3(Scalar result[3], const Scalar v1[3], const Scalar v2[3])
 {
 	for (unsigned i = 0; i < 3; ++i) {
 		result[i] = v1[i] + v2[i];
@@ -13,7 +17,7 @@ GLfloat *Add3(GLfloat result[3], const GLfloat v1[3], const GLfloat v2[3])
 	return result;
 }
 
-GLfloat *Scalar3(GLfloat result[3], GLfloat s, GLfloat v[3])
+Scalar *Scalar3(Scalar result[3], Scalar s, Scalar v[3])
 {
 	for (unsigned i = 0; i < 3; ++i) {
 		result[i] = s*v[i];
@@ -21,11 +25,11 @@ GLfloat *Scalar3(GLfloat result[3], GLfloat s, GLfloat v[3])
 	return result;
 }
 
-GLfloat *Saxpy3(
-	GLfloat       result[3],
-	const GLfloat v1[3],
-	GLfloat       s,
-	const GLfloat v2[3]
+Scalar *Saxpy3(
+	Scalar       result[3],
+	const Scalar v1[3],
+	Scalar       s,
+	const Scalar v2[3]
 )
 {
 	for (unsigned i = 0; i < 3; ++i) {
@@ -34,10 +38,10 @@ GLfloat *Saxpy3(
 	return result;
 }
 
-GLfloat *Cross3(
-	GLfloat       result[restrict 3],
-	const GLfloat v1[3],
-	const GLfloat v2[3])
+Scalar *Cross3(
+	Scalar       result[restrict 3],
+	const Scalar v1[3],
+	const Scalar v2[3])
 {
 	result[0] = v1[1]*v2[2] - v1[2]*v2[1];
 	result[1] = v1[2]*v2[0] - v1[0]*v2[2];
@@ -45,26 +49,600 @@ GLfloat *Cross3(
 	return result;
 }
 
-GLfloat Dot3(const GLfloat v1[3], const GLfloat v2[3])
+Scalar Dot3(const Scalar v1[3], const Scalar v2[3])
 {
 	return v1[0]*v2[0] + v1[1]*v2[1] + v1[2]*v2[2];
 }
 
-GLfloat Length3(const GLfloat v[3])
+Scalar Length3(const Scalar v[3])
 {
 	return sqrtf(Dot3(v, v));
 }
 
-GLfloat *Normalize3(GLfloat result[3], const GLfloat v[3])
+Scalar *Normalize3(Scalar result[3], const Scalar v[3])
 {
-	GLfloat length = Length3(v);
+	Scalar length = Length3(v);
 	for (unsigned i = 0; i < 3; ++i) {
 		result[i] = v[i]/length;
 	}
 	return result;
 }
 
-GLfloat Angle3(const GLfloat v1[3], const GLfloat v2[3])
+Scalar Angle3(const Scalar v1[3], const Scalar v2[3])
 {
 	return 180*acosf(Dot3(v1, v2) / (Length3(v1) * Length3(v2))) / PI;
 }
+
+Scalar *Heading3(Scalar result[2], const Scalar v[3])
+{
+	Scalar invLength = 1/sqrtf(v[0]*v[0] + v[2]*v[2]);
+	result[0] = v[0]*invLength;
+	result[1] = -v[2]*invLength;
+	return result;
+}
+
+Scalar *MulHeading(
+	Scalar       result[2],
+	const Scalar h1[2],
+	const Scalar h2[2])
+{
+	Scalar cosine = h1[0]*h2[0] - h1[1]*h2[1],
+	       sine   = h1[0]*h2[1] + h1[1]*h2[0];
+	result[0] = cosine;
+	result[1] = sine;
+	return result;
+}
+
+Scalar *HeadingMatrix(
+	Scalar       result[16],
+	const Scalar position[3],
+	const Scalar heading[2])
+{
+	Scalar cosine = heading[0], sine = heading[1];
+	result[0] = cosine;
+	result[1] = 0;
+	result[2] = -sine;
+	result[3] = 0;
+	result[4] = 0;
+	result[5] = 1;
+	result[6] = 0;
+	result[7] = 0;
+	result[8] = sine;
+	result[9] = 0;
+	result[10] = cosine;
+	result[11] = 0;
+	result[12] = position[0];
+	result[13] = position[1];
+	result[14] = position[2];
+	result[15] = 1;
+	return result;
+}
+
+Scalar *MulMatrix4(
+	Scalar       result[restrict 16],
+	const Scalar m1[16],
+	const Scalar m2[16])
+{
+	for (unsigned column = 0; column < 4; ++column) {
+		for (unsigned row = 0; row < 4; ++row) {
+			Scalar sum = 0;
+			for (unsigned i = 0; i < 4; ++i) {
+				sum += m1[i*4 + row] * m2[column*4 + i];
+			}
+			result[column*4 + row] = sum;
+		}
+	}
+	return result;
+}
+
+Scalar *TransformPoint3(
+	Scalar       result[restrict 3],
+	const Scalar m[16],
+	const Scalar v[3])
+{
+	for (unsigned row = 0; row < 3; ++row) {
+		result[row] = m[row]*v[0] + m[4 + row]*v[1] + m[8 + row]*v[2]
+		              + m[12 + row];
+	}
+	return result;
+}
+
+Scalar *TransformVector3(
+	Scalar       result[restrict 3],
+	const Scalar m[16],
+	const Scalar v[3])
+{
+	for (unsigned row = 0; row < 3; ++row) {
+		result[row] = m[row]*v[0] + m[4 + row]*v[1] + m[8 + row]*v[2];
+	}
+	return result;
+}
+
+// Portable kernels
+
+static void Add3N_portable(
+	Vec3Array result,
+	Vec3Array v1,
+	Vec3Array v2,
+	unsigned  n)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		result.x[i] = v1.x[i] + v2.x[i];
+		result.y[i] = v1.y[i] + v2.y[i];
+		result.z[i] = v1.z[i] + v2.z[i];
+	}
+}
+
+static void Saxpy3N_portable(
+	Vec3Array result,
+	Vec3Array v1,
+	Scalar    s,
+	Vec3Array v2,
+	unsigned  n)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		result.x[i] = v1.x[i] + s*v2.x[i];
+		result.y[i] = v1.y[i] + s*v2.y[i];
+		result.z[i] = v1.z[i] + s*v2.z[i];
+	}
+}
+
+static void Cross3N_portable(
+	Vec3Array result,
+	Vec3Array v1,
+	Vec3Array v2,
+	unsigned  n)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		result.x[i] = v1.y[i]*v2.z[i] - v1.z[i]*v2.y[i];
+		result.y[i] = v1.z[i]*v2.x[i] - v1.x[i]*v2.z[i];
+		result.z[i] = v1.x[i]*v2.y[i] - v1.y[i]*v2.x[i];
+	}
+}
+
+static void Dot3N_portable(
+	Scalar    result[],
+	Vec3Array v1,
+	Vec3Array v2,
+	unsigned  n)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		result[i] = v1.x[i]*v2.x[i] + v1.y[i]*v2.y[i] + v1.z[i]*v2.z[i];
+	}
+}
+
+static void Normalize3N_portable(Vec3Array result, Vec3Array v, unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		Scalar length = sqrtf(v.x[i]*v.x[i] + v.y[i]*v.y[i] + v.z[i]*v.z[i]);
+		result.x[i] = v.x[i]/length;
+		result.y[i] = v.y[i]/length;
+		result.z[i] = v.z[i]/length;
+	}
+}
+
+#ifdef HAVE_X86_KERNELS
+
+// SSE2 kernels: 4 vectors per iteration, portable kernel for the remainder
+
+#define SSE2 __attribute__((target("sse2")))
+
+SSE2 static void Add3N_sse2(
+	Vec3Array result,
+	Vec3Array v1,
+	Vec3Array v2,
+	unsigned  n)
+{
+	unsigned i = 0;
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(
+			&result.x[i],
+			_mm_add_ps(_mm_loadu_ps(&v1.x[i]), _mm_loadu_ps(&v2.x[i]))
+		);
+		_mm_storeu_ps(
+			&result.y[i],
+			_mm_add_ps(_mm_loadu_ps(&v1.y[i]), _mm_loadu_ps(&v2.y[i]))
+		);
+		_mm_storeu_ps(
+			&result.z[i],
+			_mm_add_ps(_mm_loadu_ps(&v1.z[i]), _mm_loadu_ps(&v2.z[i]))
+		);
+	}
+	Vec3Array r = {result.x+i, result.y+i, result.z+i},
+	          a = {v1.x+i, v1.y+i, v1.z+i},
+	          b = {v2.x+i, v2.y+i, v2.z+i};
+	Add3N_portable(r, a, b, n - i);
+}
+
+SSE2 static void Saxpy3N_sse2(
+	Vec3Array result,
+	Vec3Array v1,
+	Scalar    s,
+	Vec3Array v2,
+	unsigned  n)
+{
+	__m128 s4 = _mm_set1_ps(s);
+	unsigned i = 0;
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(
+			&result.x[i],
+			_mm_add_ps(
+				_mm_loadu_ps(&v1.x[i]),
+				_mm_mul_ps(s4, _mm_loadu_ps(&v2.x[i]))
+			)
+		);
+		_mm_storeu_ps(
+			&result.y[i],
+			_mm_add_ps(
+				_mm_loadu_ps(&v1.y[i]),
+				_mm_mul_ps(s4, _mm_loadu_ps(&v2.y[i]))
+			)
+		);
+		_mm_storeu_ps(
+			&result.z[i],
+			_mm_add_ps(
+				_mm_loadu_ps(&v1.z[i]),
+				_mm_mul_ps(s4, _mm_loadu_ps(&v2.z[i]))
+			)
+		);
+	}
+	Vec3Array r = {result.x+i, result.y+i, result.z+i},
+	          a = {v1.x+i, v1.y+i, v1.z+i},
+	          b = {v2.x+i, v2.y+i, v2.z+i};
+	Saxpy3N_portable(r, a, s, b, n - i);
+}
+
+SSE2 static void Cross3N_sse2(
+	Vec3Array result,
+	Vec3Array v1,
+	Vec3Array v2,
+	unsigned  n)
+{
+	unsigned i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 ax = _mm_loadu_ps(&v1.x[i]),
+		       ay = _mm_loadu_ps(&v1.y[i]),
+		       az = _mm_loadu_ps(&v1.z[i]),
+		       bx = _mm_loadu_ps(&v2.x[i]),
+		       by = _mm_loadu_ps(&v2.y[i]),
+		       bz = _mm_loadu_ps(&v2.z[i]);
+		_mm_storeu_ps(
+			&result.x[i],
+			_mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by))
+		);
+		_mm_storeu_ps(
+			&result.y[i],
+			_mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz))
+		);
+		_mm_storeu_ps(
+			&result.z[i],
+			_mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx))
+		);
+	}
+	Vec3Array r = {result.x+i, result.y+i, result.z+i},
+	          a = {v1.x+i, v1.y+i, v1.z+i},
+	          b = {v2.x+i, v2.y+i, v2.z+i};
+	Cross3N_portable(r, a, b, n - i);
+}
+
+SSE2 static void Dot3N_sse2(
+	Scalar    result[],
+	Vec3Array v1,
+	Vec3Array v2,
+	unsigned  n)
+{
+	unsigned i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 dot = _mm_mul_ps(_mm_loadu_ps(&v1.x[i]), _mm_loadu_ps(&v2.x[i]));
+		dot = _mm_add_ps(
+			dot,
+			_mm_mul_ps(_mm_loadu_ps(&v1.y[i]), _mm_loadu_ps(&v2.y[i]))
+		);
+		dot = _mm_add_ps(
+			dot,
+			_mm_mul_ps(_mm_loadu_ps(&v1.z[i]), _mm_loadu_ps(&v2.z[i]))
+		);
+		_mm_storeu_ps(&result[i], dot);
+	}
+	Vec3Array a = {v1.x+i, v1.y+i, v1.z+i},
+	          b = {v2.x+i, v2.y+i, v2.z+i};
+	Dot3N_portable(result + i, a, b, n - i);
+}
+
+SSE2 static void Normalize3N_sse2(Vec3Array result, Vec3Array v, unsigned n)
+{
+	unsigned i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 x = _mm_loadu_ps(&v.x[i]),
+		       y = _mm_loadu_ps(&v.y[i]),
+		       z = _mm_loadu_ps(&v.z[i]);
+		__m128 length = _mm_sqrt_ps(
+			_mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+				_mm_mul_ps(z, z)
+			)
+		);
+		_mm_storeu_ps(&result.x[i], _mm_div_ps(x, length));
+		_mm_storeu_ps(&result.y[i], _mm_div_ps(y, length));
+		_mm_storeu_ps(&result.z[i], _mm_div_ps(z, length));
+	}
+	Vec3Array r = {result.x+i, result.y+i, result.z+i},
+	          a = {v.x+i, v.y+i, v.z+i};
+	Normalize3N_portable(r, a, n - i);
+}
+
+// AVX2 kernels: 8 vectors per iteration, SSE2 kernel for the remainder
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static void Add3N_avx2(
+	Vec3Array result,
+	Vec3Array v1,
+	Vec3Array v2,
+	unsigned  n)
+{
+	unsigned i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(
+			&result.x[i],
+			_mm256_add_ps(_mm256_loadu_ps(&v1.x[i]), _mm256_loadu_ps(&v2.x[i]))
+		);
+		_mm256_storeu_ps(
+			&result.y[i],
+			_mm256_add_ps(_mm256_loadu_ps(&v1.y[i]), _mm256_loadu_ps(&v2.y[i]))
+		);
+		_mm256_storeu_ps(
+			&result.z[i],
+			_mm256_add_ps(_mm256_loadu_ps(&v1.z[i]), _mm256_loadu_ps(&v2.z[i]))
+		);
+	}
+	Vec3Array r = {result.x+i, result.y+i, result.z+i},
+	          a = {v1.x+i, v1.y+i, v1.z+i},
+	          b = {v2.x+i, v2.y+i, v2.z+i};
+	Add3N_sse2(r, a, b, n - i);
+}
+
+AVX2 static void Saxpy3N_avx2(
+	Vec3Array result,
+	Vec3Array v1,
+	Scalar    s,
+	Vec3Array v2,
+	unsigned  n)
+{
+	__m256 s8 = _mm256_set1_ps(s);
+	unsigned i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(
+			&result.x[i],
+			_mm256_add_ps(
+				_mm256_loadu_ps(&v1.x[i]),
+				_mm256_mul_ps(s8, _mm256_loadu_ps(&v2.x[i]))
+			)
+		);
+		_mm256_storeu_ps(
+			&result.y[i],
+			_mm256_add_ps(
+				_mm256_loadu_ps(&v1.y[i]),
+				_mm256_mul_ps(s8, _mm256_loadu_ps(&v2.y[i]))
+			)
+		);
+		_mm256_storeu_ps(
+			&result.z[i],
+			_mm256_add_ps(
+				_mm256_loadu_ps(&v1.z[i]),
+				_mm256_mul_ps(s8, _mm256_loadu_ps(&v2.z[i]))
+			)
+		);
+	}
+	Vec3Array r = {result.x+i, result.y+i, result.z+i},
+	          a = {v1.x+i, v1.y+i, v1.z+i},
+	          b = {v2.x+i, v2.y+i, v2.z+i};
+	Saxpy3N_sse2(r, a, s, b, n - i);
+}
+
+AVX2 static void Cross3N_avx2(
+	Vec3Array result,
+	Vec3Array v1,
+	Vec3Array v2,
+	unsigned  n)
+{
+	unsigned i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 ax = _mm256_loadu_ps(&v1.x[i]),
+		       ay = _mm256_loadu_ps(&v1.y[i]),
+		       az = _mm256_loadu_ps(&v1.z[i]),
+		       bx = _mm256_loadu_ps(&v2.x[i]),
+		       by = _mm256_loadu_ps(&v2.y[i]),
+		       bz = _mm256_loadu_ps(&v2.z[i]);
+		_mm256_storeu_ps(
+			&result.x[i],
+			_mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by))
+		);
+		_mm256_storeu_ps(
+			&result.y[i],
+			_mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(ax, bz))
+		);
+		_mm256_storeu_ps(
+			&result.z[i],
+			_mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx))
+		);
+	}
+	Vec3Array r = {result.x+i, result.y+i, result.z+i},
+	          a = {v1.x+i, v1.y+i, v1.z+i},
+	          b = {v2.x+i, v2.y+i, v2.z+i};
+	Cross3N_sse2(r, a, b, n - i);
+}
+
+AVX2 static void Dot3N_avx2(
+	Scalar    result[],
+	Vec3Array v1,
+	Vec3Array v2,
+	unsigned  n)
+{
+	unsigned i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 dot = _mm256_mul_ps(
+			_mm256_loadu_ps(&v1.x[i]),
+			_mm256_loadu_ps(&v2.x[i])
+		);
+		dot = _mm256_add_ps(
+			dot,
+			_mm256_mul_ps(_mm256_loadu_ps(&v1.y[i]), _mm256_loadu_ps(&v2.y[i]))
+		);
+		dot = _mm256_add_ps(
+			dot,
+			_mm256_mul_ps(_mm256_loadu_ps(&v1.z[i]), _mm256_loadu_ps(&v2.z[i]))
+		);
+		_mm256_storeu_ps(&result[i], dot);
+	}
+	Vec3Array a = {v1.x+i, v1.y+i, v1.z+i},
+	          b = {v2.x+i, v2.y+i, v2.z+i};
+	Dot3N_sse2(result + i, a, b, n - i);
+}
+
+AVX2 static void Normalize3N_avx2(Vec3Array result, Vec3Array v, unsigned n)
+{
+	unsigned i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 x = _mm256_loadu_ps(&v.x[i]),
+		       y = _mm256_loadu_ps(&v.y[i]),
+		       z = _mm256_loadu_ps(&v.z[i]);
+		__m256 length = _mm256_sqrt_ps(
+			_mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)),
+				_mm256_mul_ps(z, z)
+			)
+		);
+		_mm256_storeu_ps(&result.x[i], _mm256_div_ps(x, length));
+		_mm256_storeu_ps(&result.y[i], _mm256_div_ps(y, length));
+		_mm256_storeu_ps(&result.z[i], _mm256_div_ps(z, length));
+	}
+	Vec3Array r = {result.x+i, result.y+i, result.z+i},
+	          a = {v.x+i, v.y+i, v.z+i};
+	Normalize3N_sse2(r, a, n - i);
+}
+
+#endif // x86 kernels
+
+// Kernel dispatch
+
+typedef struct {
+	const char *name;
+	void       (*add3N)(Vec3Array, Vec3Array, Vec3Array, unsigned);
+	void       (*saxpy3N)(Vec3Array, Vec3Array, Scalar, Vec3Array, unsigned);
+	void       (*cross3N)(Vec3Array, Vec3Array, Vec3Array, unsigned);
+	void       (*dot3N)(Scalar [], Vec3Array, Vec3Array, unsigned);
+	void       (*normalize3N)(Vec3Array, Vec3Array, unsigned);
+} Kernels;
+
+static const Kernels kernelSets[AlgebraKernels_nKernels] = {
+	[AlgebraKernels_portable] = {
+		"portable",
+		Add3N_portable,
+		Saxpy3N_portable,
+		Cross3N_portable,
+		Dot3N_portable,
+		Normalize3N_portable
+	},
+#ifdef HAVE_X86_KERNELS
+	[AlgebraKernels_sse2] = {
+		"sse2",
+		Add3N_sse2,
+		Saxpy3N_sse2,
+		Cross3N_sse2,
+		Dot3N_sse2,
+		Normalize3N_sse2
+	},
+	[AlgebraKernels_avx2] = {
+		"avx2",
+		Add3N_avx2,
+		Saxpy3N_avx2,
+		Cross3N_avx2,
+		Dot3N_avx2,
+		Normalize3N_avx2
+	}
+#else
+	[AlgebraKernels_sse2] = {"sse2"},
+	[AlgebraKernels_avx2] = {"avx2"}
+#endif
+};
+
+static const Kernels *kernels = NULL;
+
+static bool IsSupported(unsigned kernelsId)
+{
+	switch (kernelsId) {
+	case AlgebraKernels_portable:
+		return true;
+#ifdef HAVE_X86_KERNELS
+	case AlgebraKernels_sse2:
+		return __builtin_cpu_supports("sse2");
+	case AlgebraKernels_avx2:
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return false;
+	}
+}
+
+unsigned Algebra_GetBestKernels(void)
+{
+	unsigned best = AlgebraKernels_nKernels;
+	do {
+		--best;
+	} while (!IsSupported(best));
+	return best;
+}
+
+bool Algebra_SetKernels(unsigned kernelsId)
+{
+	if (!IsSupported(kernelsId)) {
+		return false;
+	}
+	kernels = &kernelSets[kernelsId];
+	return true;
+}
+
+const char *Algebra_GetKernelsName(unsigned kernelsId)
+{
+	assert(kernelsId < AlgebraKernels_nKernels);
+	return kernelSets[kernelsId].name;
+}
+
+static const Kernels *GetKernels(void)
+{
+	if (!kernels) {
+		Algebra_SetKernels(Algebra_GetBestKernels());
+	}
+	return kernels;
+}
+
+void Add3N(Vec3Array result, Vec3Array v1, Vec3Array v2, unsigned n)
+{
+	GetKernels()->add3N(result, v1, v2, n);
+}
+
+void Saxpy3N(
+	Vec3Array result,
+	Vec3Array v1,
+	Scalar    s,
+	Vec3Array v2,
+	unsigned  n)
+{
+	GetKernels()->saxpy3N(result, v1, s, v2, n);
+}
+
+void Cross3N(Vec3Array result, Vec3Array v1, Vec3Array v2, unsigned n)
+{
+	GetKernels()->cross3N(result, v1, v2, n);
+}
+
+void Dot3N(Scalar result[], Vec3Array v1, Vec3Array v2, unsigned n)
+{
+	GetKernels()->dot3N(result, v1, v2, n);
+}
+
+void Normalize3N(Vec3Array result, Vec3Array v, unsigned n)
+{
+	GetKernels()->normalize3N(result, v, n);
+}
@@ -1,39 +1,128 @@
 #ifndef ALGEBRA_H_INCLUDED
 #define ALGEBRA_H_INCLUDED
 
-#include <GL/gl.h>
+#include <stdbool.h>
+#include "Scalar.h"
 
 // Calculates result of adding vectors
-GLfloat *Add3(GLfloat result[3], const GLfloat v1[3], const GLfloat v2[3]);
+Scalar *Add3(Scalar result[3], const Scalar v1[3], const Scalar v2[3]);
 
 // Calculates result of multiplying vector by a scalar
-GLfloat *Scalar3(GLfloat result[3], GLfloat s, GLfloat v[3]);
+Scalar *Scalar3(Scalar result[3], Scalar s, Scalar v[3]);
 
 // Performs: result = v1 + s*v2
-GLfloat *Saxpy3(
-	GLfloat       result[3],
-	const GLfloat v1[3],
-	GLfloat       s,
-	const GLfloat v2[3]
+Scalar *Saxpy3(
+	Scalar       result[3],
+	const Scalar v1[3],
+	Scalar       s,
+	const Scalar v2[3]
 );
 
 // Calculate cross product of given vectors in parameter order
-GLfloat *Cross3(
-	GLfloat       result[restrict 3],
-	const GLfloat v1[3],
-	const GLfloat v2[3]
+Scalar *Cross3(
+	Scalar       result[restrict 3],
+	const Scalar v1[3],
+	const Scalar v2[3]
 );
 
 // Calculate dot product of given vectors
-GLfloat Dot3(const GLfloat v1[3], const GLfloat v2[3]);
+Scalar Dot3(const Scalar v1[3], const Scalar v2[3]);
 
 // Calculate length of vector
-GLfloat Length3(const GLfloat v[3]);
+Scalar Length3(const Scalar v[3]);
 
 // Calculate unit vector with same direction
-GLfloat *Normalize3(GLfloat result[3], const GLfloat v[3]);
+Scalar *Normalize3(Scalar result[3], const Scalar v[3]);
 
 // Calculate angle in arc from v1 to v2
-GLfloat Angle3(const GLfloat v1[3], const GLfloat v2[3]);
+Scalar Angle3(const Scalar v1[3], const Scalar v2[3]);
+
+// Headings are rotations about the y axis from the x axis, anticlockwise when
+// looking down, stored as unit complex numbers {cosine, sine}
+
+// Calculates heading of vector, projected on the x-z plane
+Scalar *Heading3(Scalar result[2], const Scalar v[3]);
+
+// Calculates heading rotating by h1 then h2
+Scalar *MulHeading(
+	Scalar       result[2],
+	const Scalar h1[2],
+	const Scalar h2[2]
+);
+
+// Calculates column-major matrix rotating by heading, then translating to
+// position, e.g. for glMultMatrixf()
+Scalar *HeadingMatrix(
+	Scalar       result[16],
+	const Scalar position[3],
+	const Scalar heading[2]
+);
+
+// Calculates column-major matrix product m1*m2, applying m2 first
+Scalar *MulMatrix4(
+	Scalar       result[restrict 16],
+	const Scalar m1[16],
+	const Scalar m2[16]
+);
+
+// Calculates position transformed by column-major matrix
+Scalar *TransformPoint3(
+	Scalar       result[restrict 3],
+	const Scalar m[16],
+	const Scalar v[3]
+);
+
+// Calculates direction transformed by column-major matrix, ignoring
+// translation
+Scalar *TransformVector3(
+	Scalar       result[restrict 3],
+	const Scalar m[16],
+	const Scalar v[3]
+);
+
+// Batched operations over n vectors stored as a structure of arrays, vector i
+// being (x[i], y[i], z[i]). Results may alias inputs unless marked otherwise.
+typedef struct {
+	Scalar *x, *y, *z;
+} Vec3Array;
+
+// Implementations of batched operations, selectable at run time
+enum {
+	AlgebraKernels_portable,
+	AlgebraKernels_sse2,
+	AlgebraKernels_avx2,
+	AlgebraKernels_nKernels
+};
+
+// Gets the fastest kernels supported by the running CPU
+unsigned Algebra_GetBestKernels(void);
+
+// Selects kernels used by batched operations, false if CPU doesn't support
+// them. Best supported kernels are used if this isn't called.
+bool Algebra_SetKernels(unsigned kernels);
+
+// Gets printable name of kernels
+const char *Algebra_GetKernelsName(unsigned kernels);
+
+// Batched Add3
+void Add3N(Vec3Array result, Vec3Array v1, Vec3Array v2, unsigned n);
+
+// Batched Saxpy3, performs: result = v1 + s*v2
+void Saxpy3N(
+	Vec3Array result,
+	Vec3Array v1,
+	Scalar    s,
+	Vec3Array v2,
+	unsigned  n
+);
+
+// Batched Cross3, result must not alias inputs
+void Cross3N(Vec3Array result, Vec3Array v1, Vec3Array v2, unsigned n);
+
+// Batched Dot3
+void Dot3N(Scalar result[], Vec3Array v1, Vec3Array v2, unsigned n);
+
+// Batched Normalize3
+void Normalize3N(Vec3Array result, Vec3Array v, unsigned n);
 
 #endif // ALGEBRA_H_INCLUDED
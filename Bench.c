@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+#include <GL/gl.h>
+#include "Clock.h"
+#include "Train.h"
+#include "DrawTrain.h"
+#include "Instancing.h"
+#include "Mesh.h"
+#include "Profiler.h"
+
+#include "Bench.h"
+
+#define WARMUP_FRAMES 3
+#define TIMED_FRAMES 20
+
+// Simulated frame rate of Bench_Run()
+#define BENCH_FRAME_RATE 60
+
+static const char *const phaseNames[BenchPhase_nPhases] = {
+	"simulation", "camera", "ground", "lighting", "train", "track", "slats",
+	"swap"
+};
+
+// Phase being timed, or BenchPhase_nPhases if none, and its start
+static BenchPhase currentPhase = BenchPhase_nPhases;
+static double     phaseStart;
+
+// Seconds in each phase since last reset
+static double phaseSeconds[BenchPhase_nPhases];
+
+// Gets mean seconds per frame, waiting for each to finish rendering
+static double TimeFrames(void (*drawFrame)(void))
+{
+	for (unsigned i = 0; i < WARMUP_FRAMES; ++i) {
+		drawFrame();
+	}
+	glFinish();
+	double start = Clock_GetSeconds();
+	for (unsigned i = 0; i < TIMED_FRAMES; ++i) {
+		drawFrame();
+		glFinish();
+	}
+	return (Clock_GetSeconds() - start) / TIMED_FRAMES;
+}
+
+void Bench_Carriages(void (*drawFrame)(void))
+{
+	unsigned nCarriages = g_trainSet.trains[0].nCarriages;
+	bool     instanced  = g_instancedTrain;
+
+	printf("%-10s %-10s %12s\n", "carriages", "path", "ms/frame");
+	for (unsigned n = 1; n <= MAX_CARRIAGES; n *= 10) {
+		g_trainSet.trains[0].nCarriages = n;
+		TrainSet_UpdatePoses(&g_trainSet);
+		for (unsigned path = 0; path < 2; ++path) {
+			if (path && !Instancing_IsAvailable()) {
+				continue;
+			}
+			g_instancedTrain = path;
+			printf(
+				"%-10u %-10s %12.3f\n",
+				n,
+				path ? "instanced" : "per-draw",
+				1000*TimeFrames(drawFrame)
+			);
+		}
+	}
+
+	g_trainSet.trains[0].nCarriages = nCarriages;
+	TrainSet_UpdatePoses(&g_trainSet);
+	g_instancedTrain = instanced;
+}
+
+const char *Bench_GetPhaseName(BenchPhase phase)
+{
+	return phaseNames[phase];
+}
+
+void Bench_BeginPhase(BenchPhase phase)
+{
+	double now = Clock_GetSeconds();
+	if (currentPhase != BenchPhase_nPhases) {
+		phaseSeconds[currentPhase] += now - phaseStart;
+	}
+	currentPhase = phase;
+	phaseStart = now;
+	Profiler_BeginPhase(phase, now);
+}
+
+void Bench_EndPhase(void)
+{
+	Bench_BeginPhase(BenchPhase_nPhases);
+}
+
+static int CompareSeconds(const void *a, const void *b)
+{
+	double secondsA = *(const double *)a,
+	       secondsB = *(const double *)b;
+	return (secondsA > secondsB) - (secondsA < secondsB);
+}
+
+// Gets nearest-rank percentile of n sorted values
+static double GetPercentile(const double *sorted, unsigned n, double percent)
+{
+	unsigned rank = ceil(percent/100 * n);
+	return sorted[rank ? rank - 1 : 0];
+}
+
+// Prints string as a JSON string, in quotes with special characters escaped
+static void PrintJsonString(const char *string)
+{
+	putchar('"');
+	for (const unsigned char *c = (const unsigned char *)string; *c; ++c) {
+		if (*c == '"' || *c == '\\') {
+			printf("\\%c", *c);
+		} else if (*c < 0x20) {
+			printf("\\u%04x", *c);
+		} else {
+			putchar(*c);
+		}
+	}
+	putchar('"');
+}
+
+// Prints string as a CSV field, in quotes with quotes doubled
+static void PrintCsvString(const char *string)
+{
+	putchar('"');
+	for (const char *c = string; *c; ++c) {
+		if (*c == '"') {
+			putchar('"');
+		}
+		putchar(*c);
+	}
+	putchar('"');
+}
+
+void Bench_Run(const BenchScenario *scenario, void (*runFrame)(double seconds))
+{
+	unsigned n = scenario->nFrames,
+	         frame = 0;
+	double *frameSeconds = malloc(n * sizeof *frameSeconds);
+	assert(frameSeconds || !n);
+	for (; frame < WARMUP_FRAMES; ++frame) {
+		runFrame((double)frame/BENCH_FRAME_RATE);
+	}
+
+	for (unsigned i = 0; i < BenchPhase_nPhases; ++i) {
+		phaseSeconds[i] = 0;
+	}
+	g_meshDrawStats = (MeshDrawStats){0};
+	double total = 0;
+	for (unsigned i = 0; i < n; ++i, ++frame) {
+		double start = Clock_GetSeconds();
+		runFrame((double)frame/BENCH_FRAME_RATE);
+		Bench_EndPhase();
+		frameSeconds[i] = Clock_GetSeconds() - start;
+		total += frameSeconds[i];
+	}
+	qsort(frameSeconds, n, sizeof *frameSeconds, CompareSeconds);
+
+	// Report in milliseconds, means per frame
+	unsigned d = n ? n : 1;
+	double mean = 1000*total/d,
+	       p50  = n ? 1000*GetPercentile(frameSeconds, n, 50) : 0,
+	       p99  = n ? 1000*GetPercentile(frameSeconds, n, 99) : 0,
+	       max  = n ? 1000*frameSeconds[n - 1] : 0,
+	       triangles = (double)g_meshDrawStats.triangles/d,
+	       drawCalls = (double)g_meshDrawStats.drawCalls/d;
+	const char *layout = scenario->layout ? scenario->layout : "";
+	switch (scenario->format) {
+	case BenchFormat_json:
+		printf(
+			"{\"frames\": %u, \"camera\": %u, \"antiAliasing\": %s, "
+			"\"samples\": %u, \"carriages\": %u, \"trains\": %u, "
+			"\"threads\": %u, \"layout\": ",
+			n, scenario->cameraMode,
+			scenario->antiAliasing ? "true" : "false",
+			scenario->nSamples, scenario->nCarriages, scenario->nTrains,
+			scenario->nThreads
+		);
+		PrintJsonString(layout);
+		printf(
+			",\n \"frameMs\": {\"mean\": %.4f, \"p50\": %.4f, "
+			"\"p99\": %.4f, \"max\": %.4f},\n"
+			" \"phaseMs\": {",
+			mean, p50, p99, max
+		);
+		for (unsigned i = 0; i < BenchPhase_nPhases; ++i) {
+			printf(
+				"%s\"%s\": %.4f",
+				i ? ", " : "",
+				phaseNames[i],
+				1000*phaseSeconds[i]/d
+			);
+		}
+		printf(
+			"},\n \"trianglesPerFrame\": %.1f, \"drawCallsPerFrame\": %.1f}\n",
+			triangles,
+			drawCalls
+		);
+		break;
+	case BenchFormat_csv:
+		printf(
+			"frames,camera,aa,samples,carriages,trains,threads,layout,"
+			"mean_ms,p50_ms,p99_ms,max_ms"
+		);
+		for (unsigned i = 0; i < BenchPhase_nPhases; ++i) {
+			printf(",%s_ms", phaseNames[i]);
+		}
+		printf(",triangles,draw_calls\n");
+		printf(
+			"%u,%u,%d,%u,%u,%u,%u,",
+			n, scenario->cameraMode, scenario->antiAliasing,
+			scenario->nSamples, scenario->nCarriages, scenario->nTrains,
+			scenario->nThreads
+		);
+		PrintCsvString(layout);
+		printf(",%.4f,%.4f,%.4f,%.4f", mean, p50, p99, max);
+		for (unsigned i = 0; i < BenchPhase_nPhases; ++i) {
+			printf(",%.4f", 1000*phaseSeconds[i]/d);
+		}
+		printf(",%.1f,%.1f\n", triangles, drawCalls);
+		break;
+	default:
+		abort();
+	}
+	free(frameSeconds);
+}
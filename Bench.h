@@ -0,0 +1,61 @@
+#ifndef BENCH_H_INCLUDED
+#define BENCH_H_INCLUDED
+
+#include <stdbool.h>
+
+// Renders frames with first train's length up to MAX_CARRIAGES, drawn each way
+// available, and prints mean frame times to stdout
+void Bench_Carriages(void (*drawFrame)(void));
+
+// Parts of a frame timed separately by Bench_Run()
+typedef enum {
+	BenchPhase_simulation, // Waiting for and starting train ticks
+	BenchPhase_camera,
+	BenchPhase_ground,
+	BenchPhase_lighting,
+	BenchPhase_train,
+	BenchPhase_track,
+	BenchPhase_slats,
+	BenchPhase_swap,       // Swapping buffers and waiting for rendering
+	BenchPhase_nPhases
+} BenchPhase;
+
+// Gets phase's name, as used in results
+const char *Bench_GetPhaseName(BenchPhase phase);
+
+// Machine-readable formats for Bench_Run() results
+typedef enum {
+	BenchFormat_json,
+	BenchFormat_csv
+} BenchFormat;
+
+// Scripted run, with settings already applied by the caller, and reported
+// along with the results so runs can be compared
+typedef struct {
+	unsigned    nFrames,
+	            cameraMode,
+	            nCarriages,  // Per train
+	            nTrains,
+	            nThreads,
+	            nSamples;
+	bool        antiAliasing;
+	const char  *layout;     // Path, or null for built-in network
+	BenchFormat format;
+} BenchScenario;
+
+// Ends timing of current phase, if any, and starts timing phase. Times are
+// accumulated over the frame, from the main thread's clock, and passed on to
+// the profiler.
+void Bench_BeginPhase(BenchPhase phase);
+
+// Ends timing of current phase
+void Bench_EndPhase(void);
+
+// Runs a few untimed frames then scenario's frames, each with runFrame given
+// simulated seconds advancing a fixed step per frame, so every run simulates
+// the same. runFrame must finish rendering before returning. Prints mean,
+// median, 99th percentile and worst frame times, mean time per phase, and
+// triangles and draw calls per frame to stdout.
+void Bench_Run(const BenchScenario *scenario, void (*runFrame)(double seconds));
+
+#endif // BENCH_H_INCLUDED
@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include <math.h>
 #include <GL/gl.h>
 #include <GL/glu.h>
@@ -12,6 +13,8 @@
 
 int g_cameraMode = 0;
 
+static const GLfloat zero[3] = {0};
+
 // From OpenGL red book
 static void accFrustum(
 	GLdouble left, GLdouble right, GLdouble bottom, GLdouble top,
@@ -60,6 +63,26 @@ static void accPerspective(
 	);
 }
 
+// Gets location of first train's locomotive, and heading that turns view to
+// face forwards
+static void GetTrainPose(GLfloat pos[3], GLfloat viewHeading[2])
+{
+	static TrackPoseScratch scratch;
+	GLfloat sine, cosine;
+	TrackPoses pose = {&pos[0], &pos[2], &sine, &cosine, NULL};
+	Track_GetPosesBatch(
+		&g_trainSet.drawPos[0],
+		(GLfloat [1]){0},
+		1,
+		1,
+		&pose,
+		&scratch
+	);
+	pos[1] = 0;
+	viewHeading[0] = cosine;
+	viewHeading[1] = -sine;
+}
+
 void DrawCamera(GLdouble pixdx, GLdouble pixdy)
 {
 	GLdouble fov         = 45,
@@ -84,21 +107,12 @@ void DrawCamera(GLdouble pixdx, GLdouble pixdy)
 		break;
 	case CameraMode_train:
 		{
-			GLfloat wheelPos[2][3];
-			NetworkPos wheelNp = g_trainPos;
-			NetworkPos_Move(&wheelNp, -0.5);
-			Track_GetCoords(wheelNp.track, wheelPos[0], wheelNp.pos);
-			NetworkPos_Move(&wheelNp, 1);
-			Track_GetCoords(wheelNp.track, wheelPos[1], wheelNp.pos);
-			GLfloat forward[3], pos[3];
-			Normalize3(forward, Saxpy3(forward, wheelPos[1], -1, wheelPos[0]));
-			Saxpy3(pos, wheelPos[0], 0.5, forward);
-			GLfloat angle = Angle3((GLfloat [3]){0, 0, 1}, forward);
-			if (Cross3((GLfloat [3]){0}, (GLfloat [3]){0, 0, 1}, forward)[1] > 0) {
-				angle *= -1;
-			}
+			GLfloat pos[3], heading[2];
+			GetTrainPose(pos, heading);
 			glTranslatef(0.35, -1.3, -0.5);
-			glRotatef(180 + angle, 0, 1, 0);
+			// Rotate view against train heading, turned to look down -z
+			MulHeading(heading, (GLfloat [2]){0, 1}, heading);
+			glMultMatrixf(HeadingMatrix((GLfloat [16]){0}, zero, heading));
 			gluLookAt(
 				pos[0], pos[1], pos[2],
 				pos[0], pos[1], pos[2] - 100,
@@ -108,22 +122,13 @@ void DrawCamera(GLdouble pixdx, GLdouble pixdy)
 		break;
 	case CameraMode_trainSide:
 		{
-			GLfloat wheelPos[2][3];
-			NetworkPos wheelNp = g_trainPos;
-			NetworkPos_Move(&wheelNp, -0.5);
-			Track_GetCoords(wheelNp.track, wheelPos[0], wheelNp.pos);
-			NetworkPos_Move(&wheelNp, 1);
-			Track_GetCoords(wheelNp.track, wheelPos[1], wheelNp.pos);
-			GLfloat forward[3], pos[3];
-			Normalize3(forward, Saxpy3(forward, wheelPos[1], -1, wheelPos[0]));
-			Saxpy3(pos, wheelPos[0], 0.5, forward);
-			GLfloat angle = Angle3((GLfloat [3]){0, 0, 1}, forward);
-			if (Cross3((GLfloat [3]){0}, (GLfloat [3]){0, 0, 1}, forward)[1] > 0) {
-				angle *= -1;
-			}
+			GLfloat pos[3], heading[2];
+			GetTrainPose(pos, heading);
 			glTranslatef(-0.3, -1, -4);
 			glRotatef(20, 1, 0, 0);
-			glRotatef(60 + angle, 0, 1, 0);
+			// Rotate view against train heading, turned 30 degrees
+			MulHeading(heading, (GLfloat [2]){sqrtf(3)/2, -0.5}, heading);
+			glMultMatrixf(HeadingMatrix((GLfloat [16]){0}, zero, heading));
 			gluLookAt(
 				pos[0], pos[1], pos[2],
 				pos[0], pos[1], pos[2] - 100,
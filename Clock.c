@@ -0,0 +1,12 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+
+#include "Clock.h"
+
+double Clock_GetSeconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
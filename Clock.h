@@ -0,0 +1,7 @@
+#ifndef CLOCK_H_INCLUDED
+#define CLOCK_H_INCLUDED
+
+// Gets seconds from an arbitrary fixed point, from a monotonic clock
+double Clock_GetSeconds(void);
+
+#endif // CLOCK_H_INCLUDED
@@ -0,0 +1,497 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include <assert.h>
+#include <GL/gl.h>
+#include "DrawUtil.h"
+#include "Mesh.h"
+#include "Instancing.h"
+#include "Algebra.h"
+#include "Track.h"
+#include "Lod.h"
+
+#include "DrawTrack.h"
+
+#define PI 3.14159265358979323846264338327950288
+
+// Ambient, diffuse, specular colors, shininess
+static const Material woodMaterial = {
+	{0.3, 0.2, 0.15, 1}, {0.3, 0.2, 0.15, 1}, {0, 0, 0, 1}, 0
+};
+static const Material metalMaterial = {
+	{0.40, 0.35, 0.37, 1}, {0.40, 0.35, 0.37, 1}, {1, 1, 1, 1}, 50
+};
+
+// Adds 3 faces (vertical sides + top) of box for train rails
+static void BuildRailBox(MeshBuilder *builder)
+{
+	MeshBuilder_PushMatrix(builder);
+		MeshBuilder_Scale(builder, 1, 0.05, 0.04);
+		MeshBuilder_PushMatrix(builder);
+			MeshBuilder_Rotate(builder, -90, 1, 0, 0);
+			MeshBuilder_Translate(builder, 0, 0.5, 0);
+			BuildSquare(builder);
+		MeshBuilder_PopMatrix(builder);
+		MeshBuilder_PushMatrix(builder);
+			MeshBuilder_Translate(builder, 0, 0.5, 0);
+			BuildSquare(builder);
+		MeshBuilder_PopMatrix(builder);
+		MeshBuilder_PushMatrix(builder);
+			MeshBuilder_Rotate(builder, 90, 1, 0, 0);
+			MeshBuilder_Translate(builder, 0, 0.5, 0);
+			BuildSquare(builder);
+		MeshBuilder_PopMatrix(builder);
+	MeshBuilder_PopMatrix(builder);
+}
+
+// Adds pair of rails 1 long, centered on origin along x axis
+static void BuildStraightRails(MeshBuilder *builder)
+{
+	MeshBuilder_SetMaterial(builder, &metalMaterial);
+	MeshBuilder_PushMatrix(builder);
+		MeshBuilder_Translate(builder, 0, 0.075, 0);
+		MeshBuilder_PushMatrix(builder);
+			MeshBuilder_Rotate(builder, 180, 0, 1, 0);
+			MeshBuilder_Translate(builder, 0, 0, 0.5);
+			BuildRailBox(builder);
+		MeshBuilder_PopMatrix(builder);
+		MeshBuilder_PushMatrix(builder);
+			MeshBuilder_Translate(builder, 0, 0, 0.5);
+			BuildRailBox(builder);
+		MeshBuilder_PopMatrix(builder);
+	MeshBuilder_PopMatrix(builder);
+}
+
+// Adds straight rails from position, along heading
+static void BuildStraightTrackSection(
+	MeshBuilder   *builder,
+	const GLfloat position[3],
+	const GLfloat heading[2],
+	GLfloat       length)
+{
+	MeshBuilder_PushMatrix(builder);
+		MeshBuilder_MultMatrix(
+			builder,
+			HeadingMatrix((GLfloat [16]){0}, position, heading)
+		);
+		MeshBuilder_Scale(builder, length, 1, 1);
+		BuildStraightRails(builder);
+	MeshBuilder_PopMatrix(builder);
+}
+
+static void BuildCurvedTrackArc(
+	MeshBuilder *builder,
+	GLfloat     radius,
+	GLfloat     startAngle,
+	GLfloat     arcAngle,
+	unsigned    segments)
+{
+	MeshBuilder_SetMaterial(builder, &metalMaterial);
+
+	// Draw inner-arc track face
+	GLuint first = builder->nVertices;
+	for (unsigned i = 0; i <= segments; ++i) {
+		GLfloat angle =
+			startAngle + i*arcAngle/segments;
+		GLfloat cosine = cosf(2*PI/360*angle), sine = sinf(2*PI/360*angle);
+		GLfloat normal[3] = {-cosine, 0, sine};
+		MeshBuilder_AddVertex(
+			builder,
+			(GLfloat [3]){radius*cosine, -0.5, -radius*sine},
+			normal
+		);
+		MeshBuilder_AddVertex(
+			builder,
+			(GLfloat [3]){radius*cosine, 0.5, -radius*sine},
+			normal
+		);
+	}
+	MeshBuilder_AddStrip(builder, first, 2*(segments + 1));
+	// Draw top track face
+	first = builder->nVertices;
+	for (unsigned i = 0; i <= segments; ++i) {
+		GLfloat angle =
+			startAngle + i*arcAngle/segments;
+		GLfloat cosine = cosf(2*PI/360*angle), sine = sinf(2*PI/360*angle);
+		GLfloat normal[3] = {0, 1, 0};
+		MeshBuilder_AddVertex(
+			builder,
+			(GLfloat [3]){radius*cosine, 0.5, -radius*sine},
+			normal
+		);
+		MeshBuilder_AddVertex(
+			builder,
+			(GLfloat [3]){(radius+0.04)*cosine, 0.5, -(radius+0.04)*sine},
+			normal
+		);
+	}
+	MeshBuilder_AddStrip(builder, first, 2*(segments + 1));
+	radius += 0.04;
+	// Draw outer-arc track face
+	first = builder->nVertices;
+	for (unsigned i = 0; i <= segments; ++i) {
+		GLfloat angle =
+			startAngle + i*arcAngle/segments;
+		GLfloat cosine = cosf(2*PI/360*angle), sine = sinf(2*PI/360*angle);
+		GLfloat normal[3] = {cosine, 0, -sine};
+		MeshBuilder_AddVertex(
+			builder,
+			(GLfloat [3]){radius*cosine, 0.5, -radius*sine},
+			normal
+		);
+		MeshBuilder_AddVertex(
+			builder,
+			(GLfloat [3]){radius*cosine, -0.5, -radius*sine},
+			normal
+		);
+	}
+	MeshBuilder_AddStrip(builder, first, 2*(segments + 1));
+}
+
+// Adds world space rails of curved piece, with arc in given segments
+static void BuildCurvedTrack(
+	MeshBuilder *builder,
+	CurvedTrack *track,
+	unsigned    segments)
+{
+	CurvedDims *dims = &track->dims;
+	StraightDims *line = &dims->straightSection;
+	if (line->length != 0) {
+		BuildStraightTrackSection(
+			builder,
+			line->position,
+			line->heading,
+			line->length
+		);
+	}
+	MeshBuilder_PushMatrix(builder);
+		MeshBuilder_Translate(
+			builder,
+			dims->arcOrigin[0],
+			dims->arcOrigin[1] + 0.075,
+			dims->arcOrigin[2]
+		);
+		MeshBuilder_Scale(builder, 1, 0.05, 1);
+		GLfloat startAngle = dims->startAngle;
+		GLfloat radius = dims->arcRadius - 0.52;
+		if (dims->clockwiseArc) {
+			startAngle = dims->startAngle - dims->arcAngle;
+		}
+		BuildCurvedTrackArc(
+			builder,
+			radius,
+			startAngle,
+			dims->arcAngle,
+			segments
+		);
+		radius += 1;
+		BuildCurvedTrackArc(
+			builder,
+			radius,
+			startAngle,
+			dims->arcAngle,
+			segments
+		);
+	MeshBuilder_PopMatrix(builder);
+}
+
+// Adds world space rails of any piece, curves at a level of detail
+static void BuildTrack(MeshBuilder *builder, TrackShared *track, unsigned level)
+{
+	switch (track->type) {
+	case Type_straight: {
+		StraightDims *dims = &((StraightTrack *)track)->dims;
+		BuildStraightTrackSection(
+			builder,
+			dims->position,
+			dims->heading,
+			dims->length
+		);
+		break;
+	}
+	case Type_curved: {
+		CurvedTrack *curved = (CurvedTrack *)track;
+		// Coarser levels keep at least one segment
+		unsigned segments = curved->dims.segments >> level;
+		if (!segments) {
+			segments = curved->dims.segments;
+		}
+		BuildCurvedTrack(builder, curved, segments);
+		break;
+	}
+	default:
+		abort();
+	}
+}
+
+// Width of square cells of ground whose pieces are batched together
+#define RAIL_CHUNK_SIZE 32
+
+// Rails of all pieces centered in one cell, baked into a world space mesh
+// at each level of detail, built when first drawn
+typedef struct {
+	TrackShared **pieces;
+	unsigned    nPieces;
+	bool        hasCurves;
+	GLfloat     min[3],
+	            max[3];
+	Mesh        meshes[LOD_LEVELS];
+	unsigned    level;
+} RailChunk;
+
+static RailChunk   *railChunks = NULL;
+static unsigned    nRailChunks = 0;
+static TrackShared **railPieces = NULL; // Pieces in order of their chunks
+
+// Pixels per unit, at a chunk's nearest point, below which curves are drawn
+// with half, then a quarter, of their full segments
+static const GLfloat railThresholds[LOD_LEVELS - 1] = {15, 5};
+
+// Piece with the cell it is centered in
+typedef struct {
+	int         x,
+	            z;
+	TrackShared *track;
+} CellPiece;
+
+static int CompareCellPieces(const void *a, const void *b)
+{
+	const CellPiece *pieceA = a, *pieceB = b;
+	if (pieceA->z != pieceB->z) {
+		return pieceA->z < pieceB->z ? -1 : 1;
+	}
+	if (pieceA->x != pieceB->x) {
+		return pieceA->x < pieceB->x ? -1 : 1;
+	}
+	return 0;
+}
+
+// Groups indexed pieces into chunks by cell, freeing any previous chunks
+static void BuildRailChunks(void)
+{
+	for (unsigned i = 0; i < nRailChunks; ++i) {
+		for (unsigned j = 0; j < LOD_LEVELS; ++j) {
+			Mesh_Free(&railChunks[i].meshes[j]);
+		}
+	}
+	nRailChunks = 0;
+
+	const NetworkIndex *index = &g_networkIndex;
+	unsigned nPieces = index->nPieces + index->nBranchPieces;
+	CellPiece *cellPieces = malloc(nPieces * sizeof *cellPieces);
+	railPieces = realloc(railPieces, nPieces * sizeof *railPieces);
+	assert((cellPieces && railPieces) || !nPieces);
+	for (unsigned i = 0; i < nPieces; ++i) {
+		GLfloat min[3], max[3];
+		Track_GetBounds(index->pieces[i], min, max);
+		cellPieces[i] = (CellPiece){
+			floorf((min[0] + max[0]) / 2 / RAIL_CHUNK_SIZE),
+			floorf((min[2] + max[2]) / 2 / RAIL_CHUNK_SIZE),
+			index->pieces[i]
+		};
+	}
+	qsort(cellPieces, nPieces, sizeof *cellPieces, CompareCellPieces);
+
+	RailChunk *chunk = NULL;
+	for (unsigned i = 0; i < nPieces; ++i) {
+		if (!i || CompareCellPieces(&cellPieces[i - 1], &cellPieces[i])) {
+			railChunks = realloc(
+				railChunks,
+				(nRailChunks + 1) * sizeof *railChunks
+			);
+			assert(railChunks);
+			chunk = &railChunks[nRailChunks++];
+			*chunk = (RailChunk){.pieces = &railPieces[i]};
+			Track_GetBounds(cellPieces[i].track, chunk->min, chunk->max);
+		}
+		TrackShared *track = cellPieces[i].track;
+		railPieces[i] = track;
+		++chunk->nPieces;
+		chunk->hasCurves |= track->type == Type_curved;
+		GLfloat min[3], max[3];
+		Track_GetBounds(track, min, max);
+		for (unsigned j = 0; j < 3; ++j) {
+			chunk->min[j] = fminf(chunk->min[j], min[j]);
+			chunk->max[j] = fmaxf(chunk->max[j], max[j]);
+		}
+	}
+	free(cellPieces);
+}
+
+// Draws chunk in detail for how close it comes to camera
+static void DrawRailChunk(RailChunk *chunk, const LodView *view)
+{
+	// Straight rails look the same at every level
+	if (chunk->hasCurves) {
+		GLfloat center[3], extent[3];
+		for (unsigned i = 0; i < 3; ++i) {
+			center[i] = (chunk->min[i] + chunk->max[i]) / 2;
+			extent[i] = chunk->max[i] - center[i];
+		}
+		GLfloat scale = LodView_GetNearestScale(view, center, Length3(extent));
+		chunk->level = Lod_Select(railThresholds, chunk->level, scale);
+	}
+	Mesh *mesh = &chunk->meshes[chunk->level];
+	if (!mesh->nParts) {
+		MeshBuilder builder;
+		MeshBuilder_Init(&builder);
+		for (unsigned i = 0; i < chunk->nPieces; ++i) {
+			BuildTrack(&builder, chunk->pieces[i], chunk->level);
+		}
+		Mesh_Build(mesh, &builder);
+	}
+	Mesh_Draw(mesh);
+}
+
+CullStats g_trackCullStats;
+
+void DrawRails(const Frustum *frustum, const LodView *view)
+{
+	static unsigned generation = 0;
+
+	// Bake rails again whenever network has been rebuilt
+	if (generation != g_networkIndex.generation) {
+		generation = g_networkIndex.generation;
+		BuildRailChunks();
+	}
+
+	for (unsigned i = 0; i < nRailChunks; ++i) {
+		RailChunk *chunk = &railChunks[i];
+		if (Frustum_IntersectsBox(frustum, chunk->min, chunk->max)) {
+			++g_trackCullStats.visible;
+			DrawRailChunk(chunk, view);
+		} else {
+			++g_trackCullStats.culled;
+		}
+	}
+}
+
+// Adds slat at origin, across the x axis
+static void BuildSlat(MeshBuilder *builder)
+{
+	// Corners of each face, anticlockwise from outside, then its normal
+	static const GLfloat faces[5][5][3] = {
+		{{0.5, 0, 0.5}, {0.5, 1, 0.5}, {-0.5, 1, 0.5}, {-0.5, 0, 0.5},
+		 {0, 0, 1}},
+		{{-0.5, 0, 0.5}, {-0.5, 1, 0.5}, {-0.5, 1, -0.5}, {-0.5, 0, -0.5},
+		 {-1, 0, 0}},
+		{{-0.5, 0, -0.5}, {-0.5, 1, -0.5}, {0.5, 1, -0.5}, {0.5, 0, -0.5},
+		 {0, 0, -1}},
+		{{0.5, 0, -0.5}, {0.5, 1, -0.5}, {0.5, 1, 0.5}, {0.5, 0, 0.5},
+		 {1, 0, 0}},
+		{{0.5, 1, 0.5}, {0.5, 1, -0.5}, {-0.5, 1, -0.5}, {-0.5, 1, 0.5},
+		 {0, 1, 0}}
+	};
+	MeshBuilder_SetMaterial(builder, &woodMaterial);
+	MeshBuilder_PushMatrix(builder);
+		MeshBuilder_Scale(builder, 0.2, 0.0375, 1.2);
+		for (unsigned i = 0; i < 5; ++i) {
+			GLuint first = builder->nVertices;
+			for (unsigned j = 0; j < 4; ++j) {
+				MeshBuilder_AddVertex(builder, faces[i][j], faces[i][4]);
+			}
+			MeshBuilder_AddQuad(builder, first, first + 1, first + 2, first + 3);
+		}
+	MeshBuilder_PopMatrix(builder);
+}
+
+// Places slat at distance along track piece
+static void SetSlatPose(InstancePose *pose, TrackShared *track, GLfloat pos)
+{
+	GLfloat end[3], tangent[3], heading[2];
+	Track_GetCoords(track, end, pos);
+	Track_GetTangent(track, tangent, pos);
+	Heading3(heading, tangent);
+	*pose = (InstancePose){end[0], end[2], heading[0], heading[1]};
+}
+
+// Calculates placements of slats spaced evenly around indexed ring, and along
+// each piece off it, at least minDistance apart. Returns number of slats,
+// poses are reused by the next call.
+static unsigned GetSlatPoses(InstancePose **poses, GLfloat minDistance)
+{
+	static InstancePose *slatPoses = NULL;
+
+	// Find actual target distance
+	const NetworkIndex *index = &g_networkIndex;
+	GLfloat length = NetworkIndex_GetLength(index);
+	unsigned nRingSlats = floorf(length / minDistance),
+	         nSlats     = nRingSlats;
+	GLfloat spacing = length / nRingSlats;
+
+	// Pieces off the ring are spaced separately, at least one slat each
+	unsigned nPieces = index->nPieces + index->nBranchPieces;
+	for (unsigned i = index->nPieces; i < nPieces; ++i) {
+		unsigned n = floorf(Track_GetLength(index->pieces[i]) / minDistance);
+		nSlats += n ? n : 1;
+	}
+
+	slatPoses = realloc(slatPoses, nSlats * sizeof *slatPoses);
+	assert(slatPoses);
+	NetworkPos pos = {index->pieces[0], 0};
+	for (unsigned i = 0; i < nRingSlats; ++i) {
+		NetworkPos_SetDistance(&pos, i * (double)spacing);
+		SetSlatPose(&slatPoses[i], pos.track, pos.pos);
+	}
+	unsigned slat = nRingSlats;
+	for (unsigned i = index->nPieces; i < nPieces; ++i) {
+		TrackShared *track = index->pieces[i];
+		GLfloat pieceLength = Track_GetLength(track);
+		unsigned n = floorf(pieceLength / minDistance);
+		n = n ? n : 1;
+		for (unsigned j = 0; j < n; ++j) {
+			SetSlatPose(&slatPoses[slat++], track, (j + 0.5f) * pieceLength / n);
+		}
+	}
+	*poses = slatPoses;
+	return nSlats;
+}
+
+// Draws wooden slats in track network
+void DrawSlats(GLfloat minDistance)
+{
+	// Slat model, and either instance placements or, if instancing is
+	// unsupported, a world space mesh of every slat
+	static Mesh           slatMesh,
+	                      slatsMesh;
+	static InstanceBuffer slatInstances;
+	static unsigned       generation = 0;
+
+	if (!slatMesh.nParts) {
+		MeshBuilder builder;
+		MeshBuilder_Init(&builder);
+		BuildSlat(&builder);
+		Mesh_Build(&slatMesh, &builder);
+	}
+
+	// Place slats again whenever network has been rebuilt
+	if (generation != g_networkIndex.generation) {
+		generation = g_networkIndex.generation;
+		InstancePose *poses;
+		unsigned nSlats = GetSlatPoses(&poses, minDistance);
+		if (Instancing_IsAvailable()) {
+			InstanceBuffer_Upload(&slatInstances, poses, nSlats, GL_STATIC_DRAW);
+		} else {
+			MeshBuilder builder;
+			MeshBuilder_Init(&builder);
+			for (unsigned i = 0; i < nSlats; ++i) {
+				MeshBuilder_PushMatrix(&builder);
+					MeshBuilder_MultMatrix(&builder, HeadingMatrix(
+						(GLfloat [16]){0},
+						(GLfloat [3]){poses[i].x, 0, poses[i].z},
+						(GLfloat [2]){poses[i].cosine, poses[i].sine}
+					));
+					BuildSlat(&builder);
+				MeshBuilder_PopMatrix(&builder);
+			}
+			Mesh_Free(&slatsMesh);
+			Mesh_Build(&slatsMesh, &builder);
+		}
+	}
+
+	if (Instancing_IsAvailable()) {
+		Instancing_Draw(&slatMesh, &slatInstances);
+	} else {
+		Mesh_Draw(&slatsMesh);
+	}
+}
@@ -0,0 +1,20 @@
+#ifndef DRAW_TRACK_H_INCLUDED
+#define DRAW_TRACK_H_INCLUDED
+
+#include <GL/gl.h>
+#include "Track.h"
+#include "Frustum.h"
+#include "Lod.h"
+
+// Chunks of rails drawn and culled by DrawRails(), since last reset
+extern CullStats g_trackCullStats;
+
+// Draws rails of every piece in g_networkIndex, batched into chunks of
+// nearby pieces baked in world space, each drawn if its bounding box is in
+// frustum, in detail for how close it is in view
+void DrawRails(const Frustum *frustum, const LodView *view);
+
+// Draws wooden slats in track network
+void DrawSlats(GLfloat minDistance);
+
+#endif // DRAW_TRACK_H_INCLUDED
@@ -0,0 +1,333 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <GL/gl.h>
+#include "DrawUtil.h"
+#include "Mesh.h"
+#include "Instancing.h"
+#include "Track.h"
+#include "Train.h"
+#include "Algebra.h"
+#include "Lod.h"
+
+#include "DrawTrain.h"
+
+// Models at each level of detail
+static Mesh trainMeshes[LOD_LEVELS],
+            carriageMeshes[LOD_LEVELS];
+
+// Sizes in pixels of a vehicle below which its cylinders are drawn with half,
+// then a quarter, of their full segments
+static const GLfloat vehicleThresholds[LOD_LEVELS - 1] = {120, 40};
+
+// Radius of a sphere around a vehicle, centred above its position
+#define VEHICLE_RADIUS 1.3
+#define VEHICLE_CENTER_Y 0.6
+
+bool g_instancedTrain = true;
+
+// Ambient, diffuse, specular colors, shininess
+static const Material bodyMaterial = {
+	{1, 0.1, 0.1, 1}, {1, 0.1, 0.1, 1}, {0.5, 0.5, 0.5, 1}, 50
+};
+static const Material darkMaterial = {
+	{0.2, 0.18, 0.14, 1}, {0.2, 0.18, 0.14, 1}, {0, 0, 0, 1}, 0
+};
+static const Material metalMaterial = {
+	{0.7, 0.7, 0.75, 1}, {0.7, 0.7, 0.75, 1}, {1, 1, 1, 1}, 50
+};
+
+// Gets segments of a cylinder or disc with full detail segments at level
+static unsigned GetSegments(unsigned segments, unsigned level)
+{
+	segments >>= level;
+	return segments > 3 ? segments : 3;
+}
+
+static void BuildWheel(MeshBuilder *builder, unsigned level)
+{
+	MeshBuilder_SetMaterial(builder, &metalMaterial);
+	MeshBuilder_PushMatrix(builder);
+		MeshBuilder_Rotate(builder, -90, 1, 0, 0);
+		MeshBuilder_Scale(builder, 0.3, 0.02, 0.3);
+		BuildHollowCylinder(builder, GetSegments(24, level));
+		MeshBuilder_Translate(builder, 0, 1, 0);
+		BuildDisc(builder, GetSegments(24, level));
+	MeshBuilder_PopMatrix(builder);
+	MeshBuilder_PushMatrix(builder);
+		MeshBuilder_Rotate(builder, 90, 1, 0, 0);
+		MeshBuilder_PushMatrix(builder);
+			MeshBuilder_Scale(builder, 0.3, 1, 0.3);
+			MeshBuilder_Rotate(builder, 180, 0, 1, 0);
+			BuildDisc(builder, GetSegments(24, level));
+		MeshBuilder_PopMatrix(builder);
+		MeshBuilder_Scale(builder, 0.25, 0.03, 0.25);
+		BuildHollowCylinder(builder, GetSegments(16, level));
+		MeshBuilder_Translate(builder, 0, 1, 0);
+		BuildDisc(builder, GetSegments(16, level));
+	MeshBuilder_PopMatrix(builder);
+}
+
+static void BuildSpoke(MeshBuilder *builder, unsigned level)
+{
+	MeshBuilder_SetMaterial(builder, &metalMaterial);
+	MeshBuilder_PushMatrix(builder);
+		MeshBuilder_Rotate(builder, 90, 1, 0, 0);
+		MeshBuilder_Scale(builder, 0.05, 1-0.08, 0.05);
+		MeshBuilder_Translate(builder, 0, -0.5, 0);
+		BuildHollowCylinder(builder, GetSegments(12, level));
+	MeshBuilder_PopMatrix(builder);
+}
+
+// Adds undercarriage, axles and wheels shared by all vehicles
+static void BuildChassis(MeshBuilder *builder, unsigned level)
+{
+	// Draw undercarriage
+	MeshBuilder_SetMaterial(builder, &darkMaterial);
+	MeshBuilder_PushMatrix(builder);
+		MeshBuilder_Translate(builder, -1, 0.15, 0);
+		MeshBuilder_Scale(builder, 2, 0.3, 0.7);
+		MeshBuilder_Translate(builder, 0, 0, -0.5);
+		BuildCube(builder);
+	MeshBuilder_PopMatrix(builder);
+
+	// Draw spokes
+	MeshBuilder_PushMatrix(builder);
+		MeshBuilder_Translate(builder, -0.5, 0.225, 0);
+		BuildSpoke(builder, level);
+		MeshBuilder_Translate(builder, 1, 0, 0);
+		BuildSpoke(builder, level);
+	MeshBuilder_PopMatrix(builder);
+
+	// Draw wheels
+	MeshBuilder_PushMatrix(builder);
+		MeshBuilder_Translate(builder, -0.5, 0.225, 0.48);
+		BuildWheel(builder, level);
+		MeshBuilder_PushMatrix(builder);
+			MeshBuilder_Translate(builder, 0, 0, -0.96);
+			MeshBuilder_Rotate(builder, 180, 0, 1, 0);
+			BuildWheel(builder, level);
+			MeshBuilder_Translate(builder, -1, 0, 0);
+			BuildWheel(builder, level);
+		MeshBuilder_PopMatrix(builder);
+		MeshBuilder_Translate(builder, 1, 0, 0);
+		BuildWheel(builder, level);
+	MeshBuilder_PopMatrix(builder);
+}
+
+// Builds locomotive and carriage models at level of detail
+static void BuildModels(unsigned level)
+{
+	MeshBuilder builder;
+
+	// Build train model
+	MeshBuilder_Init(&builder);
+	// Draw locomotive carriage
+	MeshBuilder_SetMaterial(&builder, &bodyMaterial);
+	MeshBuilder_PushMatrix(&builder);
+		MeshBuilder_Translate(&builder, -1, 0.45, 0);
+		MeshBuilder_Scale(&builder, 0.5, 1, 1);
+		MeshBuilder_Translate(&builder, 0, 0, -0.5);
+		BuildCube(&builder);
+	MeshBuilder_PopMatrix(&builder);
+
+	// Draw locomotive tank
+	MeshBuilder_PushMatrix(&builder);
+		MeshBuilder_Translate(&builder, -0.5, 0.45 + 1./3, 0);
+		MeshBuilder_Rotate(&builder, -90, 0, 0, 1);
+		MeshBuilder_Scale(&builder, 2./3, 1.5, 2./3);
+		BuildHollowCylinder(&builder, GetSegments(32, level));
+		MeshBuilder_Translate(&builder, 0, 1, 0);
+		BuildDisc(&builder, GetSegments(32, level));
+	MeshBuilder_PopMatrix(&builder);
+
+	// Draw tank chimney
+	MeshBuilder_PushMatrix(&builder);
+		MeshBuilder_Translate(&builder, 0.5, 0.45 + 1./3, 0);
+		MeshBuilder_Scale(&builder, 0.3, 0.7, 0.3);
+		BuildHollowCylinder(&builder, GetSegments(32, level));
+		MeshBuilder_Translate(&builder, 0, 1, 0);
+		BuildDisc(&builder, GetSegments(32, level));
+	MeshBuilder_PopMatrix(&builder);
+
+	BuildChassis(&builder, level);
+	Mesh_Build(&trainMeshes[level], &builder);
+
+	// Build carriage model
+	MeshBuilder_Init(&builder);
+	// Draw top carriage
+	MeshBuilder_SetMaterial(&builder, &bodyMaterial);
+	MeshBuilder_PushMatrix(&builder);
+		MeshBuilder_Translate(&builder, -1, 0.45, 0);
+		MeshBuilder_Scale(&builder, 2, 1, 1);
+		MeshBuilder_Translate(&builder, 0, 0, -0.5);
+		BuildCube(&builder);
+	MeshBuilder_PopMatrix(&builder);
+
+	// Draw hook
+	MeshBuilder_SetMaterial(&builder, &darkMaterial);
+	MeshBuilder_PushMatrix(&builder);
+		MeshBuilder_Translate(&builder, 0.5, 0.45, 0);
+		static const GLfloat up[3] = {0, 1, 0};
+		GLuint first = MeshBuilder_AddVertex(
+			&builder,
+			(GLfloat [3]){0, 0, -0.25},
+			up
+		);
+		MeshBuilder_AddVertex(&builder, (GLfloat [3]){0, 0, 0.25}, up);
+		MeshBuilder_AddVertex(&builder, (GLfloat [3]){1, 0, 0}, up);
+		MeshBuilder_AddTriangle(&builder, first, first + 1, first + 2);
+	MeshBuilder_PopMatrix(&builder);
+
+	BuildChassis(&builder, level);
+	Mesh_Build(&carriageMeshes[level], &builder);
+}
+
+void InitTrain(void)
+{
+	for (unsigned level = 0; level < LOD_LEVELS; ++level) {
+		BuildModels(level);
+	}
+}
+
+// Level of detail each vehicle was last drawn at, by index over all trains'
+// vehicles in order
+static unsigned char *vehicleLevels = NULL;
+static unsigned      nVehicleLevels = 0;
+
+// Selects each vehicle's level of detail from its size in view, returns them
+// by index over all trains' vehicles in order, as in set->poses
+static const unsigned char *SelectLevels(
+	const TrainSet *set,
+	const LodView  *view)
+{
+	unsigned n = set->nPoses;
+	if (nVehicleLevels < n) {
+		vehicleLevels = realloc(vehicleLevels, n * sizeof *vehicleLevels);
+		assert(vehicleLevels);
+		memset(vehicleLevels + nVehicleLevels, 0, n - nVehicleLevels);
+		nVehicleLevels = n;
+	}
+
+	const TrackPoses *poses = &set->poses;
+	for (unsigned i = 0; i < n; ++i) {
+		GLfloat center[3] = {poses->x[i], VEHICLE_CENTER_Y, poses->z[i]};
+		vehicleLevels[i] = Lod_Select(
+			vehicleThresholds,
+			vehicleLevels[i],
+			LodView_GetSize(view, center, VEHICLE_RADIUS)
+		);
+	}
+	return vehicleLevels;
+}
+
+// Draws all locomotives and all carriages, with one instanced draw per
+// material of each model at each level of detail in use
+static void DrawTrainsInstanced(
+	const TrainSet      *set,
+	const unsigned char *levels)
+{
+	// Placements grouped by model, locomotives first, then by level
+	static InstanceBuffer groups[2][LOD_LEVELS];
+	static InstancePose   *instancePoses;
+	static unsigned       capacity = 0;
+	unsigned counts[2][LOD_LEVELS] = {{0}},
+	         n = 0;
+	for (unsigned i = 0; i < set->nTrains; ++i) {
+		for (unsigned j = 0; j <= set->trains[i].nCarriages; ++j) {
+			++counts[j != 0][levels[n++]];
+		}
+	}
+	assert(n == set->nPoses);
+	if (capacity < n) {
+		capacity = n;
+		instancePoses = realloc(
+			instancePoses,
+			capacity * sizeof *instancePoses
+		);
+		assert(instancePoses);
+	}
+
+	// Sort placements into groups
+	InstancePose *next[2][LOD_LEVELS],
+	             *group = instancePoses;
+	for (unsigned model = 0; model < 2; ++model) {
+		for (unsigned level = 0; level < LOD_LEVELS; ++level) {
+			next[model][level] = group;
+			group += counts[model][level];
+		}
+	}
+	const TrackPoses *poses = &set->poses;
+	n = 0;
+	for (unsigned i = 0; i < set->nTrains; ++i) {
+		for (unsigned j = 0; j <= set->trains[i].nCarriages; ++j, ++n) {
+			*next[j != 0][levels[n]]++ = (InstancePose){
+				poses->x[n],
+				poses->z[n],
+				poses->cosine[n],
+				poses->sine[n]
+			};
+		}
+	}
+
+	const Mesh *models[2] = {trainMeshes, carriageMeshes};
+	group = instancePoses;
+	for (unsigned model = 0; model < 2; ++model) {
+		for (unsigned level = 0; level < LOD_LEVELS; ++level) {
+			unsigned count = counts[model][level];
+			if (!count) {
+				continue;
+			}
+			InstanceBuffer_Upload(
+				&groups[model][level],
+				group,
+				count,
+				GL_STREAM_DRAW
+			);
+			Instancing_Draw(&models[model][level], &groups[model][level]);
+			group += count;
+		}
+	}
+}
+
+// Draws each vehicle of train i with its own draw per material, at given
+// levels of detail. Its locomotive is at index first of set->poses.
+static void DrawTrainVehicles(
+	const TrainSet      *set,
+	unsigned            i,
+	unsigned            first,
+	const unsigned char *levels)
+{
+	const TrackPoses *poses = &set->poses;
+	for (unsigned j = 0; j <= set->trains[i].nCarriages; ++j) {
+		unsigned k = first + j;
+		glPushMatrix();
+			// Vehicle location and orientation
+			GLfloat matrix[16];
+			HeadingMatrix(
+				matrix,
+				(GLfloat [3]){poses->x[k], 0, poses->z[k]},
+				(GLfloat [2]){poses->cosine[k], poses->sine[k]}
+			);
+			glMultMatrixf(matrix);
+			// Draw locomotive or carriage
+			Mesh_Draw(
+				j ? &carriageMeshes[levels[k]] : &trainMeshes[levels[k]]
+			);
+		glPopMatrix();
+	}
+}
+
+void DrawTrain(const LodView *view)
+{
+	const unsigned char *levels = SelectLevels(&g_trainSet, view);
+	if (g_instancedTrain && Instancing_IsAvailable()) {
+		DrawTrainsInstanced(&g_trainSet, levels);
+		return;
+	}
+	unsigned first = 0;
+	for (unsigned i = 0; i < g_trainSet.nTrains; ++i) {
+		DrawTrainVehicles(&g_trainSet, i, first, levels);
+		first += g_trainSet.trains[i].nCarriages + 1;
+	}
+}
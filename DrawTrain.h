@@ -0,0 +1,17 @@
+#ifndef DRAW_TRAIN_H_INCLUDED
+#define DRAW_TRAIN_H_INCLUDED
+
+#include <stdbool.h>
+#include "Lod.h"
+
+// Must be called before drawing train
+void InitTrain(void);
+
+// Whether to draw trains instanced, when supported
+extern bool g_instancedTrain;
+
+// Draws every train in g_trainSet at its poses from the last
+// TrainSet_UpdatePoses(), each vehicle in detail for its size in view
+void DrawTrain(const LodView *view);
+
+#endif // DRAW_TRAIN_H_INCLUDED
@@ -1,5 +1,4 @@
 #include <math.h>
-#include <assert.h>
 
 #include "DrawUtil.h"
 
@@ -7,100 +6,63 @@
 
 #define RADS (PI/180)
 
-static GLuint cubeDl   = 0,
-              squareDl = 0;
-
-void InitUtilFns(void)
+void BuildCube(MeshBuilder *builder)
 {
-	cubeDl = glGenLists(1);
-	assert(cubeDl);
-	glNewList(cubeDl, GL_COMPILE);
-		glBegin(GL_QUADS);
-			glNormal3f(0, 0, -1);
-			glVertex3f(0, 0, 0);
-			glVertex3f(0, 1, 0);
-			glVertex3f(1, 1, 0);
-			glVertex3f(1, 0, 0);
-
-			glNormal3f(1, 0, 0);
-			glVertex3f(1, 0, 0);
-			glVertex3f(1, 1, 0);
-			glVertex3f(1, 1, 1);
-			glVertex3f(1, 0, 1);
-
-			glNormal3f(0, 0, 1);
-			glVertex3f(1, 0, 1);
-			glVertex3f(1, 1, 1);
-			glVertex3f(0, 1, 1);
-			glVertex3f(0, 0, 1);
-
-			glNormal3f(-1, 0, 0);
-			glVertex3f(0, 0, 1);
-			glVertex3f(0, 1, 1);
-			glVertex3f(0, 1, 0);
-			glVertex3f(0, 0, 0);
-
-			glNormal3f(0, 1, 0);
-			glVertex3f(1, 1, 1);
-			glVertex3f(1, 1, 0);
-			glVertex3f(0, 1, 0);
-			glVertex3f(0, 1, 1);
-
-			glNormal3f(0, -1, 0);
-			glVertex3f(0, 0, 0);
-			glVertex3f(1, 0, 0);
-			glVertex3f(1, 0, 1);
-			glVertex3f(0, 0, 1);
-		glEnd();
-	glEndList();
-
-	squareDl = glGenLists(1);
-	assert(squareDl);
-	glNewList(squareDl, GL_COMPILE);
-		glBegin(GL_QUADS);
-			glNormal3f(0, 1, 0);
-			glVertex3f(-0.5, 0, -0.5);
-			glVertex3f(-0.5, 0, 0.5);
-			glVertex3f(0.5, 0, 0.5);
-			glVertex3f(0.5, 0, -0.5);
-		glEnd();
-	glEndList();
-}
-
-void DrawCube(void)
-{
-	glCallList(cubeDl);
+	// Corners of each face, anticlockwise from outside, then its normal
+	static const GLfloat faces[6][5][3] = {
+		{{0, 0, 0}, {0, 1, 0}, {1, 1, 0}, {1, 0, 0}, {0, 0, -1}},
+		{{1, 0, 0}, {1, 1, 0}, {1, 1, 1}, {1, 0, 1}, {1, 0, 0}},
+		{{1, 0, 1}, {1, 1, 1}, {0, 1, 1}, {0, 0, 1}, {0, 0, 1}},
+		{{0, 0, 1}, {0, 1, 1}, {0, 1, 0}, {0, 0, 0}, {-1, 0, 0}},
+		{{1, 1, 1}, {1, 1, 0}, {0, 1, 0}, {0, 1, 1}, {0, 1, 0}},
+		{{0, 0, 0}, {1, 0, 0}, {1, 0, 1}, {0, 0, 1}, {0, -1, 0}}
+	};
+	for (unsigned i = 0; i < 6; ++i) {
+		GLuint first = MeshBuilder_AddVertex(builder, faces[i][0], faces[i][4]);
+		for (unsigned j = 1; j < 4; ++j) {
+			MeshBuilder_AddVertex(builder, faces[i][j], faces[i][4]);
+		}
+		MeshBuilder_AddQuad(builder, first, first + 1, first + 2, first + 3);
+	}
 }
 
-void DrawSquare(void)
+void BuildSquare(MeshBuilder *builder)
 {
-	glCallList(squareDl);
+	static const GLfloat up[3]         = {0, 1, 0},
+	                     corners[4][3] = {
+		{-0.5, 0, -0.5},
+		{-0.5, 0, 0.5},
+		{0.5, 0, 0.5},
+		{0.5, 0, -0.5}
+	};
+	GLuint first = builder->nVertices;
+	for (unsigned i = 0; i < 4; ++i) {
+		MeshBuilder_AddVertex(builder, corners[i], up);
+	}
+	MeshBuilder_AddQuad(builder, first, first + 1, first + 2, first + 3);
 }
 
-void DrawDisc(unsigned segments)
+void BuildDisc(MeshBuilder *builder, unsigned segments)
 {
-	glBegin(GL_TRIANGLE_FAN);
-		glNormal3f(0, 1, 0);
-		glVertex3f(0, 0, 0);
-		for (unsigned i = 0; i <= segments; ++i) {
-			GLfloat radAngle = RADS*360*i/segments;
-			GLfloat cosine = -0.5*cosf(radAngle), sine = 0.5*sinf(radAngle);
-			glNormal3f(0, 1, 0);
-			glVertex3f(cosine, 0, sine);
-		}
-	glEnd();
+	static const GLfloat up[3] = {0, 1, 0};
+	GLuint first = MeshBuilder_AddVertex(builder, (GLfloat [3]){0, 0, 0}, up);
+	for (unsigned i = 0; i <= segments; ++i) {
+		GLfloat radAngle = RADS*360*i/segments;
+		GLfloat cosine = -0.5*cosf(radAngle), sine = 0.5*sinf(radAngle);
+		MeshBuilder_AddVertex(builder, (GLfloat [3]){cosine, 0, sine}, up);
+	}
+	MeshBuilder_AddFan(builder, first, segments + 2);
 }
 
-void DrawHollowCylinder(unsigned segments)
+void BuildHollowCylinder(MeshBuilder *builder, unsigned segments)
 {
-	glBegin(GL_TRIANGLE_STRIP);
-		for (unsigned i = 0; i <= segments; ++i) {
-			GLfloat radAngle = RADS*360*i/segments;
-			GLfloat cosine = 0.5*cosf(radAngle), sine = 0.5*sinf(radAngle);
-			glNormal3f(cosine, 0, sine);
-			glVertex3f(cosine, 0, sine);
-			glNormal3f(cosine, 0, sine);
-			glVertex3f(cosine, 1, sine);
-		}
-	glEnd();
+	GLuint first = builder->nVertices;
+	for (unsigned i = 0; i <= segments; ++i) {
+		GLfloat radAngle = RADS*360*i/segments;
+		GLfloat cosine = 0.5*cosf(radAngle), sine = 0.5*sinf(radAngle);
+		GLfloat normal[3] = {cosine, 0, sine};
+		MeshBuilder_AddVertex(builder, (GLfloat [3]){cosine, 0, sine}, normal);
+		MeshBuilder_AddVertex(builder, (GLfloat [3]){cosine, 1, sine}, normal);
+	}
+	MeshBuilder_AddStrip(builder, first, 2*(segments + 1));
 }
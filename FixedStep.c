@@ -0,0 +1,35 @@
+#include <assert.h>
+
+#include "FixedStep.h"
+
+void FixedStep_Init(FixedStep *fs, double ticksPerSecond, unsigned maxTicks)
+{
+	assert(ticksPerSecond > 0 && maxTicks > 0);
+	*fs = (FixedStep){
+		.tickLength = 1/ticksPerSecond,
+		.lastTime   = -1,
+		.maxTicks   = maxTicks
+	};
+}
+
+Scalar FixedStep_Advance(FixedStep *fs, double now, void (*tick)(Scalar dt))
+{
+	if (fs->lastTime >= 0) {
+		fs->accumulator += now - fs->lastTime;
+	}
+	fs->lastTime = now;
+
+	unsigned nTicks = 0;
+	while (fs->accumulator >= fs->tickLength) {
+		if (nTicks == fs->maxTicks) {
+			// Fallen too far behind: let simulation slow down, rather than
+			// spending ever longer catching up
+			fs->accumulator = 0;
+			break;
+		}
+		tick(fs->tickLength);
+		fs->accumulator -= fs->tickLength;
+		++nTicks;
+	}
+	return fs->accumulator / fs->tickLength;
+}
@@ -0,0 +1,22 @@
+#ifndef FIXED_STEP_H_INCLUDED
+#define FIXED_STEP_H_INCLUDED
+
+#include "Scalar.h"
+
+// Runs a simulation in fixed ticks, whatever rate it is advanced at
+typedef struct {
+	double   tickLength,  // Seconds simulated by each tick
+	         accumulator, // Elapsed time not yet simulated
+	         lastTime;    // Time of last advance, negative before first one
+	unsigned maxTicks;    // Most ticks per advance, drops time beyond this
+} FixedStep;
+
+// Initializes stepper for given tick rate, at most maxTicks per advance
+void FixedStep_Init(FixedStep *fs, double ticksPerSecond, unsigned maxTicks);
+
+// Runs tick for each whole tick elapsed from last advance up to now.
+// Returns fraction of a tick left over, for interpolating between the last
+// two simulation states.
+Scalar FixedStep_Advance(FixedStep *fs, double now, void (*tick)(Scalar dt));
+
+#endif // FIXED_STEP_H_INCLUDED
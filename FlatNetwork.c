@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+#include "FlatNetwork.h"
+
+#define PI 3.14159265358979323846264338327950288
+
+void FlatNetwork_Build(FlatNetwork *network, TrackShared *head)
+{
+	unsigned nPieces = 0,
+	         nLines  = 0,
+	         nArcs   = 0;
+	TrackShared *track = head;
+	do {
+		++nPieces;
+		nLines += track->type == Type_straight;
+		nArcs += track->type == Type_curved;
+		track = Track_GetNext(track);
+	} while (track != head);
+
+	FlatNetwork_Free(network);
+	network->lengths = malloc(nPieces * sizeof *network->lengths);
+	network->next = malloc(nPieces * sizeof *network->next);
+	network->prev = malloc(nPieces * sizeof *network->prev);
+	network->offsets = malloc((nPieces + 1) * sizeof *network->offsets);
+	network->types = malloc(nPieces * sizeof *network->types);
+	network->geometry = malloc(nPieces * sizeof *network->geometry);
+	network->pieces = malloc(nPieces * sizeof *network->pieces);
+	assert(   network->lengths && network->next && network->prev
+	       && network->offsets && network->types && network->geometry
+	       && network->pieces);
+
+	network->lines = malloc(nLines * sizeof *network->lines);
+	assert(network->lines || !nLines);
+	network->arcs = malloc(nArcs * sizeof *network->arcs);
+	assert(network->arcs || !nArcs);
+
+	network->nPieces = nPieces;
+	network->nLines = nLines;
+	network->nArcs = nArcs;
+
+	double offset = 0;
+	unsigned line = 0,
+	         arc  = 0;
+	for (unsigned i = 0; i < nPieces; ++i) {
+		network->lengths[i] = Track_GetLength(track);
+		network->next[i] = i + 1 < nPieces ? i + 1 : 0;
+		network->prev[i] = i > 0 ? i - 1 : nPieces - 1;
+		network->offsets[i] = offset;
+		network->types[i] = track->type;
+		network->pieces[i] = track;
+		offset += network->lengths[i];
+
+		switch (track->type) {
+		case Type_straight: {
+			const StraightDims *dims = &((StraightTrack *)track)->dims;
+			network->geometry[i] = line;
+			network->lines[line++] = (FlatLine){
+				dims->start[0], dims->start[2],
+				dims->forwards[0], dims->forwards[2]
+			};
+			break;
+		}
+		case Type_curved: {
+			const CurvedDims   *dims = &((CurvedTrack *)track)->dims;
+			const StraightDims *lead = &dims->straightSection;
+			Scalar sign = dims->clockwiseArc ? -1 : 1;
+			network->geometry[i] = arc;
+			network->arcs[arc++] = (FlatArc){
+				dims->arcOrigin[0], dims->arcOrigin[2],
+				dims->arcRadius,
+				2*PI/360 * dims->startAngle,
+				2*PI/360 * sign*dims->arcAngle,
+				dims->arcLength,
+				{
+					lead->start[0], lead->start[2],
+					lead->forwards[0], lead->forwards[2]
+				},
+				lead->length,
+				dims->straightFirst
+			};
+			break;
+		}
+		default:
+			abort();
+		}
+		track = Track_GetNext(track);
+	}
+	network->offsets[nPieces] = offset;
+}
+
+void FlatNetwork_Free(FlatNetwork *network)
+{
+	free(network->lengths);
+	free(network->next);
+	free(network->prev);
+	free(network->offsets);
+	free(network->types);
+	free(network->geometry);
+	free(network->pieces);
+	free(network->lines);
+	free(network->arcs);
+	*network = (FlatNetwork){0};
+}
+
+double FlatNetwork_GetLength(const FlatNetwork *network)
+{
+	return network->offsets[network->nPieces];
+}
+
+FlatPos *FlatPos_Move(const FlatNetwork *network, FlatPos *fp, Scalar vector)
+{
+	const Scalar   *lengths = network->lengths;
+	const uint32_t *next    = network->next,
+	               *prev    = network->prev;
+	uint32_t piece = fp->piece;
+	vector += fp->pos;
+	if (vector >= 0) {
+		while (lengths[piece] < vector) {
+			vector -= lengths[piece];
+			piece = next[piece];
+		}
+		fp->pos = vector;
+	} else {
+		piece = prev[piece];
+		vector *= -1;
+		while (lengths[piece] < vector) {
+			vector -= lengths[piece];
+			piece = prev[piece];
+		}
+		fp->pos = lengths[piece] - vector;
+	}
+	fp->piece = piece;
+	return fp;
+}
+
+FlatPos *FlatPos_SetDistance(
+	const FlatNetwork *network,
+	FlatPos           *fp,
+	double            distance)
+{
+	assert(network->nPieces);
+
+	// Wrap around ring
+	double length = FlatNetwork_GetLength(network);
+	if (distance < 0 || distance >= length) {
+		distance = fmod(distance, length);
+		if (distance < 0) {
+			distance += length;
+		}
+	}
+
+	// Binary search for last piece starting at or before distance
+	const double *offsets = network->offsets;
+	unsigned low = 0, high = network->nPieces;
+	while (high - low > 1) {
+		unsigned mid = low + (high - low)/2;
+		if (offsets[mid] <= distance) {
+			low = mid;
+		} else {
+			high = mid;
+		}
+	}
+	fp->piece = low;
+	fp->pos = distance - offsets[low];
+	return fp;
+}
+
+void FlatNetwork_GetCoords(
+	const FlatNetwork *network,
+	const FlatPos     *fp,
+	Scalar            coords[3])
+{
+	const FlatLine *line;
+	const FlatArc  *arc;
+	Scalar pos = fp->pos;
+	switch (network->types[fp->piece]) {
+	case Type_straight:
+		line = &network->lines[network->geometry[fp->piece]];
+		break;
+	case Type_curved:
+		arc = &network->arcs[network->geometry[fp->piece]];
+		if (  arc->straightFirst
+		    ? pos > arc->leadLength
+		    : pos <= arc->arcLength)
+		{
+			if (arc->straightFirst) {
+				pos -= arc->leadLength;
+			}
+			Scalar angle = arc->startAngle;
+			if (arc->arcLength > 0) {
+				angle += arc->arcAngle * pos / arc->arcLength;
+			}
+			coords[0] = arc->originX + arc->radius*cosf(angle);
+			coords[1] = 0;
+			coords[2] = arc->originZ - arc->radius*sinf(angle);
+			return;
+		}
+		if (!arc->straightFirst) {
+			pos -= arc->arcLength;
+		}
+		line = &arc->lead;
+		break;
+	default:
+		abort();
+	}
+	coords[0] = line->startX + pos*line->forwardsX;
+	coords[1] = 0;
+	coords[2] = line->startZ + pos*line->forwardsZ;
+}
+
+void FlatNetwork_GetCoordsBatch(
+	const FlatNetwork *network,
+	const FlatPos     positions[],
+	unsigned          n,
+	Scalar            x[],
+	Scalar            z[])
+{
+	for (unsigned i = 0; i < n; ++i) {
+		Scalar coords[3];
+		FlatNetwork_GetCoords(network, &positions[i], coords);
+		x[i] = coords[0];
+		z[i] = coords[2];
+	}
+}
@@ -0,0 +1,96 @@
+#ifndef FLAT_NETWORK_H_INCLUDED
+#define FLAT_NETWORK_H_INCLUDED
+
+// Ring of track stored as parallel arrays indexed by piece, so traversals
+// read only the lengths and links they need, with no switch on piece type
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "Scalar.h"
+#include "Track.h"
+
+// Geometry of a straight piece, in one 16 byte record as it is read at once
+typedef struct {
+	Scalar startX, startZ,
+	       forwardsX, forwardsZ; // Unit direction
+} FlatLine;
+
+// Geometry of a curved piece: a straight lead-in before or after an arc about
+// origin, swept from startAngle by arcAngle radians (negative clockwise)
+typedef struct {
+	Scalar   originX, originZ,
+	         radius,
+	         startAngle,
+	         arcAngle,
+	         arcLength;
+	FlatLine lead;
+	Scalar   leadLength;
+	bool     straightFirst;
+} FlatArc;
+
+typedef struct {
+	// Hot, read by every traversal
+	Scalar       *lengths;
+	uint32_t     *next,
+	             *prev;
+
+	// Warm, read to find positions and evaluate pieces
+	double       *offsets;  // Distance to start of each piece, then ring length
+	uint8_t      *types;    // Values of TrackShared.type
+	uint32_t     *geometry; // Index into lines for straight pieces, arcs for
+	                        // curved
+	FlatLine     *lines;
+	FlatArc      *arcs;
+
+	// Cold, read to draw
+	TrackShared  **pieces;  // Source pieces, which must outlive network
+
+	unsigned     nPieces,
+	             nLines,
+	             nArcs;
+} FlatNetwork;
+
+// Position on a flat network
+typedef struct {
+	uint32_t piece;
+	Scalar   pos;   // Length through piece
+} FlatPos;
+
+// Builds flat network from the ring of track starting at head, which becomes
+// piece 0. Network must be zeroed, or built before.
+void FlatNetwork_Build(FlatNetwork *network, TrackShared *head);
+
+// Frees memory held by network
+void FlatNetwork_Free(FlatNetwork *network);
+
+// Gets total length of ring
+double FlatNetwork_GetLength(const FlatNetwork *network);
+
+// Moves position along track by given vector (i.e. negative to go backwards),
+// following links piece by piece
+FlatPos *FlatPos_Move(const FlatNetwork *network, FlatPos *fp, Scalar vector);
+
+// Sets position to given distance from start of ring (wraps around)
+FlatPos *FlatPos_SetDistance(
+	const FlatNetwork *network,
+	FlatPos           *fp,
+	double            distance
+);
+
+// Gets coordinates of position
+void FlatNetwork_GetCoords(
+	const FlatNetwork *network,
+	const FlatPos     *fp,
+	Scalar            coords[3]
+);
+
+// Gets x and z coordinates of n positions
+void FlatNetwork_GetCoordsBatch(
+	const FlatNetwork *network,
+	const FlatPos     positions[],
+	unsigned          n,
+	Scalar            x[],
+	Scalar            z[]
+);
+
+#endif // FLAT_NETWORK_H_INCLUDED
@@ -0,0 +1,42 @@
+#include <GL/gl.h>
+#include "Algebra.h"
+
+#include "Frustum.h"
+
+void Frustum_FromGl(Frustum *frustum)
+{
+	GLfloat projection[16], modelview[16], clip[16];
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+	MulMatrix4(clip, projection, modelview);
+
+	// Each plane is the last row of the clip matrix, plus or minus another
+	// row (Gribb & Hartmann)
+	for (unsigned i = 0; i < 6; ++i) {
+		GLfloat sign = i % 2 ? -1 : 1;
+		unsigned row = i / 2;
+		for (unsigned column = 0; column < 4; ++column) {
+			frustum->planes[i][column] =   clip[column*4 + 3]
+			                             + sign*clip[column*4 + row];
+		}
+	}
+}
+
+bool Frustum_IntersectsBox(
+	const Frustum *frustum,
+	const GLfloat min[3],
+	const GLfloat max[3])
+{
+	for (unsigned i = 0; i < 6; ++i) {
+		const GLfloat *plane = frustum->planes[i];
+		// Test the corner furthest along the plane normal
+		GLfloat corner[3];
+		for (unsigned j = 0; j < 3; ++j) {
+			corner[j] = plane[j] >= 0 ? max[j] : min[j];
+		}
+		if (Dot3(plane, corner) + plane[3] < 0) {
+			return false;
+		}
+	}
+	return true;
+}
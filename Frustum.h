@@ -0,0 +1,29 @@
+#ifndef FRUSTUM_H_INCLUDED
+#define FRUSTUM_H_INCLUDED
+
+#include <stdbool.h>
+#include <GL/gl.h>
+
+// View volume as 6 world space planes, ax + by + cz + d >= 0 inside
+typedef struct {
+	GLfloat planes[6][4];
+} Frustum;
+
+// Counts of objects drawn and skipped by culling
+typedef struct {
+	unsigned visible,
+	         culled;
+} CullStats;
+
+// Extracts frustum from current projection and modelview matrices, where
+// modelview holds only the camera transform
+void Frustum_FromGl(Frustum *frustum);
+
+// Gets whether any of axis-aligned box may be inside frustum
+bool Frustum_IntersectsBox(
+	const Frustum *frustum,
+	const GLfloat min[3],
+	const GLfloat max[3]
+);
+
+#endif // FRUSTUM_H_INCLUDED
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <string.h>
+#ifdef __APPLE__
+	#include <GLUT/glut.h>
+#else
+	#include <GL/freeglut.h>
+#endif
+
+#include "GlExt.h"
+
+GlExtFns g_gl;
+
+// Looks up entry point by name, for current context. Goes via a generic
+// function pointer, which may be cast to any other.
+typedef void (*GlProc)(void);
+#define LOAD_AS(fn, type, name) \
+	(g_gl.fn = (type)(GlProc)glutGetProcAddress(name))
+#define LOAD(fn, type) LOAD_AS(fn, type, "gl" #fn)
+
+void GlExt_Load(void)
+{
+	memset(&g_gl, 0, sizeof g_gl);
+
+	if (GlExt_HasVersion(1, 5)) {
+		LOAD(GenBuffers, PFNGLGENBUFFERSPROC);
+		LOAD(DeleteBuffers, PFNGLDELETEBUFFERSPROC);
+		LOAD(BindBuffer, PFNGLBINDBUFFERPROC);
+		LOAD(BufferData, PFNGLBUFFERDATAPROC);
+		LOAD(MapBuffer, PFNGLMAPBUFFERPROC);
+		LOAD(UnmapBuffer, PFNGLUNMAPBUFFERPROC);
+		LOAD(GenQueries, PFNGLGENQUERIESPROC);
+		LOAD(DeleteQueries, PFNGLDELETEQUERIESPROC);
+		LOAD(BeginQuery, PFNGLBEGINQUERYPROC);
+		LOAD(EndQuery, PFNGLENDQUERYPROC);
+	}
+
+	if (GlExt_HasVersion(3, 3) || GlExt_HasExtension("GL_ARB_timer_query")) {
+		LOAD(GetQueryObjectui64v, PFNGLGETQUERYOBJECTUI64VPROC);
+	}
+
+	if (GlExt_HasVersion(2, 0)) {
+		LOAD(CreateShader, PFNGLCREATESHADERPROC);
+		LOAD(DeleteShader, PFNGLDELETESHADERPROC);
+		LOAD(ShaderSource, PFNGLSHADERSOURCEPROC);
+		LOAD(CompileShader, PFNGLCOMPILESHADERPROC);
+		LOAD(GetShaderiv, PFNGLGETSHADERIVPROC);
+		LOAD(GetShaderInfoLog, PFNGLGETSHADERINFOLOGPROC);
+		LOAD(CreateProgram, PFNGLCREATEPROGRAMPROC);
+		LOAD(DeleteProgram, PFNGLDELETEPROGRAMPROC);
+		LOAD(AttachShader, PFNGLATTACHSHADERPROC);
+		LOAD(LinkProgram, PFNGLLINKPROGRAMPROC);
+		LOAD(GetProgramiv, PFNGLGETPROGRAMIVPROC);
+		LOAD(GetProgramInfoLog, PFNGLGETPROGRAMINFOLOGPROC);
+		LOAD(UseProgram, PFNGLUSEPROGRAMPROC);
+		LOAD(GetAttribLocation, PFNGLGETATTRIBLOCATIONPROC);
+		LOAD(EnableVertexAttribArray, PFNGLENABLEVERTEXATTRIBARRAYPROC);
+		LOAD(DisableVertexAttribArray, PFNGLDISABLEVERTEXATTRIBARRAYPROC);
+		LOAD(VertexAttribPointer, PFNGLVERTEXATTRIBPOINTERPROC);
+	}
+
+	if (GlExt_HasVersion(3, 3)) {
+		LOAD(DrawElementsInstanced, PFNGLDRAWELEMENTSINSTANCEDPROC);
+		LOAD(VertexAttribDivisor, PFNGLVERTEXATTRIBDIVISORPROC);
+	} else if (GlExt_HasExtension("GL_ARB_draw_instanced")
+	           && GlExt_HasExtension("GL_ARB_instanced_arrays"))
+	{
+		LOAD_AS(
+			DrawElementsInstanced,
+			PFNGLDRAWELEMENTSINSTANCEDPROC,
+			"glDrawElementsInstancedARB"
+		);
+		LOAD_AS(
+			VertexAttribDivisor,
+			PFNGLVERTEXATTRIBDIVISORPROC,
+			"glVertexAttribDivisorARB"
+		);
+	}
+
+	if (GlExt_HasVersion(3, 0)
+	    || GlExt_HasExtension("GL_ARB_framebuffer_object"))
+	{
+		LOAD(GenFramebuffers, PFNGLGENFRAMEBUFFERSPROC);
+		LOAD(DeleteFramebuffers, PFNGLDELETEFRAMEBUFFERSPROC);
+		LOAD(BindFramebuffer, PFNGLBINDFRAMEBUFFERPROC);
+		LOAD(FramebufferRenderbuffer, PFNGLFRAMEBUFFERRENDERBUFFERPROC);
+		LOAD(CheckFramebufferStatus, PFNGLCHECKFRAMEBUFFERSTATUSPROC);
+		LOAD(BlitFramebuffer, PFNGLBLITFRAMEBUFFERPROC);
+		LOAD(GenRenderbuffers, PFNGLGENRENDERBUFFERSPROC);
+		LOAD(DeleteRenderbuffers, PFNGLDELETERENDERBUFFERSPROC);
+		LOAD(BindRenderbuffer, PFNGLBINDRENDERBUFFERPROC);
+		LOAD(
+			RenderbufferStorageMultisample,
+			PFNGLRENDERBUFFERSTORAGEMULTISAMPLEPROC
+		);
+	}
+}
+
+bool GlExt_HasVersion(int major, int minor)
+{
+	const char *version = (const char *)glGetString(GL_VERSION);
+	int actualMajor, actualMinor;
+	if (!version || sscanf(version, "%d.%d", &actualMajor, &actualMinor) != 2) {
+		return false;
+	}
+	return actualMajor > major
+	       || (actualMajor == major && actualMinor >= minor);
+}
+
+bool GlExt_HasExtension(const char *name)
+{
+	const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+	if (!extensions) {
+		return false;
+	}
+	// Match whole space separated names only, not prefixes of longer ones
+	size_t length = strlen(name);
+	for (const char *match = extensions;
+	     (match = strstr(match, name));
+	     match += length)
+	{
+		if ((match == extensions || match[-1] == ' ')
+		    && (match[length] == ' ' || match[length] == '\0'))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool GlExt_HasBuffers(void)
+{
+	return g_gl.GenBuffers
+	       && g_gl.DeleteBuffers
+	       && g_gl.BindBuffer
+	       && g_gl.BufferData;
+}
+
+bool GlExt_HasPixelBuffers(void)
+{
+	return GlExt_HasBuffers()
+	       && g_gl.MapBuffer
+	       && g_gl.UnmapBuffer
+	       && (   GlExt_HasVersion(2, 1)
+	           || GlExt_HasExtension("GL_ARB_pixel_buffer_object"));
+}
+
+bool GlExt_HasTimerQueries(void)
+{
+	return g_gl.GenQueries
+	       && g_gl.DeleteQueries
+	       && g_gl.BeginQuery
+	       && g_gl.EndQuery
+	       && g_gl.GetQueryObjectui64v;
+}
+
+bool GlExt_HasShaders(void)
+{
+	return g_gl.CreateShader
+	       && g_gl.DeleteShader
+	       && g_gl.ShaderSource
+	       && g_gl.CompileShader
+	       && g_gl.GetShaderiv
+	       && g_gl.GetShaderInfoLog
+	       && g_gl.CreateProgram
+	       && g_gl.DeleteProgram
+	       && g_gl.AttachShader
+	       && g_gl.LinkProgram
+	       && g_gl.GetProgramiv
+	       && g_gl.GetProgramInfoLog
+	       && g_gl.UseProgram
+	       && g_gl.GetAttribLocation
+	       && g_gl.EnableVertexAttribArray
+	       && g_gl.DisableVertexAttribArray
+	       && g_gl.VertexAttribPointer;
+}
+
+bool GlExt_HasInstancing(void)
+{
+	return GlExt_HasBuffers()
+	       && GlExt_HasShaders()
+	       && g_gl.DrawElementsInstanced
+	       && g_gl.VertexAttribDivisor;
+}
+
+bool GlExt_HasFramebuffers(void)
+{
+	return g_gl.GenFramebuffers
+	       && g_gl.DeleteFramebuffers
+	       && g_gl.BindFramebuffer
+	       && g_gl.FramebufferRenderbuffer
+	       && g_gl.CheckFramebufferStatus
+	       && g_gl.BlitFramebuffer
+	       && g_gl.GenRenderbuffers
+	       && g_gl.DeleteRenderbuffers
+	       && g_gl.BindRenderbuffer
+	       && g_gl.RenderbufferStorageMultisample;
+}
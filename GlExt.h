@@ -0,0 +1,92 @@
+#ifndef GL_EXT_H_INCLUDED
+#define GL_EXT_H_INCLUDED
+
+// OpenGL entry points beyond 1.1, loaded at run time
+
+#include <stdbool.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+typedef struct {
+	// Buffer objects, GL 1.5
+	PFNGLGENBUFFERSPROC                     GenBuffers;
+	PFNGLDELETEBUFFERSPROC                  DeleteBuffers;
+	PFNGLBINDBUFFERPROC                     BindBuffer;
+	PFNGLBUFFERDATAPROC                     BufferData;
+	PFNGLMAPBUFFERPROC                      MapBuffer;
+	PFNGLUNMAPBUFFERPROC                    UnmapBuffer;
+
+	// Queries, GL 1.5, with 64-bit results from GL 3.3 or ARB_timer_query
+	PFNGLGENQUERIESPROC                     GenQueries;
+	PFNGLDELETEQUERIESPROC                  DeleteQueries;
+	PFNGLBEGINQUERYPROC                     BeginQuery;
+	PFNGLENDQUERYPROC                       EndQuery;
+	PFNGLGETQUERYOBJECTUI64VPROC            GetQueryObjectui64v;
+
+	// Shaders, GL 2.0
+	PFNGLCREATESHADERPROC                   CreateShader;
+	PFNGLDELETESHADERPROC                   DeleteShader;
+	PFNGLSHADERSOURCEPROC                   ShaderSource;
+	PFNGLCOMPILESHADERPROC                  CompileShader;
+	PFNGLGETSHADERIVPROC                    GetShaderiv;
+	PFNGLGETSHADERINFOLOGPROC               GetShaderInfoLog;
+	PFNGLCREATEPROGRAMPROC                  CreateProgram;
+	PFNGLDELETEPROGRAMPROC                  DeleteProgram;
+	PFNGLATTACHSHADERPROC                   AttachShader;
+	PFNGLLINKPROGRAMPROC                    LinkProgram;
+	PFNGLGETPROGRAMIVPROC                   GetProgramiv;
+	PFNGLGETPROGRAMINFOLOGPROC              GetProgramInfoLog;
+	PFNGLUSEPROGRAMPROC                     UseProgram;
+	PFNGLGETATTRIBLOCATIONPROC              GetAttribLocation;
+	PFNGLENABLEVERTEXATTRIBARRAYPROC        EnableVertexAttribArray;
+	PFNGLDISABLEVERTEXATTRIBARRAYPROC       DisableVertexAttribArray;
+	PFNGLVERTEXATTRIBPOINTERPROC            VertexAttribPointer;
+
+	// Instancing, GL 3.3 or ARB_draw_instanced and ARB_instanced_arrays
+	PFNGLDRAWELEMENTSINSTANCEDPROC          DrawElementsInstanced;
+	PFNGLVERTEXATTRIBDIVISORPROC            VertexAttribDivisor;
+
+	// Framebuffer objects, GL 3.0 or ARB_framebuffer_object
+	PFNGLGENFRAMEBUFFERSPROC                GenFramebuffers;
+	PFNGLDELETEFRAMEBUFFERSPROC             DeleteFramebuffers;
+	PFNGLBINDFRAMEBUFFERPROC                BindFramebuffer;
+	PFNGLFRAMEBUFFERRENDERBUFFERPROC        FramebufferRenderbuffer;
+	PFNGLCHECKFRAMEBUFFERSTATUSPROC         CheckFramebufferStatus;
+	PFNGLBLITFRAMEBUFFERPROC                BlitFramebuffer;
+	PFNGLGENRENDERBUFFERSPROC               GenRenderbuffers;
+	PFNGLDELETERENDERBUFFERSPROC            DeleteRenderbuffers;
+	PFNGLBINDRENDERBUFFERPROC               BindRenderbuffer;
+	PFNGLRENDERBUFFERSTORAGEMULTISAMPLEPROC RenderbufferStorageMultisample;
+} GlExtFns;
+
+// Loaded entry points, null where unsupported
+extern GlExtFns g_gl;
+
+// Loads entry points for current context, must be called once before use
+void GlExt_Load(void);
+
+// Gets whether current context is at least given OpenGL version
+bool GlExt_HasVersion(int major, int minor);
+
+// Gets whether current context advertises named extension
+bool GlExt_HasExtension(const char *name);
+
+// Gets whether buffer objects are usable
+bool GlExt_HasBuffers(void);
+
+// Gets whether pixel buffer objects are usable, for asynchronous readback
+bool GlExt_HasPixelBuffers(void);
+
+// Gets whether GPU timer queries are usable
+bool GlExt_HasTimerQueries(void);
+
+// Gets whether GLSL shaders are usable
+bool GlExt_HasShaders(void);
+
+// Gets whether instanced drawing with per-instance attributes is usable
+bool GlExt_HasInstancing(void);
+
+// Gets whether framebuffer objects (with multisample and blit) are usable
+bool GlExt_HasFramebuffers(void);
+
+#endif // GL_EXT_H_INCLUDED
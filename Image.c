@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "Image.h"
+
+// Most bytes in one uncompressed deflate block
+#define MAX_STORED_BLOCK 65535
+
+static uint32_t crcTable[256];
+
+static uint32_t UpdateCrc(uint32_t crc, const uint8_t *data, size_t size)
+{
+	if (!crcTable[1]) {
+		for (uint32_t n = 0; n < 256; ++n) {
+			uint32_t c = n;
+			for (unsigned k = 0; k < 8; ++k) {
+				c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			}
+			crcTable[n] = c;
+		}
+	}
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i) {
+		crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+static void PutBigEndian(uint8_t *bytes, uint32_t value)
+{
+	bytes[0] = value >> 24;
+	bytes[1] = value >> 16;
+	bytes[2] = value >> 8;
+	bytes[3] = value;
+}
+
+// Writes PNG chunk of given type and data
+static void WriteChunk(
+	FILE          *file,
+	const char    *type,
+	const uint8_t *data,
+	uint32_t      size)
+{
+	uint8_t length[4], crc[4];
+	PutBigEndian(length, size);
+	PutBigEndian(
+		crc,
+		UpdateCrc(UpdateCrc(0, (const uint8_t *)type, 4), data, size)
+	);
+	fwrite(length, 4, 1, file);
+	fwrite(type, 4, 1, file);
+	if (size) {
+		fwrite(data, size, 1, file);
+	}
+	fwrite(crc, 4, 1, file);
+}
+
+// Writes PNG with image data in uncompressed deflate blocks. Files are larger
+// than compressed ones, but take no time to encode, which matters more when
+// capturing every frame.
+static void WritePng(
+	FILE          *file,
+	unsigned      width,
+	unsigned      height,
+	const uint8_t *pixels)
+{
+	static const uint8_t signature[8] = {
+		0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+	};
+	fwrite(signature, sizeof signature, 1, file);
+
+	uint8_t header[13] = {0};
+	PutBigEndian(&header[0], width);
+	PutBigEndian(&header[4], height);
+	header[8] = 8; // Bits per channel
+	header[9] = 2; // RGB
+	WriteChunk(file, "IHDR", header, sizeof header);
+
+	// Rows each start with a filter type byte, 0 for none
+	size_t rowSize = 1 + 3*(size_t)width,
+	       rawSize = rowSize*height,
+	       nBlocks = rawSize ? (rawSize - 1)/MAX_STORED_BLOCK + 1 : 1,
+	       size    = 2 + 5*nBlocks + rawSize + 4;
+	uint8_t *data = malloc(size),
+	        *out  = data;
+	assert(data);
+	*out++ = 0x78; // zlib header: deflate, 32K window, no preset dictionary
+	*out++ = 0x01;
+	uint32_t a = 1, b = 0; // Adler-32 of raw data
+	size_t row = 0, column = 0;
+	for (size_t block = 0; block < nBlocks; ++block) {
+		size_t n = rawSize - block*MAX_STORED_BLOCK;
+		n = n < MAX_STORED_BLOCK ? n : MAX_STORED_BLOCK;
+		*out++ = block + 1 == nBlocks;
+		*out++ = n;
+		*out++ = n >> 8;
+		*out++ = ~n;
+		*out++ = ~n >> 8;
+		for (size_t i = 0; i < n; ++i) {
+			uint8_t byte = column ? pixels[row*(rowSize - 1) + column - 1] : 0;
+			if (++column == rowSize) {
+				column = 0;
+				++row;
+			}
+			*out++ = byte;
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+	}
+	PutBigEndian(out, b << 16 | a);
+	WriteChunk(file, "IDAT", data, size);
+	free(data);
+	WriteChunk(file, "IEND", NULL, 0);
+}
+
+bool Image_Write(
+	const char    *path,
+	unsigned      width,
+	unsigned      height,
+	const uint8_t *pixels)
+{
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		perror(path);
+		return false;
+	}
+	size_t length = strlen(path);
+	if (length >= 4 && !strcmp(path + length - 4, ".png")) {
+		WritePng(file, width, height, pixels);
+	} else {
+		fprintf(file, "P6\n%u %u\n255\n", width, height);
+		fwrite(pixels, 3*(size_t)width, height, file);
+	}
+	bool ok = !ferror(file);
+	ok = !fclose(file) && ok;
+	if (!ok) {
+		perror(path);
+	}
+	return ok;
+}
@@ -0,0 +1,19 @@
+#ifndef IMAGE_H_INCLUDED
+#define IMAGE_H_INCLUDED
+
+// Writing of captured frames to image files, without other libraries
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Writes 8-bit RGB pixels, rows from the top, as a PNG if path ends in .png,
+// otherwise as a raw binary PPM. Returns whether successful, otherwise prints
+// an error to stderr.
+bool Image_Write(
+	const char    *path,
+	unsigned      width,
+	unsigned      height,
+	const uint8_t *pixels
+);
+
+#endif // IMAGE_H_INCLUDED
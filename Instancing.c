@@ -0,0 +1,119 @@
+#include <stddef.h>
+#include <GL/gl.h>
+
+#include "GlExt.h"
+#include "Shader.h"
+
+#include "Instancing.h"
+
+// Places vertex by instance pose, as HeadingMatrix() would, then applies the
+// fixed-function lighting equation for light 0 with an infinite viewer
+static const char vertexSource[] =
+	"#version 120\n"
+	"attribute vec4 pose;\n"
+	"vec3 Rotate(vec3 v)\n"
+	"{\n"
+	"	return vec3(\n"
+	"		pose.z*v.x + pose.w*v.z,\n"
+	"		v.y,\n"
+	"		pose.z*v.z - pose.w*v.x\n"
+	"	);\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"	vec3 position = Rotate(gl_Vertex.xyz) + vec3(pose.x, 0.0, pose.y);\n"
+	"	vec4 eye = gl_ModelViewMatrix * vec4(position, 1.0);\n"
+	"	gl_Position = gl_ProjectionMatrix * eye;\n"
+	"\n"
+	"	vec3 normal = normalize(gl_NormalMatrix * Rotate(gl_Normal));\n"
+	"	vec4 light = gl_LightSource[0].position;\n"
+	"	vec3 toLight = normalize(light.xyz - eye.xyz*light.w);\n"
+	"	float diffuse = max(dot(normal, toLight), 0.0);\n"
+	"	float specular = 0.0;\n"
+	"	if (diffuse > 0.0 && gl_FrontMaterial.shininess > 0.0) {\n"
+	"		vec3 halfway = normalize(toLight + vec3(0.0, 0.0, 1.0));\n"
+	"		specular = pow(\n"
+	"			max(dot(normal, halfway), 0.0),\n"
+	"			gl_FrontMaterial.shininess\n"
+	"		);\n"
+	"	}\n"
+	"	vec4 color = gl_FrontLightModelProduct.sceneColor\n"
+	"	             + gl_FrontLightProduct[0].ambient\n"
+	"	             + diffuse*gl_FrontLightProduct[0].diffuse\n"
+	"	             + specular*gl_FrontLightProduct[0].specular;\n"
+	"	gl_FrontColor = vec4(color.rgb, gl_FrontMaterial.diffuse.a);\n"
+	"}\n";
+
+static const char fragmentSource[] =
+	"#version 120\n"
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = gl_Color;\n"
+	"}\n";
+
+static GLuint program = 0;
+static GLint  poseAttrib;
+
+bool Instancing_Init(void)
+{
+	if (!GlExt_HasInstancing()) {
+		return false;
+	}
+	program = Shader_BuildProgram(vertexSource, fragmentSource);
+	if (!program) {
+		return false;
+	}
+	poseAttrib = g_gl.GetAttribLocation(program, "pose");
+	return true;
+}
+
+bool Instancing_IsAvailable(void)
+{
+	return program != 0;
+}
+
+void InstanceBuffer_Upload(
+	InstanceBuffer     *instances,
+	const InstancePose poses[],
+	unsigned           nInstances,
+	GLenum             usage)
+{
+	if (!instances->buffer) {
+		g_gl.GenBuffers(1, &instances->buffer);
+	}
+	// Respecifying the whole buffer lets the driver orphan the old storage,
+	// rather than waiting for draws still using it
+	g_gl.BindBuffer(GL_ARRAY_BUFFER, instances->buffer);
+	g_gl.BufferData(
+		GL_ARRAY_BUFFER,
+		nInstances * sizeof *poses,
+		poses,
+		usage
+	);
+	g_gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+	instances->nInstances = nInstances;
+}
+
+void InstanceBuffer_Free(InstanceBuffer *instances)
+{
+	if (instances->buffer) {
+		g_gl.DeleteBuffers(1, &instances->buffer);
+	}
+	*instances = (InstanceBuffer){0};
+}
+
+void Instancing_Draw(const Mesh *mesh, const InstanceBuffer *instances)
+{
+	g_gl.UseProgram(program);
+	g_gl.BindBuffer(GL_ARRAY_BUFFER, instances->buffer);
+	g_gl.EnableVertexAttribArray(poseAttrib);
+	g_gl.VertexAttribPointer(poseAttrib, 4, GL_FLOAT, GL_FALSE, 0, NULL);
+	g_gl.VertexAttribDivisor(poseAttrib, 1);
+	g_gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+
+	Mesh_DrawInstanced(mesh, instances->nInstances);
+
+	g_gl.VertexAttribDivisor(poseAttrib, 0);
+	g_gl.DisableVertexAttribArray(poseAttrib);
+	g_gl.UseProgram(0);
+}
@@ -0,0 +1,43 @@
+#ifndef INSTANCING_H_INCLUDED
+#define INSTANCING_H_INCLUDED
+
+// Draws many copies of a mesh standing on the ground in one call per part,
+// lit like the fixed-function pipeline with light 0
+
+#include <stdbool.h>
+#include <GL/gl.h>
+#include "Mesh.h"
+
+// Placement of an instance on the ground, with heading as for HeadingMatrix()
+typedef struct {
+	GLfloat x, z,
+	        cosine, sine;
+} InstancePose;
+
+// Buffer of instance placements
+typedef struct {
+	GLuint   buffer;
+	unsigned nInstances;
+} InstanceBuffer;
+
+// Builds instancing shader. Returns false if instancing is unsupported.
+bool Instancing_Init(void);
+
+// Gets whether Instancing_Init() succeeded
+bool Instancing_IsAvailable(void);
+
+// Replaces buffer contents, with usage hint e.g. GL_STREAM_DRAW
+void InstanceBuffer_Upload(
+	InstanceBuffer     *instances,
+	const InstancePose poses[],
+	unsigned           nInstances,
+	GLenum             usage
+);
+
+// Frees buffer, leaving it empty
+void InstanceBuffer_Free(InstanceBuffer *instances);
+
+// Draws mesh at each instance placement, with current modelview matrix
+void Instancing_Draw(const Mesh *mesh, const InstanceBuffer *instances);
+
+#endif // INSTANCING_H_INCLUDED
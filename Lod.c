@@ -0,0 +1,59 @@
+#include <math.h>
+#include <GL/gl.h>
+#include "Algebra.h"
+
+#include "Lod.h"
+
+void LodView_FromGl(LodView *view)
+{
+	GLfloat projection[16], modelview[16], clip[16];
+	GLint   viewport[4];
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	MulMatrix4(clip, projection, modelview);
+	for (unsigned column = 0; column < 4; ++column) {
+		view->wRow[column] = clip[column*4 + 3];
+	}
+	// Normalized device coordinates span 2 across the viewport
+	view->pixelScale = projection[5] * viewport[3] / 2;
+}
+
+GLfloat LodView_GetSize(
+	const LodView *view,
+	const GLfloat center[3],
+	GLfloat       radius)
+{
+	// Spheres reaching the camera plane are as large as can be
+	GLfloat w = Dot3(view->wRow, center) + view->wRow[3];
+	if (w <= radius) {
+		return HUGE_VALF;
+	}
+	return 2*radius*view->pixelScale / w;
+}
+
+GLfloat LodView_GetNearestScale(
+	const LodView *view,
+	const GLfloat center[3],
+	GLfloat       radius)
+{
+	GLfloat w = Dot3(view->wRow, center) + view->wRow[3] - radius;
+	if (w <= 0) {
+		return HUGE_VALF;
+	}
+	return view->pixelScale / w;
+}
+
+unsigned Lod_Select(
+	const GLfloat thresholds[LOD_LEVELS - 1],
+	unsigned      level,
+	GLfloat       size)
+{
+	while (level < LOD_LEVELS - 1 && size < thresholds[level]) {
+		++level;
+	}
+	while (level > 0 && size > thresholds[level - 1]*(1 + LOD_HYSTERESIS)) {
+		--level;
+	}
+	return level;
+}
@@ -0,0 +1,48 @@
+#ifndef LOD_H_INCLUDED
+#define LOD_H_INCLUDED
+
+// Choice between discrete levels of detail of a model, from its size on screen
+
+#include <GL/gl.h>
+
+// Levels of detail, 0 the finest
+#define LOD_LEVELS 3
+
+// Fraction a size must exceed a level's threshold by to switch back to finer
+// detail, so objects around the threshold don't flicker between levels
+#define LOD_HYSTERESIS 0.25
+
+// Projection of world space sizes to pixels
+typedef struct {
+	GLfloat wRow[4],    // Row of clip matrix giving w of a world space point
+	        pixelScale; // Pixels per unit at w of 1, vertically
+} LodView;
+
+// Extracts view from current projection and modelview matrices, where
+// modelview holds only the camera transform, and the viewport
+void LodView_FromGl(LodView *view);
+
+// Gets diameter in pixels of a sphere, in world space
+GLfloat LodView_GetSize(
+	const LodView *view,
+	const GLfloat center[3],
+	GLfloat       radius
+);
+
+// Gets pixels per world unit at the point of a sphere nearest the camera
+GLfloat LodView_GetNearestScale(
+	const LodView *view,
+	const GLfloat center[3],
+	GLfloat       radius
+);
+
+// Gets level of detail for a size in pixels, given the level it was drawn at
+// last. Detail gets coarser as size falls below each threshold, in
+// decreasing order, and finer only once size exceeds one by LOD_HYSTERESIS.
+unsigned Lod_Select(
+	const GLfloat thresholds[LOD_LEVELS - 1],
+	unsigned      level,
+	GLfloat       size
+);
+
+#endif // LOD_H_INCLUDED
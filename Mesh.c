@@ -0,0 +1,334 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <GL/gl.h>
+
+#include "Algebra.h"
+#include "GlExt.h"
+
+#include "Mesh.h"
+
+#define PI 3.14159265358979323846264338327950288
+
+#define RADS (PI/180)
+
+MeshDrawStats g_meshDrawStats;
+
+void Material_Apply(const Material *material)
+{
+	glMaterialfv(GL_FRONT, GL_AMBIENT, material->ambient);
+	glMaterialfv(GL_FRONT, GL_DIFFUSE, material->diffuse);
+	glMaterialfv(GL_FRONT, GL_SPECULAR, material->specular);
+	glMaterialf(GL_FRONT, GL_SHININESS, material->shininess);
+}
+
+void MeshBuilder_Init(MeshBuilder *builder)
+{
+	*builder = (MeshBuilder){0};
+	GLfloat *matrix = builder->matrices[0];
+	matrix[0] = matrix[5] = matrix[10] = matrix[15] = 1;
+}
+
+void MeshBuilder_SetMaterial(MeshBuilder *builder, const Material *material)
+{
+	MeshPart *last = builder->nParts ? &builder->parts[builder->nParts - 1]
+	                                 : NULL;
+	if (last && !memcmp(&last->material, material, sizeof *material)) {
+		return;
+	}
+	// Reuse last part if nothing was drawn with it
+	if (!last || last->nIndices) {
+		builder->parts = realloc(
+			builder->parts,
+			(builder->nParts + 1) * sizeof *builder->parts
+		);
+		assert(builder->parts);
+		last = &builder->parts[builder->nParts++];
+	}
+	*last = (MeshPart){*material, builder->nIndices, 0};
+}
+
+void MeshBuilder_PushMatrix(MeshBuilder *builder)
+{
+	assert(builder->depth + 1 < MESH_STACK_DEPTH);
+	memcpy(
+		builder->matrices[builder->depth + 1],
+		builder->matrices[builder->depth],
+		sizeof builder->matrices[0]
+	);
+	++builder->depth;
+}
+
+void MeshBuilder_PopMatrix(MeshBuilder *builder)
+{
+	assert(builder->depth > 0);
+	--builder->depth;
+}
+
+void MeshBuilder_MultMatrix(MeshBuilder *builder, const GLfloat matrix[16])
+{
+	GLfloat *current = builder->matrices[builder->depth];
+	GLfloat result[16];
+	MulMatrix4(result, current, matrix);
+	memcpy(current, result, sizeof result);
+}
+
+void MeshBuilder_Translate(
+	MeshBuilder *builder,
+	GLfloat     x,
+	GLfloat     y,
+	GLfloat     z)
+{
+	MeshBuilder_MultMatrix(builder, (GLfloat [16]){
+		1, 0, 0, 0,
+		0, 1, 0, 0,
+		0, 0, 1, 0,
+		x, y, z, 1
+	});
+}
+
+void MeshBuilder_Scale(
+	MeshBuilder *builder,
+	GLfloat     x,
+	GLfloat     y,
+	GLfloat     z)
+{
+	MeshBuilder_MultMatrix(builder, (GLfloat [16]){
+		x, 0, 0, 0,
+		0, y, 0, 0,
+		0, 0, z, 0,
+		0, 0, 0, 1
+	});
+}
+
+void MeshBuilder_Rotate(
+	MeshBuilder *builder,
+	GLfloat     angle,
+	GLfloat     x,
+	GLfloat     y,
+	GLfloat     z)
+{
+	GLfloat axis[3];
+	Normalize3(axis, (GLfloat [3]){x, y, z});
+	x = axis[0];
+	y = axis[1];
+	z = axis[2];
+	GLfloat c = cosf(RADS*angle), s = sinf(RADS*angle), t = 1 - c;
+	MeshBuilder_MultMatrix(builder, (GLfloat [16]){
+		x*x*t + c,   y*x*t + z*s, x*z*t - y*s, 0,
+		x*y*t - z*s, y*y*t + c,   y*z*t + x*s, 0,
+		x*z*t + y*s, y*z*t - x*s, z*z*t + c,   0,
+		0,           0,           0,           1
+	});
+}
+
+GLuint MeshBuilder_AddVertex(
+	MeshBuilder   *builder,
+	const GLfloat position[3],
+	const GLfloat normal[3])
+{
+	if (builder->nVertices == builder->verticesSize) {
+		builder->verticesSize = builder->verticesSize*2 + 64;
+		builder->vertices = realloc(
+			builder->vertices,
+			builder->verticesSize * sizeof *builder->vertices
+		);
+		assert(builder->vertices);
+	}
+	const GLfloat *matrix = builder->matrices[builder->depth];
+	MeshVertex *vertex = &builder->vertices[builder->nVertices];
+	TransformPoint3(vertex->position, matrix, position);
+
+	// Transform normal by inverse transpose, from cofactors of the columns
+	GLfloat bc[3], ca[3], ab[3], transformed[3];
+	Cross3(bc, &matrix[4], &matrix[8]);
+	Cross3(ca, &matrix[8], &matrix[0]);
+	Cross3(ab, &matrix[0], &matrix[4]);
+	for (unsigned i = 0; i < 3; ++i) {
+		transformed[i] = bc[i]*normal[0] + ca[i]*normal[1] + ab[i]*normal[2];
+	}
+	if (Dot3(&matrix[0], bc) < 0) {
+		Scalar3(transformed, -1, transformed);
+	}
+	Normalize3(vertex->normal, transformed);
+
+	return builder->nVertices++;
+}
+
+void MeshBuilder_AddTriangle(
+	MeshBuilder *builder,
+	GLuint      a,
+	GLuint      b,
+	GLuint      c)
+{
+	assert(builder->nParts);
+	if (builder->nIndices + 3 > builder->indicesSize) {
+		builder->indicesSize = builder->indicesSize*2 + 96;
+		builder->indices = realloc(
+			builder->indices,
+			builder->indicesSize * sizeof *builder->indices
+		);
+		assert(builder->indices);
+	}
+	GLuint *index = &builder->indices[builder->nIndices];
+	index[0] = a;
+	index[1] = b;
+	index[2] = c;
+	builder->nIndices += 3;
+	builder->parts[builder->nParts - 1].nIndices += 3;
+}
+
+void MeshBuilder_AddQuad(
+	MeshBuilder *builder,
+	GLuint      a,
+	GLuint      b,
+	GLuint      c,
+	GLuint      d)
+{
+	MeshBuilder_AddTriangle(builder, a, b, c);
+	MeshBuilder_AddTriangle(builder, a, c, d);
+}
+
+void MeshBuilder_AddStrip(MeshBuilder *builder, GLuint first, unsigned count)
+{
+	for (unsigned i = 0; i + 2 < count; ++i) {
+		GLuint v = first + i;
+		if (i % 2) {
+			MeshBuilder_AddTriangle(builder, v + 1, v, v + 2);
+		} else {
+			MeshBuilder_AddTriangle(builder, v, v + 1, v + 2);
+		}
+	}
+}
+
+void MeshBuilder_AddFan(MeshBuilder *builder, GLuint first, unsigned count)
+{
+	for (unsigned i = 1; i + 1 < count; ++i) {
+		MeshBuilder_AddTriangle(builder, first, first + i, first + i + 1);
+	}
+}
+
+void Mesh_Build(Mesh *mesh, MeshBuilder *builder)
+{
+	*mesh = (Mesh){
+		.vertices  = builder->vertices,
+		.indices   = builder->indices,
+		.parts     = builder->parts,
+		.nVertices = builder->nVertices,
+		.nIndices  = builder->nIndices,
+		.nParts    = builder->nParts
+	};
+	*builder = (MeshBuilder){0};
+
+	// Keep geometry in client memory only if buffer objects are unsupported
+	if (!GlExt_HasBuffers()) {
+		return;
+	}
+	g_gl.GenBuffers(1, &mesh->vertexBuffer);
+	g_gl.GenBuffers(1, &mesh->indexBuffer);
+	g_gl.BindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
+	g_gl.BufferData(
+		GL_ARRAY_BUFFER,
+		mesh->nVertices * sizeof *mesh->vertices,
+		mesh->vertices,
+		GL_STATIC_DRAW
+	);
+	g_gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+	g_gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+	g_gl.BufferData(
+		GL_ELEMENT_ARRAY_BUFFER,
+		mesh->nIndices * sizeof *mesh->indices,
+		mesh->indices,
+		GL_STATIC_DRAW
+	);
+	g_gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	free(mesh->vertices);
+	free(mesh->indices);
+	mesh->vertices = NULL;
+	mesh->indices = NULL;
+}
+
+// Draws mesh parts, instanced if nInstances is not 0
+static void DrawParts(const Mesh *mesh, GLsizei nInstances)
+{
+	const char   *vertices = (const char *)mesh->vertices;
+	const GLuint *indices  = mesh->indices;
+	if (mesh->vertexBuffer) {
+		// Pointers become offsets into bound buffers
+		g_gl.BindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
+		g_gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+		vertices = NULL;
+		indices = NULL;
+	}
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(
+		3,
+		GL_FLOAT,
+		sizeof(MeshVertex),
+		vertices + offsetof(MeshVertex, position)
+	);
+	glNormalPointer(
+		GL_FLOAT,
+		sizeof(MeshVertex),
+		vertices + offsetof(MeshVertex, normal)
+	);
+
+	for (unsigned i = 0; i < mesh->nParts; ++i) {
+		const MeshPart *part = &mesh->parts[i];
+		Material_Apply(&part->material);
+		++g_meshDrawStats.drawCalls;
+		g_meshDrawStats.triangles +=
+			part->nIndices/3 * (unsigned long)(nInstances ? nInstances : 1);
+		if (nInstances) {
+			g_gl.DrawElementsInstanced(
+				GL_TRIANGLES,
+				part->nIndices,
+				GL_UNSIGNED_INT,
+				indices + part->firstIndex,
+				nInstances
+			);
+		} else {
+			glDrawElements(
+				GL_TRIANGLES,
+				part->nIndices,
+				GL_UNSIGNED_INT,
+				indices + part->firstIndex
+			);
+		}
+	}
+
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	if (mesh->vertexBuffer) {
+		g_gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+		g_gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+}
+
+void Mesh_Draw(const Mesh *mesh)
+{
+	DrawParts(mesh, 0);
+}
+
+void Mesh_DrawInstanced(const Mesh *mesh, GLsizei nInstances)
+{
+	if (nInstances) {
+		DrawParts(mesh, nInstances);
+	}
+}
+
+void Mesh_Free(Mesh *mesh)
+{
+	if (mesh->vertexBuffer) {
+		g_gl.DeleteBuffers(1, &mesh->vertexBuffer);
+		g_gl.DeleteBuffers(1, &mesh->indexBuffer);
+	}
+	free(mesh->vertices);
+	free(mesh->indices);
+	free(mesh->parts);
+	*mesh = (Mesh){0};
+}
@@ -0,0 +1,141 @@
+#ifndef MESH_H_INCLUDED
+#define MESH_H_INCLUDED
+
+// Indexed triangle meshes in vertex buffers, built up on the CPU with a
+// matrix stack like OpenGL's
+
+#include <GL/gl.h>
+
+// Fixed-function lighting material
+typedef struct {
+	GLfloat ambient[4],
+	        diffuse[4],
+	        specular[4],
+	        shininess;
+} Material;
+
+// Sets current OpenGL material for front faces
+void Material_Apply(const Material *material);
+
+// Interleaved vertex attributes
+typedef struct {
+	GLfloat position[3],
+	        normal[3];
+} MeshVertex;
+
+// Range of indices drawn with one material
+typedef struct {
+	Material material;
+	unsigned firstIndex,
+	         nIndices;
+} MeshPart;
+
+#define MESH_STACK_DEPTH 8
+
+// Mesh under construction. Vertices added are transformed by the current
+// matrix, triangles are drawn with the current material.
+typedef struct {
+	MeshVertex *vertices;
+	GLuint     *indices;
+	MeshPart   *parts;
+	unsigned   nVertices, verticesSize,
+	           nIndices, indicesSize,
+	           nParts;
+	GLfloat    matrices[MESH_STACK_DEPTH][16];
+	unsigned   depth;
+} MeshBuilder;
+
+// Mesh ready for drawing
+typedef struct {
+	GLuint     vertexBuffer, // Buffer objects, 0 if unsupported
+	           indexBuffer;
+	MeshVertex *vertices;    // Client side arrays, if no buffer objects
+	GLuint     *indices;
+	MeshPart   *parts;
+	unsigned   nVertices,
+	           nIndices,
+	           nParts;
+} Mesh;
+
+// Counts of geometry submitted by mesh draws, reset by whoever reads them
+typedef struct {
+	unsigned long drawCalls,
+	              triangles;
+} MeshDrawStats;
+
+extern MeshDrawStats g_meshDrawStats;
+
+// Initializes empty builder with identity matrix
+void MeshBuilder_Init(MeshBuilder *builder);
+
+// Sets material for following triangles
+void MeshBuilder_SetMaterial(MeshBuilder *builder, const Material *material);
+
+// Matrix stack operations, as for glPushMatrix() etc.
+void MeshBuilder_PushMatrix(MeshBuilder *builder);
+void MeshBuilder_PopMatrix(MeshBuilder *builder);
+void MeshBuilder_MultMatrix(MeshBuilder *builder, const GLfloat matrix[16]);
+void MeshBuilder_Translate(
+	MeshBuilder *builder,
+	GLfloat     x,
+	GLfloat     y,
+	GLfloat     z
+);
+void MeshBuilder_Scale(
+	MeshBuilder *builder,
+	GLfloat     x,
+	GLfloat     y,
+	GLfloat     z
+);
+void MeshBuilder_Rotate(
+	MeshBuilder *builder,
+	GLfloat     angle, // Degrees
+	GLfloat     x,
+	GLfloat     y,
+	GLfloat     z
+);
+
+// Adds vertex transformed by current matrix, returns its index
+GLuint MeshBuilder_AddVertex(
+	MeshBuilder   *builder,
+	const GLfloat position[3],
+	const GLfloat normal[3]
+);
+
+// Adds triangle of vertex indices, anticlockwise facing front
+void MeshBuilder_AddTriangle(
+	MeshBuilder *builder,
+	GLuint      a,
+	GLuint      b,
+	GLuint      c
+);
+
+// Adds quad of vertex indices, anticlockwise facing front, as with GL_QUADS
+void MeshBuilder_AddQuad(
+	MeshBuilder *builder,
+	GLuint      a,
+	GLuint      b,
+	GLuint      c,
+	GLuint      d
+);
+
+// Adds triangles as with GL_TRIANGLE_STRIP over consecutive vertices
+void MeshBuilder_AddStrip(MeshBuilder *builder, GLuint first, unsigned count);
+
+// Adds triangles as with GL_TRIANGLE_FAN over consecutive vertices
+void MeshBuilder_AddFan(MeshBuilder *builder, GLuint first, unsigned count);
+
+// Uploads built geometry to mesh, and frees builder
+void Mesh_Build(Mesh *mesh, MeshBuilder *builder);
+
+// Draws mesh with current modelview matrix
+void Mesh_Draw(const Mesh *mesh);
+
+// Draws mesh nInstances times in one call per part. Per-instance attributes
+// must already be set up, with a shader program to apply them.
+void Mesh_DrawInstanced(const Mesh *mesh, GLsizei nInstances);
+
+// Frees mesh's buffers, leaving it empty
+void Mesh_Free(Mesh *mesh);
+
+#endif // MESH_H_INCLUDED
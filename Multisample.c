@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <GL/gl.h>
+
+#include "GlExt.h"
+#include "Screen.h"
+
+#include "Multisample.h"
+
+static GLuint   framebuffer,
+                colorBuffer,
+                depthBuffer;
+static unsigned nSamples = 0;
+static int      width,
+                height;
+
+// Allocates storage for renderbuffers at current size and sample count
+static void AllocBuffers(void)
+{
+	g_gl.BindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	g_gl.RenderbufferStorageMultisample(
+		GL_RENDERBUFFER,
+		nSamples,
+		GL_RGBA8,
+		width,
+		height
+	);
+	g_gl.BindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	g_gl.RenderbufferStorageMultisample(
+		GL_RENDERBUFFER,
+		nSamples,
+		GL_DEPTH_COMPONENT24,
+		width,
+		height
+	);
+	g_gl.BindRenderbuffer(GL_RENDERBUFFER, 0);
+}
+
+bool Multisample_Init(unsigned samples)
+{
+	if (!samples || !GlExt_HasFramebuffers()) {
+		return false;
+	}
+
+	GLint maxSamples = 0;
+	glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+	if (maxSamples < 2) {
+		return false;
+	}
+	nSamples = samples < (unsigned)maxSamples ? samples : (unsigned)maxSamples;
+	width = g_screenWidth;
+	height = g_screenHeight;
+
+	// Renderbuffers must exist before being attached
+	g_gl.GenRenderbuffers(1, &colorBuffer);
+	g_gl.GenRenderbuffers(1, &depthBuffer);
+	AllocBuffers();
+
+	g_gl.GenFramebuffers(1, &framebuffer);
+	g_gl.BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	g_gl.FramebufferRenderbuffer(
+		GL_FRAMEBUFFER,
+		GL_COLOR_ATTACHMENT0,
+		GL_RENDERBUFFER,
+		colorBuffer
+	);
+	g_gl.FramebufferRenderbuffer(
+		GL_FRAMEBUFFER,
+		GL_DEPTH_ATTACHMENT,
+		GL_RENDERBUFFER,
+		depthBuffer
+	);
+	GLenum status = g_gl.CheckFramebufferStatus(GL_FRAMEBUFFER);
+	g_gl.BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(
+			stderr,
+			"Multisampled framebuffer with %u samples incomplete, "
+			"status 0x%x\n",
+			nSamples,
+			status
+		);
+		g_gl.DeleteFramebuffers(1, &framebuffer);
+		g_gl.DeleteRenderbuffers(1, &colorBuffer);
+		g_gl.DeleteRenderbuffers(1, &depthBuffer);
+		nSamples = 0;
+		return false;
+	}
+	return true;
+}
+
+unsigned Multisample_GetSamples(void)
+{
+	return nSamples;
+}
+
+void Multisample_Resize(int newWidth, int newHeight)
+{
+	if (!nSamples || (newWidth == width && newHeight == height)) {
+		return;
+	}
+	width = newWidth;
+	height = newHeight;
+	AllocBuffers();
+}
+
+void Multisample_Begin(void)
+{
+	if (nSamples) {
+		g_gl.BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	}
+}
+
+void Multisample_End(void)
+{
+	if (!nSamples) {
+		return;
+	}
+	g_gl.BindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	g_gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	g_gl.BlitFramebuffer(
+		0, 0, width, height,
+		0, 0, width, height,
+		GL_COLOR_BUFFER_BIT,
+		GL_NEAREST
+	);
+	g_gl.BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,26 @@
+#ifndef MULTISAMPLE_H_INCLUDED
+#define MULTISAMPLE_H_INCLUDED
+
+// Anti-aliasing by rendering into a multisampled framebuffer object, then
+// resolving it to the window in one blit
+
+#include <stdbool.h>
+
+// Creates framebuffer with up to given samples per pixel, for screen size.
+// Returns false if multisampling is unavailable, then other calls do nothing.
+bool Multisample_Init(unsigned samples);
+
+// Gets samples per pixel actually used, 0 if unavailable
+unsigned Multisample_GetSamples(void);
+
+// Reallocates framebuffer for new screen size
+void Multisample_Resize(int width, int height);
+
+// Directs following drawing to the multisampled framebuffer
+void Multisample_Begin(void);
+
+// Resolves multisampled framebuffer to the window's back buffer, and directs
+// following drawing there again
+void Multisample_End(void);
+
+#endif // MULTISAMPLE_H_INCLUDED
@@ -0,0 +1,227 @@
+// Offscreen backend, linked in place of GLUT when built with BACKEND=egl.
+// Implements the GLUT calls the program makes on a surfaceless EGL context,
+// rendered by Mesa's software rasterizer where there is no GPU, so the usual
+// display callback draws each frame without a window system. Takes its own
+// arguments in glutInit(), as GLUT does:
+//   --frames N       Frames to draw before exiting, by default 1
+//   --output PATTERN printf() pattern for a path to save each frame to, given
+//                    its number as an unsigned int, e.g. frame%04u.png. Saved
+//                    as PNG if it ends in .png, otherwise as PPM.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/freeglut.h>
+#include "Clock.h"
+#include "Image.h"
+
+#define UNUSED(x) (void)(x)
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLSurface surface = EGL_NO_SURFACE;
+static int        width   = 300,
+                  height  = 300;
+static void       (*displayFunc)(void),
+                  (*reshapeFunc)(int, int);
+
+// Frames to draw, and pattern of paths to save them to, or null
+static unsigned   nFrames = 1,
+                  nSwaps  = 0;
+static const char *outputPattern = NULL;
+static uint8_t    *pixels,
+                  *row;
+
+// Removes n arguments at i from argv
+static void RemoveArgs(int *argc, char **argv, int i, int n)
+{
+	memmove(&argv[i], &argv[i + n], (*argc - i - n + 1) * sizeof *argv);
+	*argc -= n;
+}
+
+void glutInit(int *argc, char **argv)
+{
+	for (int i = 1; i < *argc;) {
+		if (!strcmp(argv[i], "--frames") && i + 1 < *argc) {
+			nFrames = strtoul(argv[i + 1], NULL, 10);
+			RemoveArgs(argc, argv, i, 2);
+		} else if (!strcmp(argv[i], "--output") && i + 1 < *argc) {
+			outputPattern = argv[i + 1];
+			RemoveArgs(argc, argv, i, 2);
+		} else {
+			++i;
+		}
+	}
+
+	// Prefer a display with no window system, where Mesa supports one
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)
+			eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay) {
+		display = getPlatformDisplay(
+			EGL_PLATFORM_SURFACELESS_MESA,
+			EGL_DEFAULT_DISPLAY,
+			NULL
+		);
+	}
+	if (display == EGL_NO_DISPLAY) {
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	if (   display == EGL_NO_DISPLAY
+	    || !eglInitialize(display, NULL, NULL)
+	    || !eglBindAPI(EGL_OPENGL_API))
+	{
+		fprintf(stderr, "Cannot initialize EGL for desktop OpenGL\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void glutInitWindowPosition(int x, int y)
+{
+	UNUSED(x); UNUSED(y);
+}
+
+void glutInitWindowSize(int newWidth, int newHeight)
+{
+	width = newWidth;
+	height = newHeight;
+}
+
+// Buffers are always single RGB with depth. There is no accumulation buffer,
+// so anti-aliasing needs multisampled framebuffers.
+void glutInitDisplayMode(unsigned int displayMode)
+{
+	UNUSED(displayMode);
+}
+
+int glutCreateWindow(const char *title)
+{
+	UNUSED(title);
+	static const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE,        8,
+		EGL_GREEN_SIZE,      8,
+		EGL_BLUE_SIZE,       8,
+		EGL_DEPTH_SIZE,      24,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint    nConfigs;
+	if (   !eglChooseConfig(display, configAttribs, &config, 1, &nConfigs)
+	    || !nConfigs)
+	{
+		fprintf(stderr, "No EGL config for offscreen OpenGL rendering\n");
+		exit(EXIT_FAILURE);
+	}
+	const EGLint surfaceAttribs[] = {
+		EGL_WIDTH,  width,
+		EGL_HEIGHT, height,
+		EGL_NONE
+	};
+	surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+	EGLContext context = eglCreateContext(
+		display,
+		config,
+		EGL_NO_CONTEXT,
+		NULL
+	);
+	if (   surface == EGL_NO_SURFACE
+	    || context == EGL_NO_CONTEXT
+	    || !eglMakeCurrent(display, surface, surface, context))
+	{
+		fprintf(stderr, "Cannot create offscreen OpenGL context\n");
+		exit(EXIT_FAILURE);
+	}
+	pixels = malloc(3*(size_t)width*height);
+	row = malloc(3*(size_t)width);
+	assert(pixels && row);
+	return 1;
+}
+
+void glutDisplayFunc(void (*callback)(void))
+{
+	displayFunc = callback;
+}
+
+void glutReshapeFunc(void (*callback)(int, int))
+{
+	reshapeFunc = callback;
+}
+
+// No input arrives offscreen
+void glutKeyboardFunc(void (*callback)(unsigned char, int, int))
+{
+	UNUSED(callback);
+}
+
+void glutSpecialFunc(void (*callback)(int, int, int))
+{
+	UNUSED(callback);
+}
+
+// Frames are drawn back to back, without waiting for timers
+void glutTimerFunc(unsigned int time, void (*callback)(int), int value)
+{
+	UNUSED(time); UNUSED(callback); UNUSED(value);
+}
+
+void glutPostRedisplay(void)
+{
+}
+
+// Saves frame, if saving them, and counts it
+void glutSwapBuffers(void)
+{
+	if (outputPattern) {
+		// Read tightly packed rows, then flip them to start from the top
+		size_t rowSize = 3*(size_t)width;
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+		for (int y = 0; y < height/2; ++y) {
+			uint8_t *top    = &pixels[rowSize*y],
+			        *bottom = &pixels[rowSize*(height - 1 - y)];
+			memcpy(row, top, rowSize);
+			memcpy(top, bottom, rowSize);
+			memcpy(bottom, row, rowSize);
+		}
+		char path[4096];
+		snprintf(path, sizeof path, outputPattern, nSwaps);
+		if (!Image_Write(path, width, height, pixels)) {
+			exit(EXIT_FAILURE);
+		}
+	}
+	eglSwapBuffers(display, surface);
+	++nSwaps;
+}
+
+void glutMainLoop(void)
+{
+	if (reshapeFunc) {
+		reshapeFunc(width, height);
+	}
+	double start = Clock_GetSeconds();
+	while (nSwaps < nFrames) {
+		displayFunc();
+	}
+	glFinish();
+	double seconds = Clock_GetSeconds() - start;
+	fprintf(
+		stderr,
+		"Drew %u frames in %.3f s, %.3f ms per frame\n",
+		nSwaps,
+		seconds,
+		nSwaps ? 1000*seconds/nSwaps : 0
+	);
+	exit(EXIT_SUCCESS);
+}
+
+GLUTproc glutGetProcAddress(const char *name)
+{
+	return (GLUTproc)eglGetProcAddress(name);
+}
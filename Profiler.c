@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <GL/gl.h>
+#include "GlExt.h"
+
+#include "Profiler.h"
+
+// Most phases timed on the GPU per frame, enough for each draw of jittered
+// anti-aliasing
+#define MAX_INTERVALS 64
+
+// Graph scale, in pixels
+#define GRAPH_PIXELS_PER_MS 4
+#define GRAPH_FRAME_WIDTH   2
+#define GRAPH_GAP           10
+
+typedef struct {
+	double cpu[BenchPhase_nPhases], // Seconds
+	       gpu[BenchPhase_nPhases];
+	bool   hasGpu;                  // Whether GPU times have been read
+} ProfileFrame;
+
+// Timer queries of a frame, one per interval a phase was timed
+typedef struct {
+	GLuint     queries[MAX_INTERVALS];
+	BenchPhase phases[MAX_INTERVALS];
+	unsigned   nIntervals;
+} QuerySet;
+
+static const GLfloat phaseColors[BenchPhase_nPhases][3] = {
+	{0.5, 0.5, 0.5}, // Simulation
+	{1.0, 1.0, 1.0}, // Camera
+	{0.2, 0.8, 0.2}, // Ground
+	{1.0, 1.0, 0.2}, // Lighting
+	{1.0, 0.2, 0.2}, // Train
+	{0.6, 0.4, 0.2}, // Track
+	{1.0, 0.6, 0.0}, // Slats
+	{0.3, 0.5, 1.0}  // Swap
+};
+
+// Frame n is kept in history[n % PROFILER_HISTORY], and its queries in
+// querySets[n % PROFILER_LATENCY] until read
+static ProfileFrame  history[PROFILER_HISTORY];
+static QuerySet      querySets[PROFILER_LATENCY];
+static unsigned long nFrames = 0; // Ended, so number of frame being timed
+static bool          timerQueries = false,
+                     querying     = false,
+                     overlay      = false;
+static BenchPhase    currentPhase = BenchPhase_nPhases;
+static double        phaseStart;
+static FILE          *csv = NULL;
+static const char    *csvPath;
+
+void Profiler_Init(const char *path)
+{
+	timerQueries = GlExt_HasTimerQueries();
+	if (timerQueries) {
+		for (unsigned i = 0; i < PROFILER_LATENCY; ++i) {
+			g_gl.GenQueries(MAX_INTERVALS, querySets[i].queries);
+		}
+	}
+
+	csvPath = path;
+	if (!path) {
+		return;
+	}
+	if (!(csv = fopen(path, "w"))) {
+		perror(path);
+		return;
+	}
+	fprintf(csv, "frame");
+	for (unsigned i = 0; i < BenchPhase_nPhases; ++i) {
+		fprintf(csv, ",%s_cpu_ms", Bench_GetPhaseName(i));
+	}
+	for (unsigned i = 0; i < BenchPhase_nPhases; ++i) {
+		fprintf(csv, ",%s_gpu_ms", Bench_GetPhaseName(i));
+	}
+	fprintf(csv, "\n");
+}
+
+// Reads GPU times of an ended frame, waiting for any still being rendered,
+// and writes the frame to the CSV file
+static void CompleteFrame(unsigned long n)
+{
+	ProfileFrame *frame = &history[n % PROFILER_HISTORY];
+	QuerySet     *set   = &querySets[n % PROFILER_LATENCY];
+	if (timerQueries) {
+		for (unsigned i = 0; i < set->nIntervals; ++i) {
+			GLuint64 nanoseconds;
+			g_gl.GetQueryObjectui64v(
+				set->queries[i],
+				GL_QUERY_RESULT,
+				&nanoseconds
+			);
+			frame->gpu[set->phases[i]] += nanoseconds * 1e-9;
+		}
+		frame->hasGpu = true;
+	}
+	set->nIntervals = 0;
+
+	if (!csv) {
+		return;
+	}
+	fprintf(csv, "%lu", n);
+	for (unsigned i = 0; i < BenchPhase_nPhases; ++i) {
+		fprintf(csv, ",%.4f", 1000*frame->cpu[i]);
+	}
+	for (unsigned i = 0; i < BenchPhase_nPhases; ++i) {
+		if (frame->hasGpu) {
+			fprintf(csv, ",%.4f", 1000*frame->gpu[i]);
+		} else {
+			fprintf(csv, ",");
+		}
+	}
+	fprintf(csv, "\n");
+}
+
+void Profiler_Free(void)
+{
+	unsigned long first = nFrames >= PROFILER_LATENCY
+	                    ? nFrames - PROFILER_LATENCY + 1
+	                    : 0;
+	for (unsigned long n = first; n < nFrames; ++n) {
+		CompleteFrame(n);
+	}
+	if (timerQueries) {
+		for (unsigned i = 0; i < PROFILER_LATENCY; ++i) {
+			g_gl.DeleteQueries(MAX_INTERVALS, querySets[i].queries);
+		}
+		timerQueries = false;
+	}
+	if (csv && fclose(csv)) {
+		perror(csvPath);
+	}
+	csv = NULL;
+}
+
+void Profiler_BeginPhase(BenchPhase phase, double now)
+{
+	ProfileFrame *frame = &history[nFrames % PROFILER_HISTORY];
+	QuerySet     *set   = &querySets[nFrames % PROFILER_LATENCY];
+	if (currentPhase != BenchPhase_nPhases) {
+		frame->cpu[currentPhase] += now - phaseStart;
+	}
+	if (querying) {
+		g_gl.EndQuery(GL_TIME_ELAPSED);
+		querying = false;
+	}
+	currentPhase = phase;
+	phaseStart = now;
+
+	// Phases beyond the frame's queries are only timed on the CPU
+	if (   phase != BenchPhase_nPhases
+	    && timerQueries
+	    && set->nIntervals < MAX_INTERVALS)
+	{
+		g_gl.BeginQuery(GL_TIME_ELAPSED, set->queries[set->nIntervals]);
+		set->phases[set->nIntervals++] = phase;
+		querying = true;
+	}
+}
+
+// Prints mean milliseconds per phase over frames in history to stderr
+static void PrintSummary(void)
+{
+	double   cpu[BenchPhase_nPhases] = {0},
+	         gpu[BenchPhase_nPhases] = {0};
+	unsigned nGpu = 0;
+	for (unsigned i = 0; i < PROFILER_HISTORY; ++i) {
+		const ProfileFrame *frame = &history[i];
+		for (unsigned j = 0; j < BenchPhase_nPhases; ++j) {
+			cpu[j] += frame->cpu[j];
+			gpu[j] += frame->gpu[j];
+		}
+		nGpu += frame->hasGpu;
+	}
+	fprintf(stderr, "Mean ms over %u frames, CPU/GPU:", PROFILER_HISTORY);
+	for (unsigned i = 0; i < BenchPhase_nPhases; ++i) {
+		fprintf(
+			stderr,
+			" %s %.3f/%.3f",
+			Bench_GetPhaseName(i),
+			1000*cpu[i]/PROFILER_HISTORY,
+			nGpu ? 1000*gpu[i]/nGpu : 0
+		);
+	}
+	fprintf(stderr, "\n");
+}
+
+void Profiler_EndFrame(void)
+{
+	assert(currentPhase == BenchPhase_nPhases);
+
+	// Queries of the frame drawn longest ago are reused by the next
+	unsigned long next = nFrames + 1;
+	if (next >= PROFILER_LATENCY) {
+		CompleteFrame(next - PROFILER_LATENCY);
+	}
+	nFrames = next;
+
+	// Summarize once a full history has passed, then start next frame over
+	// the oldest
+	if (overlay && nFrames % PROFILER_HISTORY == 0) {
+		PrintSummary();
+	}
+	history[nFrames % PROFILER_HISTORY] = (ProfileFrame){.hasGpu = false};
+}
+
+void Profiler_ToggleOverlay(void)
+{
+	overlay = !overlay;
+}
+
+// Draws bars of each frame's phase times, stacked, oldest frame leftmost
+static void DrawGraph(int left, bool gpu)
+{
+	glBegin(GL_QUADS);
+	for (unsigned i = 1; i < PROFILER_HISTORY; ++i) {
+		if (nFrames + i < PROFILER_HISTORY) {
+			continue;
+		}
+		const ProfileFrame *frame =
+			&history[(nFrames + i) % PROFILER_HISTORY];
+		if (gpu && !frame->hasGpu) {
+			continue;
+		}
+		const double *times = gpu ? frame->gpu : frame->cpu;
+		GLfloat x = left + GRAPH_FRAME_WIDTH*i,
+		        y = 0;
+		for (unsigned j = 0; j < BenchPhase_nPhases; ++j) {
+			GLfloat height = 1000*GRAPH_PIXELS_PER_MS*times[j];
+			glColor3fv(phaseColors[j]);
+			glVertex2f(x, y);
+			glVertex2f(x + GRAPH_FRAME_WIDTH, y);
+			glVertex2f(x + GRAPH_FRAME_WIDTH, y + height);
+			glVertex2f(x, y + height);
+			y += height;
+		}
+	}
+	glEnd();
+
+	// Mark time of a frame at 60 Hz
+	GLfloat frameHeight = 1000./60*GRAPH_PIXELS_PER_MS;
+	glColor3f(1, 1, 1);
+	glBegin(GL_LINES);
+	glVertex2f(left, frameHeight);
+	glVertex2f(left + GRAPH_FRAME_WIDTH*PROFILER_HISTORY, frameHeight);
+	glEnd();
+}
+
+void Profiler_DrawOverlay(int width, int height)
+{
+	if (!overlay) {
+		return;
+	}
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_CULL_FACE);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, width, 0, height, -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	// CPU on the left, GPU on the right
+	DrawGraph(0, false);
+	if (timerQueries) {
+		DrawGraph(GRAPH_FRAME_WIDTH*PROFILER_HISTORY + GRAPH_GAP, true);
+	}
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopAttrib();
+}
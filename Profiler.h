@@ -0,0 +1,53 @@
+#ifndef PROFILER_H_INCLUDED
+#define PROFILER_H_INCLUDED
+
+// Timing of each frame's phases, as marked by Bench_BeginPhase(), on the CPU
+// and, with timer queries, on the GPU. GPU results are read a few frames
+// late, so waiting on them never stalls drawing. Recent frames are kept for an
+// on-screen graph, a summary printed periodically to stderr while it is shown,
+// and a CSV file. Compiled out, to calls of nothing, with NDEBUG.
+
+#include <stdio.h>
+#include "Bench.h"
+
+// Frames of history graphed and summarized
+#define PROFILER_HISTORY 240
+
+// Frames drawn before a frame's GPU times are read
+#define PROFILER_LATENCY 3
+
+#ifdef NDEBUG
+
+#define Profiler_Init(csvPath)           ((void)0)
+#define Profiler_Free()                  ((void)0)
+#define Profiler_BeginPhase(phase, now)  ((void)0)
+#define Profiler_EndFrame()              ((void)0)
+#define Profiler_ToggleOverlay()         ((void)0)
+#define Profiler_DrawOverlay(w, h)       ((void)0)
+
+#else
+
+// Starts profiling the current GL context, with a row per frame written to
+// the CSV file at csvPath, or none if null
+void Profiler_Init(const char *csvPath);
+
+// Writes out frames still being timed, and frees queries
+void Profiler_Free(void);
+
+// Ends timing of current phase, if any, at given seconds, and starts timing
+// phase, or none if BenchPhase_nPhases. Called by Bench_BeginPhase().
+void Profiler_BeginPhase(BenchPhase phase, double now);
+
+// Ends frame, after any phase is ended
+void Profiler_EndFrame(void);
+
+// Shows or hides graph of recent frame times
+void Profiler_ToggleOverlay(void);
+
+// Draws graph of recent frame times over the bottom of a window of given
+// size, if shown
+void Profiler_DrawOverlay(int width, int height);
+
+#endif // NDEBUG
+
+#endif // PROFILER_H_INCLUDED
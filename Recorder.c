@@ -0,0 +1,294 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "Clock.h"
+#include "GlExt.h"
+
+#include "Recorder.h"
+
+// Gets bytes in a frame as read back
+static size_t GetFrameSize(const Recorder *recorder)
+{
+	return 3 * (size_t)recorder->width * recorder->height;
+}
+
+static uint8_t ClampByte(int value)
+{
+	return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+// Converts bottom-up RGB rows to planar YUV 4:2:0, from the top, averaging
+// chroma over each 2x2 block
+static void ConvertToYuv(
+	uint8_t       *yuv,
+	const uint8_t *rgb,
+	int           width,
+	int           height)
+{
+	uint8_t *yPlane = yuv,
+	        *uPlane = yPlane + width*height,
+	        *vPlane = uPlane + width/2*(height/2);
+	for (int y = 0; y < height; ++y) {
+		const uint8_t *row = &rgb[3*(size_t)width*(height - 1 - y)];
+		for (int x = 0; x < width; ++x) {
+			const uint8_t *p = &row[3*x];
+			yPlane[width*y + x] = ClampByte(
+				((66*p[0] + 129*p[1] + 25*p[2] + 128) >> 8) + 16
+			);
+		}
+	}
+	for (int y = 0; y < height; y += 2) {
+		const uint8_t *rows[2] = {
+			&rgb[3*(size_t)width*(height - 1 - y)],
+			&rgb[3*(size_t)width*(height - 2 - y)]
+		};
+		for (int x = 0; x < width; x += 2) {
+			int r = 0, g = 0, b = 0;
+			for (int i = 0; i < 4; ++i) {
+				const uint8_t *p = &rows[i/2][3*(x + i%2)];
+				r += p[0];
+				g += p[1];
+				b += p[2];
+			}
+			r /= 4;
+			g /= 4;
+			b /= 4;
+			int i = width/2*(y/2) + x/2;
+			uPlane[i] = ClampByte(((-38*r - 74*g + 112*b + 128) >> 8) + 128);
+			vPlane[i] = ClampByte(((112*r - 94*g - 18*b + 128) >> 8) + 128);
+		}
+	}
+}
+
+// Writes frame of bottom-up RGB rows in recorder's format
+static bool WriteFrame(Recorder *recorder, const uint8_t *pixels)
+{
+	int  width  = recorder->width,
+	     height = recorder->height;
+	FILE *file  = recorder->file;
+	switch (recorder->format) {
+	case RecordFormat_ppm:
+		fprintf(file, "P6\n%d %d\n255\n", width, height);
+		for (int y = height - 1; y >= 0; --y) {
+			fwrite(&pixels[3*(size_t)width*y], 3*(size_t)width, 1, file);
+		}
+		break;
+	case RecordFormat_yuv:
+		ConvertToYuv(recorder->converted, pixels, width, height);
+		fwrite(recorder->converted, (size_t)width*height*3/2, 1, file);
+		break;
+	default:
+		abort();
+	}
+	return !ferror(file);
+}
+
+static void *RunWriter(void *arg)
+{
+	Recorder *recorder = arg;
+	pthread_mutex_lock(&recorder->mutex);
+	for (;;) {
+		while (!recorder->nQueued && !recorder->quit) {
+			pthread_cond_wait(&recorder->queued, &recorder->mutex);
+		}
+		if (!recorder->nQueued) {
+			break;
+		}
+
+		// Frame stays queued while written, so its slot is not reused
+		const uint8_t *pixels = recorder->queue[recorder->queueStart];
+		pthread_mutex_unlock(&recorder->mutex);
+		bool ok = !recorder->failed && WriteFrame(recorder, pixels);
+		pthread_mutex_lock(&recorder->mutex);
+
+		recorder->queueStart = (recorder->queueStart + 1) % RECORDER_QUEUE_SIZE;
+		--recorder->nQueued;
+		recorder->nWritten += ok;
+		recorder->failed |= !ok;
+	}
+	pthread_mutex_unlock(&recorder->mutex);
+	return NULL;
+}
+
+// Copies frame read at readTime into the queue, or drops it if full
+static void Enqueue(Recorder *recorder, const uint8_t *pixels, double readTime)
+{
+	pthread_mutex_lock(&recorder->mutex);
+	bool full = recorder->nQueued == RECORDER_QUEUE_SIZE;
+	unsigned slot = (recorder->queueStart + recorder->nQueued)
+	              % RECORDER_QUEUE_SIZE;
+	pthread_mutex_unlock(&recorder->mutex);
+	if (full) {
+		++recorder->nDropped;
+		return;
+	}
+
+	// Only this thread fills slots past the queued ones
+	memcpy(recorder->queue[slot], pixels, GetFrameSize(recorder));
+	double latency = Clock_GetSeconds() - readTime;
+	++recorder->nCopied;
+	recorder->totalLatency += latency;
+	if (latency > recorder->maxLatency) {
+		recorder->maxLatency = latency;
+	}
+
+	pthread_mutex_lock(&recorder->mutex);
+	++recorder->nQueued;
+	pthread_cond_signal(&recorder->queued);
+	pthread_mutex_unlock(&recorder->mutex);
+}
+
+// Maps the pixel buffer read longest ago, and queues its frame
+static void MapOldest(Recorder *recorder)
+{
+	unsigned slot = recorder->nMapped++ % RECORDER_BUFFERS;
+	double start = Clock_GetSeconds();
+	g_gl.BindBuffer(GL_PIXEL_PACK_BUFFER, recorder->buffers[slot]);
+	const uint8_t *pixels = g_gl.MapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+	double stall = Clock_GetSeconds() - start;
+	recorder->totalStall += stall;
+	if (stall > recorder->maxStall) {
+		recorder->maxStall = stall;
+	}
+	if (pixels) {
+		Enqueue(recorder, pixels, recorder->readTimes[slot]);
+		g_gl.UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	} else {
+		++recorder->nDropped;
+	}
+	g_gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+bool Recorder_Start(
+	Recorder   *recorder,
+	const char *path,
+	int        width,
+	int        height)
+{
+	size_t length = strlen(path);
+	bool yuv = length >= 4 && !strcmp(path + length - 4, ".yuv");
+	*recorder = (Recorder){
+		.path   = path,
+		.format = yuv ? RecordFormat_yuv : RecordFormat_ppm,
+		.width  = yuv ? width & ~1 : width,
+		.height = yuv ? height & ~1 : height
+	};
+	if (!(recorder->file = fopen(path, "wb"))) {
+		perror(path);
+		return false;
+	}
+
+	size_t size = GetFrameSize(recorder);
+	for (unsigned i = 0; i < RECORDER_QUEUE_SIZE; ++i) {
+		recorder->queue[i] = malloc(size);
+		assert(recorder->queue[i]);
+	}
+	if (yuv) {
+		recorder->converted = malloc(size/2);
+		assert(recorder->converted);
+	}
+	if (GlExt_HasPixelBuffers()) {
+		g_gl.GenBuffers(RECORDER_BUFFERS, recorder->buffers);
+		for (unsigned i = 0; i < RECORDER_BUFFERS; ++i) {
+			g_gl.BindBuffer(GL_PIXEL_PACK_BUFFER, recorder->buffers[i]);
+			g_gl.BufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+		}
+		g_gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	} else {
+		fprintf(
+			stderr,
+			"Pixel buffer objects unavailable, recording will read back "
+			"synchronously\n"
+		);
+		recorder->readPixels = malloc(size);
+		assert(recorder->readPixels);
+	}
+
+	pthread_mutex_init(&recorder->mutex, NULL);
+	pthread_cond_init(&recorder->queued, NULL);
+	int error = pthread_create(&recorder->writer, NULL, RunWriter, recorder);
+	assert(!error);
+	(void)error;
+	return true;
+}
+
+void Recorder_Capture(Recorder *recorder)
+{
+	double now = Clock_GetSeconds();
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	if (!recorder->buffers[0]) {
+		glReadPixels(
+			0, 0, recorder->width, recorder->height,
+			GL_RGB, GL_UNSIGNED_BYTE,
+			recorder->readPixels
+		);
+		Enqueue(recorder, recorder->readPixels, now);
+		return;
+	}
+
+	// Start copy into a free buffer, returning without waiting for it
+	unsigned slot = recorder->nRead++ % RECORDER_BUFFERS;
+	recorder->readTimes[slot] = now;
+	g_gl.BindBuffer(GL_PIXEL_PACK_BUFFER, recorder->buffers[slot]);
+	glReadPixels(
+		0, 0, recorder->width, recorder->height,
+		GL_RGB, GL_UNSIGNED_BYTE,
+		NULL
+	);
+	g_gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// Free the next buffer, read longest ago, so most likely done
+	if (recorder->nRead - recorder->nMapped == RECORDER_BUFFERS) {
+		MapOldest(recorder);
+	}
+}
+
+void Recorder_Stop(Recorder *recorder)
+{
+	if (!recorder->file) {
+		return;
+	}
+	while (recorder->nMapped < recorder->nRead) {
+		MapOldest(recorder);
+	}
+	pthread_mutex_lock(&recorder->mutex);
+	recorder->quit = true;
+	pthread_cond_signal(&recorder->queued);
+	pthread_mutex_unlock(&recorder->mutex);
+	pthread_join(recorder->writer, NULL);
+	pthread_mutex_destroy(&recorder->mutex);
+	pthread_cond_destroy(&recorder->queued);
+
+	// errno from a failed write is lost by now, so give no reason
+	if (fclose(recorder->file) || recorder->failed) {
+		fprintf(stderr, "%s: Cannot write all frames\n", recorder->path);
+	}
+	unsigned long nCopied = recorder->nCopied ? recorder->nCopied : 1,
+	              nMapped = recorder->nMapped ? recorder->nMapped : 1;
+	fprintf(
+		stderr,
+		"Recorded %lu frames of %dx%d %s to %s, %lu dropped. Readback "
+		"latency %.2f ms mean, %.2f ms max, waiting %.2f ms mean, "
+		"%.2f ms max.\n",
+		recorder->nWritten,
+		recorder->width,
+		recorder->height,
+		recorder->format == RecordFormat_yuv ? "I420" : "PPM",
+		recorder->path,
+		recorder->nDropped,
+		1000*recorder->totalLatency/nCopied,
+		1000*recorder->maxLatency,
+		1000*recorder->totalStall/nMapped,
+		1000*recorder->maxStall
+	);
+
+	if (recorder->buffers[0]) {
+		g_gl.DeleteBuffers(RECORDER_BUFFERS, recorder->buffers);
+	}
+	for (unsigned i = 0; i < RECORDER_QUEUE_SIZE; ++i) {
+		free(recorder->queue[i]);
+	}
+	free(recorder->readPixels);
+	free(recorder->converted);
+	*recorder = (Recorder){0};
+}
@@ -0,0 +1,81 @@
+#ifndef RECORDER_H_INCLUDED
+#define RECORDER_H_INCLUDED
+
+// Recording of drawn frames to a raw video file. Each finished frame is read
+// into a ring of pixel buffer objects, and only mapped a few frames later,
+// when the copy has finished, so drawing rarely waits on readback. A writer
+// thread converts and writes frames from a queue. When it falls behind,
+// frames are dropped rather than holding up drawing.
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <GL/gl.h>
+
+// Pixel buffers being read into, so frames mapped are this many less one
+// behind the frame drawn
+#define RECORDER_BUFFERS 3
+
+// Frames waiting for the writer thread, at most
+#define RECORDER_QUEUE_SIZE 8
+
+typedef enum {
+	RecordFormat_ppm, // Stream of binary PPM images
+	RecordFormat_yuv  // Raw planar YUV 4:2:0 (I420), BT.601 limited range
+} RecordFormat;
+
+typedef struct {
+	FILE            *file;
+	const char      *path;
+	RecordFormat    format;
+	int             width,
+	                height;
+
+	// Readback, on the drawing thread
+	GLuint          buffers[RECORDER_BUFFERS]; // 0 if reading synchronously
+	double          readTimes[RECORDER_BUFFERS];
+	uint8_t         *readPixels;               // Without pixel buffers
+	unsigned long   nRead,
+	                nMapped;
+
+	// Frames read back and waiting to be written, as bottom-up RGB rows
+	uint8_t         *queue[RECORDER_QUEUE_SIZE];
+	unsigned        queueStart,
+	                nQueued;
+	pthread_t       writer;
+	pthread_mutex_t mutex;
+	pthread_cond_t  queued;
+	bool            quit,
+	                failed;     // Writing failed
+	uint8_t         *converted; // Frame in file format, for writer
+
+	// Statistics
+	unsigned long   nCopied,      // Into queue
+	                nWritten,
+	                nDropped;
+	double          totalLatency, // Seconds from reading frame to having it
+	                maxLatency,
+	                totalStall,   // Seconds waiting for mapping
+	                maxStall;
+} Recorder;
+
+// Starts recording frames of given size to path, as YUV if it ends in .yuv,
+// otherwise PPM. YUV frames are cropped to even sizes. Returns whether the
+// file could be created, otherwise prints an error to stderr.
+bool Recorder_Start(
+	Recorder   *recorder,
+	const char *path,
+	int        width,
+	int        height
+);
+
+// Reads back finished frame from the back buffer, before it is swapped, and
+// queues frames read before it whose copies are done
+void Recorder_Capture(Recorder *recorder);
+
+// Queues frames still being read, waits for all to be written, closes the
+// file, and prints statistics to stderr
+void Recorder_Stop(Recorder *recorder);
+
+#endif // RECORDER_H_INCLUDED
@@ -0,0 +1,244 @@
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+#include "RouteTable.h"
+
+// Link into a node, from a node leaving its piece with a switch state
+typedef struct {
+	unsigned from;
+	uint8_t  state;
+} RouteEdge;
+
+// Node waiting to be settled, at its distance when queued
+typedef struct {
+	float    distance;
+	unsigned node;
+} RouteHeapEntry;
+
+static bool IsInTable(const RouteTable *table, const TrackShared *track)
+{
+	const NetworkIndex *index = table->index;
+	return    track->index < index->nPieces + index->nBranchPieces
+	       && index->pieces[track->index] == track;
+}
+
+static void Push(RouteHeapEntry *heap, unsigned *n, RouteHeapEntry entry)
+{
+	unsigned i = (*n)++;
+	while (i > 0 && heap[(i - 1)/2].distance > entry.distance) {
+		heap[i] = heap[(i - 1)/2];
+		i = (i - 1)/2;
+	}
+	heap[i] = entry;
+}
+
+static RouteHeapEntry Pop(RouteHeapEntry *heap, unsigned *n)
+{
+	RouteHeapEntry top  = heap[0],
+	               last = heap[--*n];
+	unsigned i = 0,
+	         child;
+	while ((child = 2*i + 1) < *n) {
+		if (child + 1 < *n && heap[child + 1].distance < heap[child].distance) {
+			++child;
+		}
+		if (heap[child].distance >= last.distance) {
+			break;
+		}
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = last;
+	return top;
+}
+
+void RouteTable_Build(
+	RouteTable          *table,
+	const NetworkIndex  *index,
+	const TrackLocation *locations,
+	unsigned            nLocations)
+{
+	unsigned nPieces = index->nPieces + index->nBranchPieces,
+	         nNodes  = 2*nPieces;
+	*table = (RouteTable){
+		.index    = index,
+		.nNodes   = nNodes,
+		.nTargets = nLocations
+	};
+	table->targets = malloc(nLocations * sizeof *table->targets);
+	table->distances = malloc(
+		(size_t)nLocations * nNodes * sizeof *table->distances
+	);
+	table->exits = malloc(
+		(size_t)nLocations * nNodes * sizeof *table->exits
+	);
+	assert(   (table->targets && table->distances && table->exits)
+	       || !nLocations);
+
+	// Links into each node, grouped by node. Leaving a piece by either its
+	// next or previous piece, or its branch, enters the new piece travelling
+	// the same way.
+	unsigned  *firstEdges = calloc(nNodes + 1, sizeof *firstEdges);
+	RouteEdge *edges      = malloc(2*nNodes * sizeof *edges);
+	float     *lengths    = malloc(nPieces * sizeof *lengths);
+	assert(firstEdges && edges && lengths);
+	for (int pass = 0; pass < 2; ++pass) {
+		for (unsigned node = 0; node < nNodes; ++node) {
+			TrackShared *track = index->pieces[node/2];
+			TrackEnd    end    = node % 2;
+			TrackShared *tos[2] = {
+				end == TrackEnd_end ? Track_GetNext(track)
+				                    : Track_GetPrevious(track),
+				Track_GetBranch(track, end)
+			};
+			for (SwitchState state = 0; state < 2; ++state) {
+				TrackShared *to = tos[state];
+				if (!to) {
+					continue;
+				}
+				unsigned toNode = 2*to->index + end;
+				if (pass == 0) {
+					++firstEdges[toNode + 1];
+				} else {
+					edges[firstEdges[toNode]++] = (RouteEdge){node, state};
+				}
+			}
+		}
+		if (pass == 0) {
+			for (unsigned node = 0; node < nNodes; ++node) {
+				firstEdges[node + 1] += firstEdges[node];
+			}
+		} else {
+			// Filling moved each start to the next node's, so shift back
+			for (unsigned node = nNodes; node > 0; --node) {
+				firstEdges[node] = firstEdges[node - 1];
+			}
+			firstEdges[0] = 0;
+		}
+	}
+	for (unsigned i = 0; i < nPieces; ++i) {
+		lengths[i] = Track_GetLength(index->pieces[i]);
+	}
+
+	// Search back from each location, settling nodes nearest it first
+	unsigned nEdges = firstEdges[nNodes];
+	RouteHeapEntry *heap = malloc((nEdges + 2) * sizeof *heap);
+	assert(heap);
+	for (unsigned t = 0; t < nLocations; ++t) {
+		float   *distances = &table->distances[(size_t)t*nNodes];
+		uint8_t *exits     = &table->exits[(size_t)t*nNodes];
+		TrackShared *target = locations[t].track;
+		table->targets[t] = target;
+		for (unsigned node = 0; node < nNodes; ++node) {
+			distances[node] = INFINITY;
+			exits[node] = Switch_normal;
+		}
+		if (!IsInTable(table, target)) {
+			continue;
+		}
+
+		unsigned nHeap = 0;
+		for (TrackEnd end = TrackEnd_start; end <= TrackEnd_end; ++end) {
+			unsigned node = 2*target->index + end;
+			distances[node] = 0;
+			Push(heap, &nHeap, (RouteHeapEntry){0, node});
+		}
+		while (nHeap) {
+			RouteHeapEntry entry = Pop(heap, &nHeap);
+			if (entry.distance > distances[entry.node]) {
+				continue;
+			}
+			for (unsigned e = firstEdges[entry.node];
+			     e < firstEdges[entry.node + 1];
+			     ++e)
+			{
+				unsigned from = edges[e].from;
+				float distance = entry.distance + lengths[from/2];
+				if (distance < distances[from]) {
+					distances[from] = distance;
+					exits[from] = edges[e].state;
+					Push(heap, &nHeap, (RouteHeapEntry){distance, from});
+				}
+			}
+		}
+	}
+	free(heap);
+	free(firstEdges);
+	free(edges);
+	free(lengths);
+}
+
+void RouteTable_Free(RouteTable *table)
+{
+	free(table->targets);
+	free(table->distances);
+	free(table->exits);
+	*table = (RouteTable){0};
+}
+
+Scalar RouteTable_GetDistance(
+	const RouteTable *table,
+	const NetworkPos *np,
+	bool             forwards,
+	unsigned         target)
+{
+	if (np->track == table->targets[target]) {
+		return 0;
+	}
+	if (!IsInTable(table, np->track)) {
+		return INFINITY;
+	}
+	size_t      first      = (size_t)target*table->nNodes;
+	const float *distances = &table->distances[first];
+	unsigned    node       = 2*np->track->index;
+	return forwards
+		? distances[node + TrackEnd_end] - np->pos
+		: distances[node + TrackEnd_start]
+		  - Track_GetLength(np->track) + np->pos;
+}
+
+void RouteTable_SetSwitches(
+	const RouteTable *table,
+	const NetworkPos *np,
+	bool             forwards,
+	unsigned         target,
+	Scalar           distance)
+{
+	size_t        first      = (size_t)target*table->nNodes;
+	const float   *distances = &table->distances[first];
+	const uint8_t *exits     = &table->exits[first];
+	TrackEnd    end   = forwards ? TrackEnd_end : TrackEnd_start;
+	TrackShared *goal = table->targets[target],
+	            *track = np->track;
+	Scalar ahead = forwards ? Track_GetLength(track) - np->pos : np->pos;
+	while (ahead < distance && track != goal && IsInTable(table, track)) {
+		unsigned node = 2*track->index + end;
+		if (isinf(distances[node])) {
+			break;
+		}
+
+		// Facing switch at end being left
+		if (Track_GetBranch(track, end)) {
+			Track_SetSwitch(track, end, exits[node]);
+		}
+		TrackShared *next = Track_Follow(track, end);
+		if (!next) {
+			break;
+		}
+
+		// Trailing switch at end of next piece being entered
+		TrackEnd    entry  = end == TrackEnd_end ? TrackEnd_start
+		                                         : TrackEnd_end;
+		TrackShared *merge = Track_GetBranch(next, entry);
+		if (merge) {
+			Track_SetSwitch(
+				next,
+				entry,
+				merge == track ? Switch_reverse : Switch_normal
+			);
+		}
+		track = next;
+		ahead += Track_GetLength(track);
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef ROUTE_TABLE_H_INCLUDED
+#define ROUTE_TABLE_H_INCLUDED
+
+// Shortest routes from everywhere in a track network to each of its named
+// locations, found once per network, for trains to set switches ahead by
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "Scalar.h"
+#include "Track.h"
+#include "TrackLayout.h"
+
+// Routes over pieces of an index. Each piece has a node per direction of
+// travel, numbered 2*piece index + end it is left by. Trains never turn
+// round, so routes keep their direction.
+typedef struct {
+	const NetworkIndex *index;
+	TrackShared        **targets;   // Piece of each location
+	float              *distances;  // Per target then node: from the end the
+	                                // node's piece is entered by, to the
+	                                // target, INFINITY if unreachable
+	uint8_t            *exits;      // Per target then node: SwitchState to
+	                                // leave by
+	unsigned           nNodes,
+	                   nTargets;
+} RouteTable;
+
+// Finds routes to each location through the pieces of index, which must stay
+// built as long as the table is used
+void RouteTable_Build(
+	RouteTable          *table,
+	const NetworkIndex  *index,
+	const TrackLocation *locations,
+	unsigned            nLocations
+);
+
+void RouteTable_Free(RouteTable *table);
+
+// Gets distance along shortest route from position to location, travelling
+// forwards or backwards, INFINITY if unreachable, 0 if there
+Scalar RouteTable_GetDistance(
+	const RouteTable *table,
+	const NetworkPos *np,
+	bool             forwards,
+	unsigned         target
+);
+
+// Sets switches along route from position to location, up to given distance
+// ahead: facing ones to take the route, and trailing ones to lead back along
+// it, so vehicles behind follow. Switches must not change while other threads
+// move positions.
+void RouteTable_SetSwitches(
+	const RouteTable *table,
+	const NetworkPos *np,
+	bool             forwards,
+	unsigned         target,
+	Scalar           distance
+);
+
+#endif // ROUTE_TABLE_H_INCLUDED
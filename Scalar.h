@@ -0,0 +1,8 @@
+#ifndef SCALAR_H_INCLUDED
+#define SCALAR_H_INCLUDED
+
+// Real number type of the simulation, kept free of OpenGL types.
+// Same as GLfloat, so results can be passed to OpenGL directly.
+typedef float Scalar;
+
+#endif // SCALAR_H_INCLUDED
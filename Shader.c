@@ -0,0 +1,63 @@
+#include <stdio.h>
+
+#include "GlExt.h"
+
+#include "Shader.h"
+
+// Compiles shader of given type, returns 0 on failure
+static GLuint Compile(GLenum type, const char *source)
+{
+	GLuint shader = g_gl.CreateShader(type);
+	g_gl.ShaderSource(shader, 1, &source, NULL);
+	g_gl.CompileShader(shader);
+
+	GLint compiled;
+	g_gl.GetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+	if (!compiled) {
+		char log[1024];
+		g_gl.GetShaderInfoLog(shader, sizeof log, NULL, log);
+		fprintf(stderr, "Shader compile error:\n%s\n", log);
+		g_gl.DeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+GLuint Shader_BuildProgram(
+	const char *vertexSource,
+	const char *fragmentSource)
+{
+	if (!GlExt_HasShaders()) {
+		return 0;
+	}
+	GLuint vertex   = Compile(GL_VERTEX_SHADER, vertexSource),
+	       fragment = Compile(GL_FRAGMENT_SHADER, fragmentSource);
+	if (!vertex || !fragment) {
+		if (vertex) {
+			g_gl.DeleteShader(vertex);
+		}
+		if (fragment) {
+			g_gl.DeleteShader(fragment);
+		}
+		return 0;
+	}
+
+	GLuint program = g_gl.CreateProgram();
+	g_gl.AttachShader(program, vertex);
+	g_gl.AttachShader(program, fragment);
+	g_gl.LinkProgram(program);
+	// Shaders are freed with the program
+	g_gl.DeleteShader(vertex);
+	g_gl.DeleteShader(fragment);
+
+	GLint linked;
+	g_gl.GetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		char log[1024];
+		g_gl.GetProgramInfoLog(program, sizeof log, NULL, log);
+		fprintf(stderr, "Shader link error:\n%s\n", log);
+		g_gl.DeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
@@ -0,0 +1,13 @@
+#ifndef SHADER_H_INCLUDED
+#define SHADER_H_INCLUDED
+
+#include <GL/gl.h>
+
+// Compiles and links GLSL program from sources, logging errors to stderr.
+// Returns 0 on failure.
+GLuint Shader_BuildProgram(
+	const char *vertexSource,
+	const char *fragmentSource
+);
+
+#endif // SHADER_H_INCLUDED
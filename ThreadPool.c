@@ -0,0 +1,125 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "ThreadPool.h"
+
+static void *RunWorker(void *arg)
+{
+	ThreadPoolWorker *worker = arg;
+	ThreadPool *pool = worker->pool;
+	unsigned seen = 0;
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		while (pool->generation == seen && !pool->quit) {
+			pthread_cond_wait(&pool->wake, &pool->mutex);
+		}
+		if (pool->quit) {
+			break;
+		}
+		seen = pool->generation;
+
+		// Take this worker's share of the items
+		ThreadPoolJob *job = pool->job;
+		void *context = pool->context;
+		unsigned long nItems = pool->nItems,
+		              n      = pool->nWorkers;
+		unsigned begin = nItems * worker->index / n,
+		         end   = nItems * (worker->index + 1) / n;
+		pthread_mutex_unlock(&pool->mutex);
+
+		if (begin < end) {
+			job(context, begin, end);
+		}
+
+		pthread_mutex_lock(&pool->mutex);
+		if (!--pool->nRunning) {
+			pthread_cond_signal(&pool->finished);
+		}
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+unsigned ThreadPool_GetCpuCount(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 1 ? n : 1;
+}
+
+void ThreadPool_Init(ThreadPool *pool, unsigned nWorkers)
+{
+	*pool = (ThreadPool){.nWorkers = nWorkers};
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->finished, NULL);
+	if (!nWorkers) {
+		return;
+	}
+
+	pool->workers = malloc(nWorkers * sizeof *pool->workers);
+	assert(pool->workers);
+	for (unsigned i = 0; i < nWorkers; ++i) {
+		pool->workers[i] = (ThreadPoolWorker){.pool = pool, .index = i};
+		int error = pthread_create(
+			&pool->workers[i].thread,
+			NULL,
+			RunWorker,
+			&pool->workers[i]
+		);
+		assert(!error);
+		(void)error;
+	}
+}
+
+void ThreadPool_Start(
+	ThreadPool    *pool,
+	ThreadPoolJob *job,
+	void          *context,
+	unsigned      nItems)
+{
+	if (!pool->nWorkers) {
+		if (nItems) {
+			job(context, 0, nItems);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	assert(!pool->nRunning);
+	pool->job = job;
+	pool->context = context;
+	pool->nItems = nItems;
+	pool->nRunning = pool->nWorkers;
+	++pool->generation;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void ThreadPool_Wait(ThreadPool *pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->nRunning) {
+		pthread_cond_wait(&pool->finished, &pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void ThreadPool_Free(ThreadPool *pool)
+{
+	ThreadPool_Wait(pool);
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->mutex);
+	for (unsigned i = 0; i < pool->nWorkers; ++i) {
+		pthread_join(pool->workers[i].thread, NULL);
+	}
+	free(pool->workers);
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_cond_destroy(&pool->wake);
+	pthread_cond_destroy(&pool->finished);
+	*pool = (ThreadPool){0};
+}
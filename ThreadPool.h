@@ -0,0 +1,55 @@
+#ifndef THREAD_POOL_H_INCLUDED
+#define THREAD_POOL_H_INCLUDED
+
+// Fixed set of worker threads that split each job's items between them
+
+#include <stdbool.h>
+#include <pthread.h>
+
+// Processes items begin to end - 1 of a job
+typedef void ThreadPoolJob(void *context, unsigned begin, unsigned end);
+
+typedef struct ThreadPool ThreadPool;
+
+typedef struct {
+	ThreadPool *pool;
+	unsigned   index;
+	pthread_t  thread;
+} ThreadPoolWorker;
+
+struct ThreadPool {
+	ThreadPoolWorker *workers;
+	unsigned         nWorkers;
+	pthread_mutex_t  mutex;
+	pthread_cond_t   wake,       // Signalled when a job starts, or on close
+	                 finished;   // Signalled when the last worker finishes
+	ThreadPoolJob    *job;
+	void             *context;
+	unsigned         nItems,
+	                 generation, // Incremented for each job started
+	                 nRunning;   // Workers yet to finish current job
+	bool             quit;
+};
+
+// Gets number of processors online, at least 1
+unsigned ThreadPool_GetCpuCount(void);
+
+// Starts nWorkers threads. With 0, jobs run on the calling thread.
+void ThreadPool_Init(ThreadPool *pool, unsigned nWorkers);
+
+// Starts job over nItems items, split into one contiguous range per worker,
+// and returns without waiting. Previous job must have been waited for.
+void ThreadPool_Start(
+	ThreadPool    *pool,
+	ThreadPoolJob *job,
+	void          *context,
+	unsigned      nItems
+);
+
+// Waits for current job, if any, to finish
+void ThreadPool_Wait(ThreadPool *pool);
+
+// Waits for current job, then stops and joins workers
+void ThreadPool_Free(ThreadPool *pool);
+
+#endif // THREAD_POOL_H_INCLUDED
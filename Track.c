@@ -1,89 +1,419 @@
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
-#include "DrawUtil.h"
 #include "Algebra.h"
 
 #include "Track.h"
 
 #define PI 3.14159265358979323846264338327950288
 
-enum {
-	Type_straight,
-	Type_curved
-};
-
-static const GLfloat iUnit[3] = {1, 0, 0};
+static const Scalar iUnit[3] = {1, 0, 0};
 
 StraightTrack g_initialTrackPiece = {
 	.shared = {.type = Type_straight},
 	.start  = {-3, 0},
-	.end    = {3, 0},
-	.next   = NULL,
-	.prev   = NULL
+	.end    = {3, 0}
 };
 
-NetworkPos *NetworkPos_Move(NetworkPos *np, GLfloat vector)
+NetworkIndex g_networkIndex = {0};
+
+// Gets whether track is among the first n pieces of index
+static bool IsInIndex(
+	const NetworkIndex *index,
+	const TrackShared  *track,
+	unsigned           n)
+{
+	return track->index < n && index->pieces[track->index] == track;
+}
+
+// Adds pieces reached from those already in index through branches, and
+// through links of pieces off the ring, breadth first
+static void IndexBranchPieces(NetworkIndex *index)
+{
+	unsigned n        = index->nPieces,
+	         capacity = n;
+	for (unsigned i = 0; i < n; ++i) {
+		TrackShared *track = index->pieces[i],
+		            *links[4] = {
+			Track_GetBranch(track, TrackEnd_start),
+			Track_GetBranch(track, TrackEnd_end),
+			i < index->nPieces ? NULL : Track_GetNext(track),
+			i < index->nPieces ? NULL : Track_GetPrevious(track)
+		};
+		for (unsigned j = 0; j < 4; ++j) {
+			if (!links[j] || IsInIndex(index, links[j], n)) {
+				continue;
+			}
+			if (n == capacity) {
+				capacity *= 2;
+				index->pieces = realloc(
+					index->pieces,
+					capacity * sizeof *index->pieces
+				);
+				assert(index->pieces);
+			}
+			if (links[j]->index != n) {
+				links[j]->index = n;
+			}
+			index->pieces[n++] = links[j];
+		}
+	}
+	index->nBranchPieces = n - index->nPieces;
+}
+
+// Finds how far positions on each ring piece can be moved by seeking, before
+// passing a piece end with a branch, where the route depends on its switch
+static void FindClearRanges(NetworkIndex *index)
+{
+	unsigned n = index->nPieces;
+	const double *offsets = index->offsets;
+	double length = offsets[n],
+	       ahead  = INFINITY,
+	       behind = -INFINITY;
+
+	// Go twice round the ring, so junctions past its start are seen
+	for (unsigned k = 2*n; k-- > 0;) {
+		unsigned i = k % n;
+		if (Track_GetBranch(index->pieces[i], TrackEnd_end)) {
+			ahead = offsets[i + 1] + (k < n ? 0 : length);
+		}
+		if (k < n) {
+			index->clearAhead[i] = ahead;
+		}
+	}
+	for (unsigned k = 0; k < 2*n; ++k) {
+		unsigned i = k % n;
+		if (Track_GetBranch(index->pieces[i], TrackEnd_start)) {
+			behind = offsets[i] - (k < n ? length : 0);
+		}
+		if (k >= n) {
+			index->clearBehind[i] = behind;
+		}
+	}
+}
+
+void NetworkIndex_Build(NetworkIndex *index, TrackShared *head)
+{
+	unsigned nPieces = 1;
+	for (TrackShared *track = Track_GetNext(head);
+	     track != head;
+	     track = Track_GetNext(track))
+	{
+		++nPieces;
+	}
+
+	index->pieces = realloc(index->pieces, nPieces * sizeof *index->pieces);
+	index->offsets = realloc(
+		index->offsets,
+		(nPieces + 1) * sizeof *index->offsets
+	);
+	index->clearAhead = realloc(
+		index->clearAhead,
+		nPieces * sizeof *index->clearAhead
+	);
+	index->clearBehind = realloc(
+		index->clearBehind,
+		nPieces * sizeof *index->clearBehind
+	);
+	assert(   index->pieces && index->offsets
+	       && index->clearAhead && index->clearBehind);
+	index->nPieces = nPieces;
+
+	double offset = 0;
+	TrackShared *track = head;
+	for (unsigned i = 0; i < nPieces; ++i) {
+		// Leave pages of mapped networks clean if already indexed
+		if (track->index != i) {
+			track->index = i;
+		}
+		index->pieces[i] = track;
+		index->offsets[i] = offset;
+		offset += Track_GetLength(track);
+		track = Track_GetNext(track);
+	}
+	index->offsets[nPieces] = offset;
+
+	IndexBranchPieces(index);
+	FindClearRanges(index);
+
+	static unsigned lastGeneration = 0;
+	index->generation = ++lastGeneration;
+}
+
+void NetworkIndex_Free(NetworkIndex *index)
+{
+	free(index->pieces);
+	free(index->offsets);
+	free(index->clearAhead);
+	free(index->clearBehind);
+	*index = (NetworkIndex){0};
+}
+
+bool NetworkIndex_Contains(const NetworkIndex *index, const TrackShared *track)
+{
+	return IsInIndex(index, track, index->nPieces + index->nBranchPieces);
+}
+
+Scalar NetworkIndex_GetLength(const NetworkIndex *index)
+{
+	return index->offsets[index->nPieces];
+}
+
+static bool IsIndexed(const TrackShared *track)
+{
+	return IsInIndex(&g_networkIndex, track, g_networkIndex.nPieces);
+}
+
+// Fallback for pieces not on indexed ring, and moves past junctions: walks
+// the network one piece at a time, following switches
+static NetworkPos *NetworkPos_Walk(NetworkPos *np, Scalar vector)
 {
 	vector += np->pos;
 	if (vector >= 0) {
-		GLfloat length;
+		Scalar length;
+		TrackShared *next;
 		while ((length = Track_GetLength(np->track)) < vector) {
-			np->track = Track_GetNext(np->track);
+			// Stop at end of dead end
+			if (!(next = Track_Follow(np->track, TrackEnd_end))) {
+				vector = length;
+				break;
+			}
+			np->track = next;
 			vector -= length;
 		}
 		np->pos = vector;
 	} else {
-		np->track = Track_GetPrevious(np->track);
 		vector *= -1;
-		GLfloat length;
-		while ((length = Track_GetLength(np->track)) < vector) {
-			np->track = Track_GetPrevious(np->track);
+		TrackShared *prev;
+		while ((prev = Track_Follow(np->track, TrackEnd_start))) {
+			np->track = prev;
+			Scalar length = Track_GetLength(prev);
+			if (length >= vector) {
+				np->pos = length - vector;
+				return np;
+			}
 			vector -= length;
 		}
-		np->pos = length - vector;
+		// Stop at start of dead end
+		np->pos = 0;
 	}
 	return np;
 }
 
+NetworkPos *NetworkPos_Move(NetworkPos *np, Scalar vector)
+{
+	if (!IsIndexed(np->track)) {
+		return NetworkPos_Walk(np, vector);
+	}
+
+	// Stay in current piece if possible, avoids losing precision
+	const NetworkIndex *index = &g_networkIndex;
+	const double *offsets = index->offsets;
+	unsigned i = np->track->index;
+	Scalar pos = np->pos + vector;
+	if (pos >= 0 && pos <= offsets[i+1] - offsets[i]) {
+		np->pos = pos;
+		return np;
+	}
+
+	// Seek unless passing a junction
+	double distance = offsets[i] + np->pos + vector;
+	if (distance >= index->clearAhead[i] || distance < index->clearBehind[i]) {
+		return NetworkPos_Walk(np, vector);
+	}
+	return NetworkPos_SetDistance(np, distance);
+}
+
+bool NetworkPos_IsOnRing(const NetworkPos *np)
+{
+	return IsIndexed(np->track);
+}
+
+double NetworkPos_GetDistance(const NetworkPos *np)
+{
+	assert(IsIndexed(np->track));
+	return g_networkIndex.offsets[np->track->index] + np->pos;
+}
+
+NetworkPos *NetworkPos_SetDistance(NetworkPos *np, double distance)
+{
+	const NetworkIndex *index = &g_networkIndex;
+	assert(index->nPieces);
+
+	// Wrap around ring
+	double length = index->offsets[index->nPieces];
+	if (distance < 0 || distance >= length) {
+		distance = fmod(distance, length);
+		if (distance < 0) {
+			distance += length;
+		}
+	}
+
+	// Binary search for last piece starting at or before distance
+	unsigned low = 0, high = index->nPieces;
+	while (high - low > 1) {
+		unsigned mid = low + (high - low)/2;
+		if (index->offsets[mid] <= distance) {
+			low = mid;
+		} else {
+			high = mid;
+		}
+	}
+	np->track = index->pieces[low];
+	np->pos = distance - index->offsets[low];
+	return np;
+}
+
+// Calculate dims of a straight section running along vector from start
+static void CalcSectionDims(
+	StraightDims *dims,
+	const Scalar start[3],
+	const Scalar vector[3])
+{
+	dims->length = Length3(vector);
+	Saxpy3(dims->position, start, 0.5, vector);
+	memcpy(dims->start, start, sizeof dims->start);
+	if (dims->length != 0) {
+		Scalar3(dims->forwards, 1/dims->length, (Scalar *)vector);
+	} else {
+		memcpy(dims->forwards, iUnit, sizeof dims->forwards);
+	}
+	dims->heading[0] = dims->forwards[0];
+	dims->heading[1] = -dims->forwards[2];
+}
+
 static void CalcStraightDims(StraightTrack *track, StraightDims *dims)
 {
-	// Calculate position, length and orientation
-	GLfloat start[3] = {track->start[0], 0, track->start[1]};
-	GLfloat end[3] = {track->end[0], 0, track->end[1]};
-	GLfloat sectionVector[3];
+	// Calculate position, length and heading
+	Scalar start[3] = {track->start[0], 0, track->start[1]};
+	Scalar end[3] = {track->end[0], 0, track->end[1]};
+	Scalar sectionVector[3];
 	Saxpy3(sectionVector, end, -1, start);
-	dims->length = Length3(sectionVector);
-	dims->orientation = Angle3(iUnit, sectionVector);
-	if (Cross3((GLfloat [3]){0}, iUnit, sectionVector)[1] < 0) {
-		dims->orientation *= -1;
+	CalcSectionDims(dims, start, sectionVector);
+}
+
+// Empties bounding box, ready to add points
+static void ClearBounds(Scalar bounds[2][3])
+{
+	for (unsigned i = 0; i < 3; ++i) {
+		bounds[0][i] = INFINITY;
+		bounds[1][i] = -INFINITY;
 	}
-	Saxpy3(dims->position, start, 0.5, sectionVector);
 }
 
-StraightTrack *AllocStraightTrack(
-	const GLfloat start[3],
-	const GLfloat end[3],
-	TrackShared   *next,
-	TrackShared   *prev)
+// Grows bounding box to hold track drawn around centre line point
+static void AddBoundsPoint(Scalar bounds[2][3], const Scalar point[3])
 {
-	StraightTrack *result = malloc(sizeof *result);
-	assert(result);
-	*result = (StraightTrack){
-		.shared = {.type = Type_straight},
-		.next   = next,
-		.prev   = prev
+	const Scalar margin[2][3] = {
+		{-TRACK_HALF_WIDTH, 0, -TRACK_HALF_WIDTH},
+		{TRACK_HALF_WIDTH, TRACK_HEIGHT, TRACK_HALF_WIDTH}
 	};
+	for (unsigned i = 0; i < 3; ++i) {
+		bounds[0][i] = fminf(bounds[0][i], point[i] + margin[0][i]);
+		bounds[1][i] = fmaxf(bounds[1][i], point[i] + margin[1][i]);
+	}
+}
+
+// Grows bounding box to hold straight section
+static void AddSectionBounds(Scalar bounds[2][3], const StraightDims *dims)
+{
+	Scalar end[3];
+	Saxpy3(end, dims->start, dims->length, dims->forwards);
+	AddBoundsPoint(bounds, dims->start);
+	AddBoundsPoint(bounds, end);
+}
+
+static void CalcStraightBounds(StraightTrack *track)
+{
+	ClearBounds(track->shared.bounds);
+	AddSectionBounds(track->shared.bounds, &track->dims);
+}
+
+// Bytes in each arena block, unless a bigger allocation needs more
+#define ARENA_BLOCK_SIZE 65536
+
+struct TrackArenaBlock {
+	TrackArenaBlock *next;
+	size_t          used,
+	                size;
+};
+
+TrackArena *g_trackArena = NULL;
+
+// Rounds size up to a multiple of TRACK_PIECE_ALIGN
+static size_t AlignPieceSize(size_t size)
+{
+	return   (size + TRACK_PIECE_ALIGN - 1)
+	       / TRACK_PIECE_ALIGN * TRACK_PIECE_ALIGN;
+}
+
+void *TrackArena_Alloc(TrackArena *arena, size_t size)
+{
+	size_t headerSize = AlignPieceSize(sizeof (TrackArenaBlock));
+	size = AlignPieceSize(size);
+	TrackArenaBlock *block = arena->blocks;
+	if (!block || block->size - block->used < size) {
+		size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+		block = malloc(headerSize + blockSize);
+		assert(block);
+		*block = (TrackArenaBlock){
+			.next = arena->blocks,
+			.size = blockSize
+		};
+		arena->blocks = block;
+	}
+	void *result = (char *)block + headerSize + block->used;
+	block->used += size;
+	return result;
+}
+
+void TrackArena_Free(TrackArena *arena)
+{
+	for (TrackArenaBlock *block = arena->blocks, *next; block; block = next) {
+		next = block->next;
+		free(block);
+	}
+	arena->blocks = NULL;
+}
+
+// Allocates memory for a piece, from g_trackArena if set
+static void *AllocPiece(size_t size)
+{
+	void *result = g_trackArena
+		? TrackArena_Alloc(g_trackArena, size)
+		: malloc(size);
+	assert(result);
+	return result;
+}
+
+StraightTrack *AllocStraightTrack(
+	const Scalar start[3],
+	const Scalar end[3],
+	TrackShared  *next,
+	TrackShared  *prev)
+{
+	StraightTrack *result = AllocPiece(sizeof *result);
+	*result = (StraightTrack){.shared = {.type = Type_straight}};
+	Track_SetNext((TrackShared *)result, next);
+	Track_SetPrevious((TrackShared *)result, prev);
 	memcpy(result->start, start, sizeof result->start);
 	memcpy(result->end, end, sizeof result->end);
 	CalcStraightDims(result, &result->dims);
+	CalcStraightBounds(result);
 	return result;
 }
 
-static GLfloat *Project3(GLfloat result[3], const GLfloat vec[2])
+void InitTrack(void)
+{
+	CalcStraightDims(&g_initialTrackPiece, &g_initialTrackPiece.dims);
+	CalcStraightBounds(&g_initialTrackPiece);
+}
+
+static Scalar *Project3(Scalar result[3], const Scalar vec[2])
 {
 	result[0] = vec[0];
 	result[1] = 0;
@@ -92,28 +422,28 @@ static GLfloat *Project3(GLfloat result[3], const GLfloat vec[2])
 }
 
 // Calculate intercept of two lines: v1,v2 are on one line, v3,v4 on other.
-static GLfloat *Intercept2(
-	GLfloat       result[2],
-	const GLfloat v1[2],
-	const GLfloat v2[2],
-	const GLfloat v3[2],
-	const GLfloat v4[2])
-{
-	GLfloat d12[2]  = {v1[0] - v2[0], v1[1] - v2[1]},
-	        d34[2]  = {v3[0] - v4[0], v3[1] - v4[1]},
-	        divisor = d12[0]*d34[1] - d12[1]*d34[0];
+static Scalar *Intercept2(
+	Scalar       result[2],
+	const Scalar v1[2],
+	const Scalar v2[2],
+	const Scalar v3[2],
+	const Scalar v4[2])
+{
+	Scalar d12[2]  = {v1[0] - v2[0], v1[1] - v2[1]},
+	       d34[2]  = {v3[0] - v4[0], v3[1] - v4[1]},
+	       divisor = d12[0]*d34[1] - d12[1]*d34[0];
 	if (divisor == 0) {
 		return NULL;
 	}
-	GLfloat e1 = v1[0]*v2[1] - v1[1]*v2[0],
-	        e2 = v3[0]*v4[1] - v3[1]*v4[0];
+	Scalar e1 = v1[0]*v2[1] - v1[1]*v2[0],
+	       e2 = v3[0]*v4[1] - v3[1]*v4[0];
 	divisor = 1/divisor;
 	result[0] = (e1*d34[0] - e2*d12[0]) * divisor;
 	result[1] = (e1*d34[1] - e2*d12[1]) * divisor;
 	return result;
 }
 
-static GLfloat *Project2(GLfloat result[2], const GLfloat v[3])
+static Scalar *Project2(Scalar result[2], const Scalar v[3])
 {
 	result[0] = v[0];
 	result[1] = v[2];
@@ -128,33 +458,33 @@ static void CalcCurvedDims(
 	*dims = (CurvedDims){0};
 
 	// Calculate intercept of paths
-	GLfloat v1[2] = {
+	Scalar v1[2] = {
 		track->start[0] + track->startDir[0],
 		track->start[1] + track->startDir[1]
 	};
-	GLfloat *v2 = track->start;
-	GLfloat v3[2] = {
+	Scalar *v2 = track->start;
+	Scalar v3[2] = {
 		track->end[0] + track->endDir[0],
 		track->end[1] + track->endDir[1]
 	};
-	GLfloat *v4 = track->end;
-	GLfloat inter[3];
-	Project3(inter, Intercept2((GLfloat [2]){0}, v1, v2, v3, v4));
+	Scalar *v4 = track->end;
+	Scalar inter[3];
+	Project3(inter, Intercept2((Scalar [2]){0}, v1, v2, v3, v4));
 
 	// Calculate intercept of normals to path lines at one distance to intercept
-	GLfloat start[3], startDir[3], end[3], endDir[3];
+	Scalar start[3], startDir[3], end[3], endDir[3];
 	Project3(start, track->start);
-	Normalize3(startDir, Project3((GLfloat [3]){0}, track->startDir));
+	Normalize3(startDir, Project3((Scalar [3]){0}, track->startDir));
 	Project3(end, track->end);
-	Normalize3(endDir, Project3((GLfloat [3]){0}, track->endDir));
+	Normalize3(endDir, Project3((Scalar [3]){0}, track->endDir));
 
 	// Use the smaller distance to the intercept
-	GLfloat startToInter[3], endToInter[3];
+	Scalar startToInter[3], endToInter[3];
 	Saxpy3(startToInter, inter, -1, start);
 	Saxpy3(endToInter, inter, -1, end);
-	GLfloat startToInterL = Length3(startToInter),
-	        endToInterL   = Length3(endToInter);
-	GLfloat w1[2], w2[2], w3[2], w4[2];
+	Scalar startToInterL = Length3(startToInter),
+	       endToInterL   = Length3(endToInter);
+	Scalar w1[2], w2[2], w3[2], w4[2];
 	if (startToInterL < endToInterL) {
 		// Start is closer to intercept
 		Project2(w1, start);
@@ -163,7 +493,7 @@ static void CalcCurvedDims(
 		Project2(
 			w3,
 			Saxpy3(
-				(GLfloat [3]){0},
+				(Scalar [3]){0},
 				end,
 				(endToInterL-startToInterL)/endToInterL,
 				endToInter
@@ -176,7 +506,7 @@ static void CalcCurvedDims(
 		Project2(
 			w1,
 			Saxpy3(
-				(GLfloat [3]){0},
+				(Scalar [3]){0},
 				start,
 				(startToInterL-endToInterL)/startToInterL,
 				startToInter
@@ -188,16 +518,16 @@ static void CalcCurvedDims(
 		w4[0] = w3[0] - endToInter[2];
 		w4[1] = w3[1] + endToInter[0];
 	}
-	Project3(dims->arcOrigin, Intercept2((GLfloat [2]){0}, w1, w2, w3, w4));
+	Project3(dims->arcOrigin, Intercept2((Scalar [2]){0}, w1, w2, w3, w4));
 
 	// Translate and rotate end vector to get start position as origin, and
 	// startDir as the i unit vector
-	GLfloat endT[2] = {end[0] - start[0], end[2] - start[2]};
-	GLfloat rotMat[4] = {
+	Scalar endT[2] = {end[0] - start[0], end[2] - start[2]};
+	Scalar rotMat[4] = {
 		startDir[0], -startDir[2],
 		startDir[2], startDir[0]
 	};
-	GLfloat endT2[2] = {
+	Scalar endT2[2] = {
 		rotMat[0]*endT[0] + rotMat[2]*endT[1],
 		rotMat[1]*endT[0] + rotMat[3]*endT[1]
 	};
@@ -207,21 +537,15 @@ static void CalcCurvedDims(
 	}
 
 	// Calculate arc angles
-	GLfloat w1_[3], w3_[3];
+	Scalar w1_[3], w3_[3];
 	Project3(w1_, w1);
 	Project3(w3_, w3);
-	GLfloat arcVecStart[3];
+	Scalar arcVecStart[3];
 	Saxpy3(arcVecStart, w1_, -1, dims->arcOrigin);
-	dims->startAngle = Angle3(iUnit, arcVecStart);
-	if (Cross3((GLfloat [3]){0}, iUnit, arcVecStart)[1] < 0) {
-		dims->startAngle *= -1;
-	}
-	GLfloat arcVecEnd[3];
+	dims->startAngle = 360/(2*PI) * atan2f(-arcVecStart[2], arcVecStart[0]);
+	Scalar arcVecEnd[3];
 	Saxpy3(arcVecEnd, w3_, -1, dims->arcOrigin);
-	GLfloat endAngle = Angle3(iUnit, arcVecEnd);
-	if (Cross3((GLfloat [3]){0}, iUnit, arcVecEnd)[1] < 0) {
-		endAngle *= -1;
-	}
+	Scalar endAngle = 360/(2*PI) * atan2f(-arcVecEnd[2], arcVecEnd[0]);
 	dims->arcAngle = fmodf(360 + endAngle - dims->startAngle, 360);
 	if (dims->clockwiseArc) {
 		dims->arcAngle = 360 - dims->arcAngle;
@@ -231,23 +555,13 @@ static void CalcCurvedDims(
 
 	// Set up straight section
 	if (startToInterL < endToInterL) {
-		GLfloat arcToEnd[3];
+		Scalar arcToEnd[3];
 		Saxpy3(arcToEnd, end, -1, w3_);
-		Saxpy3(dims->straightSection.position, w3_, 0.5, arcToEnd);
-		dims->straightSection.length = Length3(arcToEnd);
-		dims->straightSection.orientation = Angle3(iUnit, arcToEnd);
-		if (Cross3((GLfloat [3]){0}, iUnit, arcToEnd)[1] < 0) {
-			dims->straightSection.orientation *= -1;
-		}
+		CalcSectionDims(&dims->straightSection, w3_, arcToEnd);
 	} else {
-		GLfloat startToArc[3];
+		Scalar startToArc[3];
 		Saxpy3(startToArc, w1_, -1, start);
-		Saxpy3(dims->straightSection.position, start, 0.5, startToArc);
-		dims->straightSection.length = Length3(startToArc);
-		dims->straightSection.orientation = Angle3(iUnit, startToArc);
-		if (Cross3((GLfloat [3]){0}, iUnit, startToArc)[1] < 0) {
-			dims->straightSection.orientation *= -1;
-		}
+		CalcSectionDims(&dims->straightSection, start, startToArc);
 		dims->straightFirst = true;
 	}
 
@@ -255,7 +569,7 @@ static void CalcCurvedDims(
 	if (dims->arcRadius == 0) {
 		dims->segments = 0;
 	} else {
-		static const GLfloat targetArcAngleDiff = 3,
+		static const Scalar targetArcAngleDiff = 3,
 		                     minSegmentLength   = 0.2;
 		dims->arcLength = 2*PI/360 * dims->arcAngle * dims->arcRadius;
 		dims->segments = dims->arcAngle / targetArcAngleDiff;
@@ -268,230 +582,119 @@ static void CalcCurvedDims(
 	}
 }
 
-CurvedTrack *AllocCurvedTrack(
-	const GLfloat start[2],
-	const GLfloat startDir[2],
-	const GLfloat end[2],
-	const GLfloat endDir[2],
-	TrackShared   *next,
-	TrackShared   *prev)
-{
-	CurvedTrack *result = malloc(sizeof *result);
-	assert(result);
-	*result = (CurvedTrack){
-		.shared = {.type = Type_curved},
-		.next   = next,
-		.prev   = prev
-	};
-	memcpy(result->start, start, sizeof result->start);
-	memcpy(result->startDir, startDir, sizeof result->startDir);
-	memcpy(result->end, end, sizeof result->end);
-	memcpy(result->endDir, endDir, sizeof result->endDir);
-	CalcCurvedDims(result, &result->dims);
-	return result;
+Scalar g_trackSampleTolerance = 0.001;
+
+// Calculates point and direction at distance `pos` along arc of curved track
+static void CalcArcCoords(
+	const CurvedDims *dims,
+	Scalar           coords[3],
+	Scalar           tangent[3],
+	Scalar           pos)
+{
+	Scalar angle;
+	if (!dims->clockwiseArc) {
+		angle =   dims->startAngle
+		        + dims->arcAngle * pos / dims->arcLength;
+	} else {
+		angle =   dims->startAngle
+		        - dims->arcAngle * pos / dims->arcLength;
+	}
+	Scalar cosine = cosf(2*PI/360 * angle),
+	       sine   = sinf(2*PI/360 * angle);
+	coords[0] = dims->arcOrigin[0] + dims->arcRadius*cosine;
+	coords[1] = dims->arcOrigin[1];
+	coords[2] = dims->arcOrigin[2] - dims->arcRadius*sine;
+	if (tangent) {
+		Scalar sign = dims->clockwiseArc ? 1 : -1;
+		tangent[0] = sign*sine;
+		tangent[1] = 0;
+		tangent[2] = sign*cosine;
+	}
 }
 
-static GLuint straightRailsDl = 0;
-static const GLfloat whiteColor[4] = {1, 1, 1, 1},
-                     blackColor[4] = {0, 0, 0, 1},
-                     woodColor[4] = {0.3, 0.2, 0.15, 1},
-                     metalColor[4] = {0.40, 0.35, 0.37, 1};
-
-// Draws 3 faces (vertical sides + top) of box for train rails
-static void DrawRailBox(void)
-{
-	glPushMatrix();
-		glScalef(1, 0.05, 0.04);
-		glPushMatrix();
-			glRotatef(-90, 1, 0, 0);
-			glTranslatef(0, 0.5, 0);
-			DrawSquare();
-		glPopMatrix();
-		glPushMatrix();
-			glTranslatef(0, 0.5, 0);
-			DrawSquare();
-		glPopMatrix();
-		glPushMatrix();
-			glRotatef(90, 1, 0, 0);
-			glTranslatef(0, 0.5, 0);
-			DrawSquare();
-		glPopMatrix();
-	glPopMatrix();
+// Number of samples needed so that interpolating between them stays within
+// g_trackSampleTolerance of the arc, or 0 if arc shouldn't be tabulated
+static unsigned CalcArcSamples(const CurvedDims *dims)
+{
+	if (g_trackSampleTolerance <= 0 || dims->arcLength <= 0) {
+		return 0;
+	}
+	// Chord between samples h apart deviates from arc by about h^2/(8r)
+	Scalar step = sqrtf(8 * dims->arcRadius * g_trackSampleTolerance);
+	return ceilf(dims->arcLength / step) + 1;
 }
 
-void InitTrack(void)
+CurvedTrack *AllocCurvedTrack(
+	const Scalar start[2],
+	const Scalar startDir[2],
+	const Scalar end[2],
+	const Scalar endDir[2],
+	TrackShared  *next,
+	TrackShared  *prev)
 {
-	CalcStraightDims(&g_initialTrackPiece, &g_initialTrackPiece.dims);
+	CurvedTrack track = {.shared = {.type = Type_curved}};
+	memcpy(track.start, start, sizeof track.start);
+	memcpy(track.startDir, startDir, sizeof track.startDir);
+	memcpy(track.end, end, sizeof track.end);
+	memcpy(track.endDir, endDir, sizeof track.endDir);
+	CalcCurvedDims(&track, &track.dims);
 
-	straightRailsDl = glGenLists(1);
-	assert(straightRailsDl);
-	glNewList(straightRailsDl, GL_COMPILE);
-		glPushMatrix();
-			glTranslatef(0, 0.075, 0);
-			glPushMatrix();
-				glRotatef(180, 0, 1, 0);
-				glTranslatef(0, 0, 0.5);
-				DrawRailBox();
-			glPopMatrix();
-			glPushMatrix();
-				glTranslatef(0, 0, 0.5);
-				DrawRailBox();
-			glPopMatrix();
-		glPopMatrix();
-	glEndList();
-}
-
-// Draw straight rails
-static void DrawStraightTrackSection(
-	const GLfloat position[3],
-	GLfloat       orientation,
-	GLfloat       length)
-{
-	glMaterialfv(GL_FRONT, GL_AMBIENT, metalColor);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, metalColor);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, whiteColor);
-	glMaterialf(GL_FRONT, GL_SHININESS, 50);
-	glPushMatrix();
-		glTranslatef(position[0], position[1], position[2]);
-		glRotatef(orientation, 0, 1, 0);
-		glScalef(length, 1, 1);
-		glCallList(straightRailsDl);
-	glPopMatrix();
-}
-
-static void DrawStraightTrack(StraightTrack *track)
-{
-	StraightDims *dims = &track->dims;
-	DrawStraightTrackSection(
-		dims->position,
-		dims->orientation,
-		dims->length
-	);
-}
+	// Bound straight section and arc, as drawn in segments
+	ClearBounds(track.shared.bounds);
+	AddSectionBounds(track.shared.bounds, &track.dims.straightSection);
+	unsigned segments = track.dims.segments;
+	for (unsigned i = 0; segments && i <= segments; ++i) {
+		Scalar coords[3];
+		CalcArcCoords(
+			&track.dims,
+			coords,
+			NULL,
+			i*track.dims.arcLength/segments
+		);
+		AddBoundsPoint(track.shared.bounds, coords);
+	}
 
-static void DrawCurvedTrackArc(
-	GLfloat  radius,
-	GLfloat  startAngle,
-	GLfloat  arcAngle,
-	unsigned segments)
-{
-	glMaterialfv(GL_FRONT, GL_AMBIENT, metalColor);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, metalColor);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, whiteColor);
-	glMaterialf(GL_FRONT, GL_SHININESS, 50);
-
-	// Draw inner-arc track face
-	glBegin(GL_TRIANGLE_STRIP);
-	for (unsigned i = 0; i <= segments; ++i) {
-		GLfloat angle =
-			startAngle + i*arcAngle/segments;
-		GLfloat cosine = cosf(2*PI/360*angle), sine = sinf(2*PI/360*angle);
-		glNormal3f(-cosine, 0, sine);
-		glVertex3f(radius*cosine, -0.5, -radius*sine);
-		glNormal3f(-cosine, 0, sine);
-		glVertex3f(radius*cosine, 0.5, -radius*sine);
-	}
-	glEnd();
-	// Draw top track face
-	glBegin(GL_TRIANGLE_STRIP);
-	for (unsigned i = 0; i <= segments; ++i) {
-		GLfloat angle =
-			startAngle + i*arcAngle/segments;
-		GLfloat cosine = cosf(2*PI/360*angle), sine = sinf(2*PI/360*angle);
-		glNormal3f(0, 1, 0);
-		glVertex3f(radius*cosine, 0.5, -radius*sine);
-		glNormal3f(0, 1, 0);
-		glVertex3f((radius+0.04)*cosine, 0.5, -(radius+0.04)*sine);
-	}
-	glEnd();
-	radius += 0.04;
-	// Draw outer-arc track face
-	glBegin(GL_TRIANGLE_STRIP);
-	for (unsigned i = 0; i <= segments; ++i) {
-		GLfloat angle =
-			startAngle + i*arcAngle/segments;
-		GLfloat cosine = cosf(2*PI/360*angle), sine = sinf(2*PI/360*angle);
-		glNormal3f(cosine, 0, -sine);
-		glVertex3f(radius*cosine, 0.5, -radius*sine);
-		glNormal3f(cosine, 0, -sine);
-		glVertex3f(radius*cosine, -0.5, -radius*sine);
-	}
-	glEnd();
-}
-
-static void DrawCurvedTrack(CurvedTrack *track)
-{
-	glPushMatrix();
-	if (!track->renderDl) {
-		track->renderDl = glGenLists(1);
-		assert(track->renderDl);
-		glNewList(track->renderDl, GL_COMPILE_AND_EXECUTE);
-			CurvedDims *dims = &track->dims;
-			StraightDims *line = &dims->straightSection;
-			if (line->length != 0) {
-				DrawStraightTrackSection(
-					line->position,
-					line->orientation,
-					line->length
-				);
-			}
-			glTranslatef(
-				dims->arcOrigin[0],
-				dims->arcOrigin[1] + 0.075,
-				dims->arcOrigin[2]
-			);
-			glScalef(1, 0.05, 1);
-			GLfloat startAngle = dims->startAngle;
-			GLfloat radius = dims->arcRadius - 0.52;
-			if (dims->clockwiseArc) {
-				startAngle = dims->startAngle - dims->arcAngle;
-			}
-			DrawCurvedTrackArc(
-				radius,
-				startAngle,
-				dims->arcAngle,
-				dims->segments
-			);
-			radius += 1;
-			DrawCurvedTrackArc(
-				radius,
-				startAngle,
-				dims->arcAngle,
-				dims->segments
-			);
-		glEndList();
-	} else {
-		glCallList(track->renderDl);
+	// Tabulate arc coordinates after rest of piece
+	track.nSamples = CalcArcSamples(&track.dims);
+	CurvedTrack *result = AllocPiece(
+		sizeof *result + 4*track.nSamples * sizeof *result->samples
+	);
+	*result = track;
+	Track_SetNext((TrackShared *)result, next);
+	Track_SetPrevious((TrackShared *)result, prev);
+	if (result->nSamples) {
+		result->sampleStep = track.dims.arcLength / (track.nSamples - 1);
+		for (unsigned i = 0; i < result->nSamples; ++i) {
+			Scalar coords[3], tangent[3];
+			CalcArcCoords(&track.dims, coords, tangent, i*result->sampleStep);
+			Scalar *sample = &result->samples[4*i];
+			sample[0] = coords[0];
+			sample[1] = coords[2];
+			sample[2] = tangent[0];
+			sample[3] = tangent[2];
+		}
 	}
-	glPopMatrix();
+	return result;
 }
 
-void Track_Draw(TrackShared *track)
+void Track_GetBounds(const TrackShared *track, Scalar min[3], Scalar max[3])
 {
-	switch (track->type) {
-	case Type_straight:
-		DrawStraightTrack((StraightTrack *)track);
-		break;
-	case Type_curved:
-		DrawCurvedTrack((CurvedTrack *)track);
-		break;
-	default:
-		abort();
-	}
+	memcpy(min, track->bounds[0], sizeof track->bounds[0]);
+	memcpy(max, track->bounds[1], sizeof track->bounds[1]);
 }
 
-static GLfloat StraightTrack_GetLength(StraightTrack *track)
+static Scalar StraightTrack_GetLength(StraightTrack *track)
 {
 	return track->dims.length;
 }
 
-static GLfloat CurvedTrack_GetLength(CurvedTrack *track)
+static Scalar CurvedTrack_GetLength(CurvedTrack *track)
 {
 	return   track->dims.arcLength
 	       + track->dims.straightSection.length;
 }
 
-GLfloat Track_GetLength(TrackShared *track)
+Scalar Track_GetLength(TrackShared *track)
 {
 	switch (track->type) {
 	case Type_straight:
@@ -503,14 +706,26 @@ GLfloat Track_GetLength(TrackShared *track)
 	}
 }
 
+// Follows link to another piece
+static TrackShared *GetLink(const TrackLink *link)
+{
+	return *link ? (TrackShared *)((intptr_t)link + *link) : NULL;
+}
+
+// Points link to another piece
+static void SetLink(TrackLink *link, const TrackShared *track)
+{
+	*link = track ? (intptr_t)track - (intptr_t)link : 0;
+}
+
 static TrackShared *StraightTrack_GetNext(StraightTrack *track)
 {
-	return track->next;
+	return GetLink(&track->next);
 }
 
 static TrackShared *CurvedTrack_GetNext(CurvedTrack *track)
 {
-	return track->next;
+	return GetLink(&track->next);
 }
 
 TrackShared *Track_GetNext(TrackShared *track)
@@ -527,12 +742,12 @@ TrackShared *Track_GetNext(TrackShared *track)
 
 static TrackShared *StraightTrack_GetPrevious(StraightTrack *track)
 {
-	return track->prev;
+	return GetLink(&track->prev);
 }
 
 static TrackShared *CurvedTrack_GetPrevious(CurvedTrack *track)
 {
-	return track->prev;
+	return GetLink(&track->prev);
 }
 
 TrackShared *Track_GetPrevious(TrackShared *track)
@@ -547,21 +762,113 @@ TrackShared *Track_GetPrevious(TrackShared *track)
 	}
 }
 
-void StraightTrack_GetCoords(
+void Track_SetNext(TrackShared *track, TrackShared *next)
+{
+	switch (track->type) {
+	case Type_straight:
+		SetLink(&((StraightTrack *)track)->next, next);
+		break;
+	case Type_curved:
+		SetLink(&((CurvedTrack *)track)->next, next);
+		break;
+	default:
+		abort();
+	}
+}
+
+void Track_SetPrevious(TrackShared *track, TrackShared *prev)
+{
+	switch (track->type) {
+	case Type_straight:
+		SetLink(&((StraightTrack *)track)->prev, prev);
+		break;
+	case Type_curved:
+		SetLink(&((CurvedTrack *)track)->prev, prev);
+		break;
+	default:
+		abort();
+	}
+}
+
+TrackShared *Track_GetBranch(TrackShared *track, TrackEnd end)
+{
+	return GetLink(&track->branches[end]);
+}
+
+void Track_SetBranch(TrackShared *track, TrackEnd end, TrackShared *branch)
+{
+	SetLink(&track->branches[end], branch);
+}
+
+void Track_SetSwitch(TrackShared *track, TrackEnd end, SwitchState state)
+{
+	track->switches[end] = state;
+}
+
+TrackShared *Track_Follow(TrackShared *track, TrackEnd end)
+{
+	TrackShared *branch = GetLink(&track->branches[end]);
+	if (branch && track->switches[end] == Switch_reverse) {
+		return branch;
+	}
+	return end == TrackEnd_end ? Track_GetNext(track)
+	                           : Track_GetPrevious(track);
+}
+
+size_t Track_GetSize(const TrackShared *track)
+{
+	const CurvedTrack *curved = (const CurvedTrack *)track;
+	switch (track->type) {
+	case Type_straight:
+		return sizeof (StraightTrack);
+	case Type_curved:
+		return sizeof *curved + 4*curved->nSamples * sizeof *curved->samples;
+	default:
+		abort();
+	}
+}
+
+static void StraightTrack_GetCoords(
 	StraightTrack *track,
-	GLfloat       coords[3],
-	GLfloat       pos)
+	Scalar        coords[3],
+	Scalar        pos)
 {
-	GLfloat start[3], end[3], forwards[3];
-	Project3(start, track->start);
-	Project3(end, track->end);
-	Normalize3(forwards, Saxpy3((GLfloat [3]){0}, end, -1, start));
-	Saxpy3(coords, start, pos, forwards);
+	Saxpy3(coords, track->dims.start, pos, track->dims.forwards);
 }
 
-void CurvedTrack_GetCoords(CurvedTrack *track, GLfloat coords[3], GLfloat pos)
+// Looks up point and direction at distance `pos` along arc in sample table
+static void CurvedTrack_LookupArc(
+	const CurvedTrack *track,
+	Scalar            coords[3],
+	Scalar            tangent[3],
+	Scalar            pos)
+{
+	// Clamp before converting, so no position indexes outside the table
+	unsigned last = track->nSamples >= 2 ? track->nSamples - 2 : 0;
+	Scalar t = pos / track->sampleStep;
+	unsigned i = 0;
+	if (t > 0) {
+		i = t < last ? t : last;
+	}
+	Scalar f = t - i;
+	const Scalar *s0 = &track->samples[4*i],
+	             *s1 = s0 + 4;
+	coords[0] = s0[0] + f*(s1[0] - s0[0]);
+	coords[1] = track->dims.arcOrigin[1];
+	coords[2] = s0[1] + f*(s1[1] - s0[1]);
+	if (tangent) {
+		tangent[0] = s0[2] + f*(s1[2] - s0[2]);
+		tangent[1] = 0;
+		tangent[2] = s0[3] + f*(s1[3] - s0[3]);
+	}
+}
+
+static void CurvedTrack_GetCoordsAndTangent(
+	CurvedTrack *track,
+	Scalar      coords[3],
+	Scalar      tangent[3],
+	Scalar      pos)
 {
-	GLfloat forwards[3];
 	CurvedDims *dims = &track->dims;
 	if (   (dims->straightFirst && pos <= dims->straightSection.length)
 	    || (!dims->straightFirst && pos > dims->arcLength))
@@ -569,148 +876,437 @@ void CurvedTrack_GetCoords(CurvedTrack *track, GLfloat coords[3], GLfloat pos)
 		if (!dims->straightFirst) {
 			pos -= dims->arcLength;
 		}
-		forwards[0] =
-			cosf(2*PI/360 * dims->straightSection.orientation);
-		forwards[1] = 0;
-		forwards[2] =
-			-sinf(2*PI/360 * dims->straightSection.orientation);
-		GLfloat start[3];
-		Saxpy3(
-			start,
-			dims->straightSection.position,
-			-0.5*dims->straightSection.length,
-			forwards
-		);
-		Saxpy3(coords, start, pos, forwards);
+		StraightDims *line = &dims->straightSection;
+		Saxpy3(coords, line->start, pos, line->forwards);
+		if (tangent) {
+			memcpy(tangent, line->forwards, sizeof line->forwards);
+		}
 	} else {
 		if (dims->straightFirst) {
 			pos -= dims->straightSection.length;
 		}
-		GLfloat startAngle = dims->startAngle;
-		GLfloat angle;
-		if (!dims->clockwiseArc) {
-			angle =   startAngle
-			        + dims->arcAngle * pos / dims->arcLength;
+		if (track->nSamples >= 2) {
+			CurvedTrack_LookupArc(track, coords, tangent, pos);
 		} else {
-			angle =   startAngle
-			        - dims->arcAngle * pos / dims->arcLength;
+			CalcArcCoords(dims, coords, tangent, pos);
 		}
-		coords[0] =   dims->arcOrigin[0]
-		            + dims->arcRadius*cosf(2*PI/360 * angle);
-		coords[1] =   dims->arcOrigin[1];
-		coords[2] =   dims->arcOrigin[2]
-		            - dims->arcRadius*sinf(2*PI/360 * angle);
 	}
 }
 
-void Track_GetCoords(TrackShared *track, GLfloat coords[3], GLfloat pos)
+void Track_GetCoords(TrackShared *track, Scalar coords[3], Scalar pos)
 {
 	switch (track->type) {
 	case Type_straight:
 		StraightTrack_GetCoords((StraightTrack *)track, coords, pos);
 		break;
 	case Type_curved:
-		CurvedTrack_GetCoords((CurvedTrack *)track, coords, pos);
+		CurvedTrack_GetCoordsAndTangent(
+			(CurvedTrack *)track,
+			coords,
+			NULL,
+			pos
+		);
+		break;
+	default:
+		abort();
+	}
+}
+
+void Track_GetTangent(TrackShared *track, Scalar tangent[3], Scalar pos)
+{
+	switch (track->type) {
+	case Type_straight:
+		memcpy(
+			tangent,
+			((StraightTrack *)track)->dims.forwards,
+			3 * sizeof *tangent
+		);
+		break;
+	case Type_curved:
+		CurvedTrack_GetCoordsAndTangent(
+			(CurvedTrack *)track,
+			(Scalar [3]){0},
+			tangent,
+			pos
+		);
 		break;
 	default:
 		abort();
 	}
 }
 
-static void DrawSlatsStep(NetworkPos *pos)
+// Gets distance in x-z plane from point to straight section, storing
+// distance along section of nearest point in pos
+static Scalar Section_GetDistance(
+	const StraightDims *dims,
+	const Scalar       point[3],
+	Scalar             *pos)
 {
-	GLfloat start[3], end[3], diff[3];
-	NetworkPos_Move(pos, -0.001);
-	Track_GetCoords(pos->track, start, pos->pos);
-	NetworkPos_Move(pos, 0.001);
-	Track_GetCoords(pos->track, end, pos->pos);
-	Saxpy3(diff, end, -1, start);
-	glPushMatrix();
-		glTranslatef(end[0], end[1], end[2]);
-		GLfloat angle = Angle3(iUnit, diff);
-		if (Cross3((GLfloat [3]){0}, iUnit, diff)[1] < 0) {
-			angle *= -1;
+	Scalar toPoint[3];
+	Saxpy3(toPoint, point, -1, dims->start);
+	toPoint[1] = 0;
+	*pos = fminf(fmaxf(Dot3(toPoint, dims->forwards), 0), dims->length);
+	Scalar nearest[3];
+	Saxpy3(nearest, dims->start, *pos, dims->forwards);
+	return hypotf(point[0] - nearest[0], point[2] - nearest[2]);
+}
+
+// Gets distance in x-z plane from point to arc, storing distance along arc
+// of nearest point in pos
+static Scalar Arc_GetDistance(
+	const CurvedDims *dims,
+	const Scalar     point[3],
+	Scalar           *pos)
+{
+	Scalar dx = point[0] - dims->arcOrigin[0],
+	       dz = point[2] - dims->arcOrigin[2];
+	if (dims->arcLength > 0) {
+		// Angle swept from arc start to the point's direction from origin
+		Scalar angle = 360/(2*PI) * atan2f(-dz, dx);
+		Scalar swept = dims->clockwiseArc ? dims->startAngle - angle
+		                                  : angle - dims->startAngle;
+		swept = fmodf(swept, 360);
+		if (swept < 0) {
+			swept += 360;
+		}
+		if (swept <= dims->arcAngle) {
+			*pos = dims->arcLength * swept / dims->arcAngle;
+			return fabsf(hypotf(dx, dz) - dims->arcRadius);
 		}
-		glRotatef(angle, 0, 1, 0);
-		glScalef(0.2, 0.0375, 1.2);
-		glBegin(GL_QUADS);
-			glNormal3f(0, 0, 1);
-			glVertex3f(0.5, 0, 0.5);
-			glVertex3f(0.5, 1, 0.5);
-			glVertex3f(-0.5, 1, 0.5);
-			glVertex3f(-0.5, 0, 0.5);
-
-			glNormal3f(-1, 0, 0);
-			glVertex3f(-0.5, 0, 0.5);
-			glVertex3f(-0.5, 1, 0.5);
-			glVertex3f(-0.5, 1, -0.5);
-			glVertex3f(-0.5, 0, -0.5);
-
-			glNormal3f(0, 0, -1);
-			glVertex3f(-0.5, 0, -0.5);
-			glVertex3f(-0.5, 1, -0.5);
-			glVertex3f(0.5, 1, -0.5);
-			glVertex3f(0.5, 0, -0.5);
-
-			glNormal3f(1, 0, 0);
-			glVertex3f(0.5, 0, -0.5);
-			glVertex3f(0.5, 1, -0.5);
-			glVertex3f(0.5, 1, 0.5);
-			glVertex3f(0.5, 0, 0.5);
-
-			glNormal3f(0, 1, 0);
-			glVertex3f(0.5, 1, 0.5);
-			glVertex3f(0.5, 1, -0.5);
-			glVertex3f(-0.5, 1, -0.5);
-			glVertex3f(-0.5, 1, 0.5);
-		glEnd();
-	glPopMatrix();
-}
-
-// Draws wooden slats in track network
-void DrawSlats(GLfloat minDistance)
-{
-	// Compile slats on first run
-	static GLuint slatsDl = 0;
-	if (slatsDl) {
-		glPushMatrix();
-			glCallList(slatsDl);
-		glPopMatrix();
-		return;
-	}
-	slatsDl = glGenLists(1);
-	assert(slatsDl);
-	glPushMatrix();
-	glNewList(slatsDl, GL_COMPILE_AND_EXECUTE);
-
-	// Set to slat material
-	glMaterialfv(GL_FRONT, GL_AMBIENT, woodColor);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, woodColor);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, blackColor);
-	glMaterialf(GL_FRONT, GL_SHININESS, 0);
-
-	// Calculate total track length
-	TrackShared *track = (TrackShared *)&g_initialTrackPiece;
-	GLfloat length = Track_GetLength(track);
-	track = Track_GetNext(track);
-	while (track != (TrackShared *)&g_initialTrackPiece) {
-		length += Track_GetLength(track);
-		track = Track_GetNext(track);
 	}
-	// Find actual target distance
-	minDistance = length / floorf(length / minDistance);
 
-	// Draw slats for whole track
-	NetworkPos pos = {(TrackShared *)&g_initialTrackPiece, 0};
-	while (pos.track == (TrackShared *)&g_initialTrackPiece) {
-		DrawSlatsStep(&pos);
-		NetworkPos_Move(&pos, minDistance);
+	// Otherwise nearest is an end of the arc
+	Scalar start[3], end[3];
+	CalcArcCoords(dims, start, NULL, 0);
+	CalcArcCoords(dims, end, NULL, dims->arcLength);
+	Scalar toStart = hypotf(point[0] - start[0], point[2] - start[2]),
+	       toEnd   = hypotf(point[0] - end[0], point[2] - end[2]);
+	if (toStart <= toEnd || dims->arcLength <= 0) {
+		*pos = 0;
+		return toStart;
 	}
-	while (pos.track != (TrackShared *)&g_initialTrackPiece) {
-		DrawSlatsStep(&pos);
-		NetworkPos_Move(&pos, minDistance);
+	*pos = dims->arcLength;
+	return toEnd;
+}
+
+static Scalar CurvedTrack_GetDistance(
+	CurvedTrack  *track,
+	const Scalar point[3],
+	Scalar       *pos)
+{
+	CurvedDims *dims = &track->dims;
+	Scalar linePos, arcPos;
+	Scalar lineDistance =
+		Section_GetDistance(&dims->straightSection, point, &linePos);
+	Scalar arcDistance = Arc_GetDistance(dims, point, &arcPos);
+	if (dims->straightFirst) {
+		arcPos += dims->straightSection.length;
+	} else {
+		linePos += dims->arcLength;
 	}
+	if (lineDistance < arcDistance) {
+		*pos = linePos;
+		return lineDistance;
+	}
+	*pos = arcPos;
+	return arcDistance;
+}
 
-	glEndList();
-	glPopMatrix();
+Scalar Track_GetDistance(
+	TrackShared  *track,
+	const Scalar point[3],
+	Scalar       *pos)
+{
+	Scalar unused;
+	if (!pos) {
+		pos = &unused;
+	}
+	switch (track->type) {
+	case Type_straight:
+		return Section_GetDistance(
+			&((StraightTrack *)track)->dims,
+			point,
+			pos
+		);
+	case Type_curved:
+		return CurvedTrack_GetDistance((CurvedTrack *)track, point, pos);
+	default:
+		abort();
+	}
+}
+
+// Gets span of piece that NetworkPos_Move() stays within
+static double GetSpan(TrackShared *track)
+{
+	if (!IsIndexed(track)) {
+		return Track_GetLength(track);
+	}
+	const double *offsets = g_networkIndex.offsets;
+	return offsets[track->index + 1] - offsets[track->index];
+}
+
+void NetworkPos_MoveBatch(
+	const NetworkPos *origin,
+	const Scalar     offsets[],
+	unsigned         n,
+	NetworkPos       result[])
+{
+	NetworkPos np = *origin;
+	double span = GetSpan(np.track);
+	Scalar lastOffset = 0;
+	for (unsigned i = 0; i < n; ++i) {
+		// Only look up the network when leaving the current piece
+		Scalar vector = offsets[i] - lastOffset,
+		       pos    = np.pos + vector;
+		if (pos >= 0 && pos <= span) {
+			np.pos = pos;
+		} else {
+			NetworkPos_Move(&np, vector);
+			span = GetSpan(np.track);
+		}
+		result[i] = np;
+		lastOffset = offsets[i];
+	}
+}
+
+// Gets coordinates of positions along section, less shift
+static void Section_GetCoordsBatch(
+	const StraightDims *dims,
+	const NetworkPos   positions[],
+	unsigned           n,
+	Scalar             shift,
+	Scalar             x[restrict],
+	Scalar             z[restrict])
+{
+	Scalar startX    = dims->start[0],
+	       startZ    = dims->start[2],
+	       forwardsX = dims->forwards[0],
+	       forwardsZ = dims->forwards[2];
+	for (unsigned i = 0; i < n; ++i) {
+		Scalar pos = positions[i].pos - shift;
+		x[i] = startX + pos*forwardsX;
+		z[i] = startZ + pos*forwardsZ;
+	}
+}
+
+static void StraightTrack_GetCoordsBatch(
+	const StraightTrack *track,
+	const NetworkPos    positions[],
+	unsigned            n,
+	Scalar              x[restrict],
+	Scalar              z[restrict])
+{
+	Section_GetCoordsBatch(&track->dims, positions, n, 0, x, z);
+}
+
+// Batched CurvedTrack_LookupArc() of positions along arc, less shift
+static void CurvedTrack_LookupArcBatch(
+	const CurvedTrack *track,
+	const NetworkPos  positions[],
+	unsigned          n,
+	Scalar            shift,
+	Scalar            x[restrict],
+	Scalar            z[restrict])
+{
+	const Scalar *restrict samples = track->samples;
+	Scalar   step = track->sampleStep;
+	unsigned last = track->nSamples - 2;
+	for (unsigned i = 0; i < n; ++i) {
+		Scalar t = (positions[i].pos - shift) / step;
+		unsigned j = t > 0 ? (t < last ? t : last) : 0;
+		Scalar f = t - j;
+		const Scalar *s0 = &samples[4*j],
+		             *s1 = s0 + 4;
+		x[i] = s0[0] + f*(s1[0] - s0[0]);
+		z[i] = s0[1] + f*(s1[1] - s0[1]);
+	}
+}
+
+// Batched CalcArcCoords() of positions along arc, less shift
+static void CalcArcCoordsBatch(
+	const CurvedDims *dims,
+	const NetworkPos positions[],
+	unsigned         n,
+	Scalar           shift,
+	Scalar           x[restrict],
+	Scalar           z[restrict])
+{
+	Scalar startAngle = dims->startAngle,
+	       sweep      = dims->clockwiseArc ? -dims->arcAngle : dims->arcAngle,
+	       arcLength  = dims->arcLength,
+	       originX    = dims->arcOrigin[0],
+	       originZ    = dims->arcOrigin[2],
+	       radius     = dims->arcRadius;
+	for (unsigned i = 0; i < n; ++i) {
+		Scalar pos   = positions[i].pos - shift,
+		       angle = startAngle + sweep * pos / arcLength;
+		x[i] = originX + radius*cosf(2*PI/360 * angle);
+		z[i] = originZ - radius*sinf(2*PI/360 * angle);
+	}
+}
+
+static void CurvedTrack_GetCoordsBatch(
+	CurvedTrack      *track,
+	const NetworkPos positions[],
+	unsigned         n,
+	Scalar           x[restrict],
+	Scalar           z[restrict])
+{
+	const CurvedDims *dims = &track->dims;
+	bool   straightFirst = dims->straightFirst,
+	       useTable      = track->nSamples >= 2;
+	Scalar lineLength    = dims->straightSection.length,
+	       arcLength     = dims->arcLength,
+	       lineShift     = straightFirst ? 0 : arcLength,
+	       arcShift      = straightFirst ? lineLength : 0;
+
+	unsigned start = 0;
+	while (start < n) {
+		// Find run of positions on the same part of the piece
+		bool onLine = straightFirst ? positions[start].pos <= lineLength
+		                            : positions[start].pos > arcLength;
+		unsigned end = start + 1;
+		while (   end < n
+		       &&   onLine
+		         == (straightFirst ? positions[end].pos <= lineLength
+		                           : positions[end].pos > arcLength))
+		{
+			++end;
+		}
+
+		const NetworkPos *run = &positions[start];
+		if (onLine) {
+			Section_GetCoordsBatch(
+				&dims->straightSection,
+				run,
+				end - start,
+				lineShift,
+				&x[start],
+				&z[start]
+			);
+		} else if (useTable) {
+			CurvedTrack_LookupArcBatch(
+				track,
+				run,
+				end - start,
+				arcShift,
+				&x[start],
+				&z[start]
+			);
+		} else {
+			CalcArcCoordsBatch(
+				dims,
+				run,
+				end - start,
+				arcShift,
+				&x[start],
+				&z[start]
+			);
+		}
+		start = end;
+	}
+}
+
+void Track_GetCoordsBatch(
+	const NetworkPos positions[],
+	unsigned         n,
+	Scalar           x[],
+	Scalar           z[])
+{
+	unsigned start = 0;
+	while (start < n) {
+		// Find run of positions on the same piece
+		TrackShared *track = positions[start].track;
+		unsigned end = start + 1;
+		while (end < n && positions[end].track == track) {
+			++end;
+		}
+
+		switch (track->type) {
+		case Type_straight:
+			StraightTrack_GetCoordsBatch(
+				(StraightTrack *)track,
+				&positions[start],
+				end - start,
+				&x[start],
+				&z[start]
+			);
+			break;
+		case Type_curved:
+			CurvedTrack_GetCoordsBatch(
+				(CurvedTrack *)track,
+				&positions[start],
+				end - start,
+				&x[start],
+				&z[start]
+			);
+			break;
+		default:
+			abort();
+		}
+		start = end;
+	}
+}
+
+void TrackPoseScratch_Free(TrackPoseScratch *scratch)
+{
+	free(scratch->offsets);
+	free(scratch->x);
+	free(scratch->z);
+	free(scratch->wheels);
+	*scratch = (TrackPoseScratch){0};
+}
+
+void Track_GetPosesBatch(
+	const NetworkPos *origin,
+	const Scalar     offsets[],
+	unsigned         n,
+	Scalar           wheelBase,
+	TrackPoses       *poses,
+	TrackPoseScratch *scratch)
+{
+	if (scratch->capacity < 2*n) {
+		unsigned capacity = scratch->capacity = 2*n;
+		scratch->offsets = realloc(
+			scratch->offsets,
+			capacity * sizeof *scratch->offsets
+		);
+		scratch->x = realloc(scratch->x, capacity * sizeof *scratch->x);
+		scratch->z = realloc(scratch->z, capacity * sizeof *scratch->z);
+		scratch->wheels = realloc(
+			scratch->wheels,
+			capacity * sizeof *scratch->wheels
+		);
+		assert(scratch->offsets && scratch->x && scratch->z && scratch->wheels);
+	}
+	Scalar     *wheelOffsets = scratch->offsets,
+	           *wheelX       = scratch->x,
+	           *wheelZ       = scratch->z;
+	NetworkPos *wheels       = scratch->wheels;
+
+	// Back wheel then front wheel of each vehicle
+	Scalar halfBase = wheelBase/2;
+	for (unsigned i = 0; i < n; ++i) {
+		wheelOffsets[2*i] = offsets[i] - halfBase;
+		wheelOffsets[2*i + 1] = offsets[i] + halfBase;
+	}
+	NetworkPos_MoveBatch(origin, wheelOffsets, 2*n, wheels);
+	Track_GetCoordsBatch(wheels, 2*n, wheelX, wheelZ);
+
+	Scalar *restrict x = poses->x, *restrict z = poses->z,
+	       *restrict sine = poses->sine, *restrict cosine = poses->cosine;
+	for (unsigned i = 0; i < n; ++i) {
+		Scalar dx = wheelX[2*i + 1] - wheelX[2*i],
+		       dz = wheelZ[2*i + 1] - wheelZ[2*i],
+		       invLength = 1/sqrtf(dx*dx + dz*dz);
+		cosine[i] = dx*invLength;
+		sine[i] = -dz*invLength;
+		x[i] = wheelX[2*i] + halfBase*cosine[i];
+		z[i] = wheelZ[2*i] - halfBase*sine[i];
+	}
+	if (poses->heading) {
+		for (unsigned i = 0; i < n; ++i) {
+			poses->heading[i] = 180/PI * atan2f(sine[i], cosine[i]);
+		}
+	}
 }
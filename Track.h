@@ -2,37 +2,72 @@
 #define TRACK_H_INCLUDED
 
 #include <stdbool.h>
-#include <GL/gl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "Scalar.h"
 
 // Must be called before using other track functions
 void InitTrack(void);
 
+// Values of TrackShared.type
+enum {
+	Type_straight,
+	Type_curved
+};
+
+// Extent of drawn rails and slats about the track's centre line
+#define TRACK_HALF_WIDTH 0.6
+#define TRACK_HEIGHT 0.1
+
+// Link from one piece to another, as the byte offset of the target from the
+// link itself, or 0 for none. Pieces stay linked when moved together, as when
+// a whole network is mapped from a file. Use Track_GetNext() etc. to follow.
+typedef ptrdiff_t TrackLink;
+
+// Ends of a track piece, as indexes into TrackShared arrays
+typedef enum {
+	TrackEnd_start, // Joined to previous piece
+	TrackEnd_end    // Joined to next piece
+} TrackEnd;
+
+// Setting of the points at an end of a piece with a branch
+typedef enum {
+	Switch_normal,  // Trains take the next or previous piece
+	Switch_reverse  // Trains take the branch
+} SwitchState;
+
 // 'Parent' type for track pieces
 typedef struct {
-	unsigned type;
+	unsigned  type,
+	          index;        // Slot in g_networkIndex, if indexed
+	Scalar    bounds[2][3]; // Box around drawn piece, min then max corner
+	TrackLink branches[2];  // Diverging piece at each end, or 0 for none
+	uint8_t   switches[2];  // SwitchState at each end
 } TrackShared;
 
 // Straight track pre-calculated dimensions
 typedef struct {
-	GLfloat position[3],
-	        length,
-	        orientation;
+	Scalar position[3],
+	       length,
+	       heading[2],
+	       start[3],
+	       forwards[3]; // Unit vector from start to end
 } StraightDims;
 
 // Specialized type for straight track pieces
 typedef struct {
 	TrackShared  shared;
-	GLfloat      start[2],
+	Scalar       start[2],
 	             end[2];
-	TrackShared  *next,
-	             *prev;
+	TrackLink    next,
+	             prev;
 	StraightDims dims;
 } StraightTrack;
 
 // Curved track pre-calculated dimensions
 typedef struct {
 	StraightDims straightSection;
-	GLfloat      arcOrigin[3],
+	Scalar       arcOrigin[3],
 	             startAngle,
 	             arcAngle,
 	             arcLength,
@@ -45,55 +80,125 @@ typedef struct {
 // Specialized type for curved track pieces
 typedef struct {
 	TrackShared shared;
-	GLfloat     start[2],
+	Scalar      start[2],
 	            startDir[2],
 	            end[2],
 	            endDir[2];
-	TrackShared *next,
-	            *prev;
-	GLuint      renderDl;
+	TrackLink   next,
+	            prev;
 	CurvedDims  dims;
+	unsigned    nSamples;   // Entries in arc sample table, 0 if none
+	Scalar      sampleStep, // Arc length between samples
+	            samples[];  // x, z, tangent x, tangent z of each sample
 } CurvedTrack;
 
 // Represents a position on the track network, occupied by a train or carriage
 typedef struct {
 	TrackShared *track; // Current track piece
-	GLfloat     pos;    // Current length through the current track piece
+	Scalar      pos;    // Current length through the current track piece
 } NetworkPos;
 
-// Move position along track by given vector (i.e. negative to go backwards)
-NetworkPos *NetworkPos_Move(NetworkPos *np, GLfloat vector);
+// Cumulative-length index over a closed ring of track, for fast seeking, and
+// list of pieces off the ring reached through its branches
+typedef struct {
+	TrackShared **pieces;      // Ring pieces in traversal order, then others
+	double      *offsets,      // Distance to start of each ring piece, then
+	                           // ring length
+	            *clearAhead,   // Range of distances reachable from each ring
+	            *clearBehind;  // piece without passing a junction
+	unsigned    nPieces,       // On ring
+	            nBranchPieces, // Off ring, after those on it
+	            generation;    // Differs after each build, for caches to check
+} NetworkIndex;
+
+// Index of main track network, used by NetworkPos functions
+extern NetworkIndex g_networkIndex;
+
+// Builds index of the ring of track starting at head, following next links,
+// and of pieces reached from it through branches.
+// Must be rebuilt after changing the network.
+void NetworkIndex_Build(NetworkIndex *index, TrackShared *head);
+
+// Frees memory held by index
+void NetworkIndex_Free(NetworkIndex *index);
+
+// Gets whether piece is indexed, on the ring or off it
+bool NetworkIndex_Contains(const NetworkIndex *index, const TrackShared *track);
+
+// Gets total length of indexed ring
+Scalar NetworkIndex_GetLength(const NetworkIndex *index);
+
+// Move position along track by given vector (i.e. negative to go backwards),
+// taking branches where switches are reversed, and stopping at dead ends
+NetworkPos *NetworkPos_Move(NetworkPos *np, Scalar vector);
+
+// Gets whether position is on the indexed ring, so has a distance
+bool NetworkPos_IsOnRing(const NetworkPos *np);
+
+// Gets distance of position from start of indexed ring
+double NetworkPos_GetDistance(const NetworkPos *np);
+
+// Sets position to given distance from start of indexed ring (wraps around)
+NetworkPos *NetworkPos_SetDistance(NetworkPos *np, double distance);
 
 extern StraightTrack g_initialTrackPiece;
 
+// Pieces allocated from an arena start at multiples of this
+#define TRACK_PIECE_ALIGN 16
+
+typedef struct TrackArenaBlock TrackArenaBlock;
+
+// Allocates pieces one after another in large blocks, to be freed together
+typedef struct {
+	TrackArenaBlock *blocks; // Most recent first
+} TrackArena;
+
+// Allocates size bytes, aligned to TRACK_PIECE_ALIGN, after those allocated
+// before if they fit in the current block
+void *TrackArena_Alloc(TrackArena *arena, size_t size);
+
+// Frees everything allocated from arena, leaving it empty
+void TrackArena_Free(TrackArena *arena);
+
+// Arena to allocate track pieces from afterwards, or null pointer to allocate
+// each with malloc()
+extern TrackArena *g_trackArena;
+
 // Allocates new straight section of track that runs from start to end, with
 // next and previous track sections (or null pointer).
-// Can free with free() or realloc().
+// Can free with free() if not allocated from an arena. Moving it with
+// realloc() breaks its links.
 StraightTrack *AllocStraightTrack(
-	const GLfloat start[2],
-	const GLfloat end[2],
-	TrackShared   *next,
-	TrackShared   *prev
+	const Scalar start[2],
+	const Scalar end[2],
+	TrackShared  *next,
+	TrackShared  *prev
 );
 
+// Max distance of interpolated arc coordinates from the true arc, for curved
+// track allocated afterwards. Smaller values use more memory; 0 disables the
+// sample tables, so coordinates are calculated exactly.
+extern Scalar g_trackSampleTolerance;
+
 // Allocates new curved section of track that runs from start to end, with next
 // and previous track sections (or null pointer).
 // Angle between startDir and endDir must be in (0, 90], in either direction.
-// Can free with free() or realloc().
+// Can free with free() if not allocated from an arena. Moving it with
+// realloc() breaks its links.
 CurvedTrack *AllocCurvedTrack(
-	const GLfloat start[2],
-	const GLfloat startDir[2],
-	const GLfloat end[2],
-	const GLfloat endDir[2],
-	TrackShared   *next,
-	TrackShared   *prev
+	const Scalar start[2],
+	const Scalar startDir[2],
+	const Scalar end[2],
+	const Scalar endDir[2],
+	TrackShared  *next,
+	TrackShared  *prev
 );
 
-// Renders a section of track
-void Track_Draw(TrackShared *track);
+// Gets the axis-aligned bounding box of a section of track, as drawn
+void Track_GetBounds(const TrackShared *track, Scalar min[3], Scalar max[3]);
 
 // Gets the length of a section of track
-GLfloat Track_GetLength(TrackShared *track);
+Scalar Track_GetLength(TrackShared *track);
 
 // Gets the next section of track in a network
 TrackShared *Track_GetNext(TrackShared *track);
@@ -101,14 +206,100 @@ TrackShared *Track_GetNext(TrackShared *track);
 // Gets the previous section of track in a network
 TrackShared *Track_GetPrevious(TrackShared *track);
 
+// Sets the next section of track in a network (or null pointer)
+void Track_SetNext(TrackShared *track, TrackShared *next);
+
+// Sets the previous section of track in a network (or null pointer)
+void Track_SetPrevious(TrackShared *track, TrackShared *prev);
+
+// Gets the diverging section of track at an end, or null pointer if none.
+// Branches run the same way as the piece they leave or join, so a branch at
+// the end of one piece is the start of another, joined at its start.
+TrackShared *Track_GetBranch(TrackShared *track, TrackEnd end);
+
+// Sets the diverging section of track at an end (or null pointer)
+void Track_SetBranch(TrackShared *track, TrackEnd end, TrackShared *branch);
+
+// Sets switch at an end. NetworkPos_Move() reads switches, so they must not
+// change while other threads move positions.
+void Track_SetSwitch(TrackShared *track, TrackEnd end, SwitchState state);
+
+// Gets the section of track joined at an end along the route its switch is
+// set to, or null pointer at a dead end
+TrackShared *Track_Follow(TrackShared *track, TrackEnd end);
+
+// Gets the number of bytes a piece occupies, including any sample table
+size_t Track_GetSize(const TrackShared *track);
+
 // Gets the coordinates of distance `pos` along this track piece
 void Track_GetCoords(
 	TrackShared *track,
-	GLfloat     coords[3], // Stores coords of point on track
-	GLfloat     pos
+	Scalar      coords[3], // Stores coords of point on track
+	Scalar      pos
+);
+
+// Gets the unit direction of travel at distance `pos` along this track piece
+void Track_GetTangent(
+	TrackShared *track,
+	Scalar      tangent[3], // Stores direction
+	Scalar      pos
 );
 
-// Draws wooden slats in track network
-void DrawSlats(GLfloat minDistance);
+// Gets distance in the x-z plane from point to the centre line of this track
+// piece
+Scalar Track_GetDistance(
+	TrackShared  *track,
+	const Scalar point[3],
+	Scalar       *pos // Stores distance along piece of nearest point, or null
+);
+
+// Moves copies of origin by each of n offsets, storing them in result.
+// Cheapest when consecutive offsets are close together.
+void NetworkPos_MoveBatch(
+	const NetworkPos *origin,
+	const Scalar     offsets[],
+	unsigned         n,
+	NetworkPos       result[]
+);
+
+// Gets x and z coordinates of n positions. Consecutive positions on the same
+// track piece are processed together.
+void Track_GetCoordsBatch(
+	const NetworkPos positions[],
+	unsigned         n,
+	Scalar           x[],
+	Scalar           z[]
+);
+
+// Poses of vehicles on the track, as structure of arrays
+typedef struct {
+	Scalar *x, *z,         // Location
+	       *sine, *cosine, // Heading, as rotation about y from the x axis
+	       *heading;       // Heading in degrees, or null pointer to skip
+} TrackPoses;
+
+// Wheel positions for Track_GetPosesBatch(), grown as needed and reused
+// between calls. Each thread calling it needs its own. Zero to initialize.
+typedef struct {
+	Scalar     *offsets,
+	           *x,
+	           *z;
+	NetworkPos *wheels;
+	unsigned   capacity;
+} TrackPoseScratch;
+
+// Frees memory held by scratch, leaving it empty
+void TrackPoseScratch_Free(TrackPoseScratch *scratch);
+
+// Calculates poses of n vehicles at given offsets from origin, each with
+// wheels wheelBase apart centred on its offset
+void Track_GetPosesBatch(
+	const NetworkPos *origin,
+	const Scalar     offsets[],
+	unsigned         n,
+	Scalar           wheelBase,
+	TrackPoses       *poses,
+	TrackPoseScratch *scratch
+);
 
 #endif // TRACK_H_INCLUDED
@@ -0,0 +1,334 @@
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <assert.h>
+
+#include "TrackGrid.h"
+
+TrackGrid g_trackGrid = {.cellSize = TRACK_GRID_CELL_SIZE};
+
+// Buckets allocated for an empty grid
+#define MIN_BUCKETS 64
+
+// Average entries per bucket before doubling buckets
+#define MAX_LOAD 2
+
+void TrackGrid_Init(TrackGrid *grid, Scalar cellSize)
+{
+	assert(cellSize > 0);
+	*grid = (TrackGrid){.cellSize = cellSize};
+}
+
+void TrackGrid_Free(TrackGrid *grid)
+{
+	for (unsigned i = 0; i < grid->nBuckets; ++i) {
+		free(grid->buckets[i].entries);
+	}
+	free(grid->buckets);
+	TrackGrid_Init(grid, grid->cellSize);
+}
+
+static unsigned HashCell(int x, int z)
+{
+	return (unsigned)x*73856093u ^ (unsigned)z*19349663u;
+}
+
+// Furthest cell from the origin, leaving room to add cell distances to cells
+#define MAX_CELL (INT_MAX/4)
+
+static int GetCell(const TrackGrid *grid, Scalar coord)
+{
+	Scalar cell = floorf(coord / grid->cellSize);
+	return fminf(fmaxf(cell, -MAX_CELL), MAX_CELL);
+}
+
+// Gets distance in cells from cell to range low-high, 0 if within it
+static int GetCellDistance(int cell, int low, int high)
+{
+	return cell < low ? low - cell : cell > high ? cell - high : 0;
+}
+
+static TrackGridBucket *GetBucket(const TrackGrid *grid, int x, int z)
+{
+	return &grid->buckets[HashCell(x, z) & (grid->nBuckets - 1)];
+}
+
+static void AddEntry(TrackGrid *grid, TrackGridEntry entry)
+{
+	TrackGridBucket *bucket = GetBucket(grid, entry.x, entry.z);
+	if (bucket->nEntries == bucket->size) {
+		bucket->size = bucket->size*2 + 4;
+		bucket->entries = realloc(
+			bucket->entries,
+			bucket->size * sizeof *bucket->entries
+		);
+		assert(bucket->entries);
+	}
+	bucket->entries[bucket->nEntries++] = entry;
+	++grid->nEntries;
+}
+
+// Redistributes entries over nBuckets buckets
+static void Rehash(TrackGrid *grid, unsigned nBuckets)
+{
+	TrackGridBucket *old  = grid->buckets;
+	unsigned        nOld = grid->nBuckets;
+	grid->buckets = calloc(nBuckets, sizeof *grid->buckets);
+	assert(grid->buckets);
+	grid->nBuckets = nBuckets;
+	grid->nEntries = 0;
+	for (unsigned i = 0; i < nOld; ++i) {
+		for (unsigned j = 0; j < old[i].nEntries; ++j) {
+			AddEntry(grid, old[i].entries[j]);
+		}
+		free(old[i].entries);
+	}
+	free(old);
+}
+
+void TrackGrid_Build(TrackGrid *grid, const NetworkIndex *index)
+{
+	for (unsigned i = 0; i < grid->nBuckets; ++i) {
+		grid->buckets[i].nEntries = 0;
+	}
+	grid->nEntries = 0;
+	grid->nPieces = 0;
+
+	for (unsigned i = 0; i < index->nPieces + index->nBranchPieces; ++i) {
+		TrackGrid_Insert(grid, index->pieces[i]);
+	}
+}
+
+void TrackGrid_Insert(TrackGrid *grid, TrackShared *track)
+{
+	if (!grid->nBuckets) {
+		Rehash(grid, MIN_BUCKETS);
+	}
+	int minX = GetCell(grid, track->bounds[0][0]),
+	    minZ = GetCell(grid, track->bounds[0][2]),
+	    maxX = GetCell(grid, track->bounds[1][0]),
+	    maxZ = GetCell(grid, track->bounds[1][2]);
+	for (int x = minX; x <= maxX; ++x) {
+		for (int z = minZ; z <= maxZ; ++z) {
+			AddEntry(grid, (TrackGridEntry){track, x, z});
+		}
+	}
+	if (!grid->nPieces++) {
+		grid->min[0] = minX;
+		grid->min[1] = minZ;
+		grid->max[0] = maxX;
+		grid->max[1] = maxZ;
+	} else {
+		grid->min[0] = minX < grid->min[0] ? minX : grid->min[0];
+		grid->min[1] = minZ < grid->min[1] ? minZ : grid->min[1];
+		grid->max[0] = maxX > grid->max[0] ? maxX : grid->max[0];
+		grid->max[1] = maxZ > grid->max[1] ? maxZ : grid->max[1];
+	}
+	if (grid->nEntries > MAX_LOAD*grid->nBuckets) {
+		Rehash(grid, 2*grid->nBuckets);
+	}
+}
+
+void TrackGrid_Remove(TrackGrid *grid, TrackShared *track)
+{
+	if (!grid->nBuckets) {
+		return;
+	}
+	bool found = false;
+	int minX = GetCell(grid, track->bounds[0][0]),
+	    minZ = GetCell(grid, track->bounds[0][2]),
+	    maxX = GetCell(grid, track->bounds[1][0]),
+	    maxZ = GetCell(grid, track->bounds[1][2]);
+	for (int x = minX; x <= maxX; ++x) {
+		for (int z = minZ; z <= maxZ; ++z) {
+			TrackGridBucket *bucket = GetBucket(grid, x, z);
+			for (unsigned i = 0; i < bucket->nEntries; ++i) {
+				TrackGridEntry *entry = &bucket->entries[i];
+				if (entry->track == track && entry->x == x && entry->z == z) {
+					*entry = bucket->entries[--bucket->nEntries];
+					--grid->nEntries;
+					found = true;
+					break;
+				}
+			}
+		}
+	}
+	if (found) {
+		--grid->nPieces;
+	}
+}
+
+// Collects pieces found by a query
+typedef struct {
+	TrackShared  **results;
+	unsigned     maxResults,
+	             nFound;
+	const Scalar *point;  // Radius queries only
+	Scalar       radius;
+} QueryResults;
+
+static void AddResult(QueryResults *query, TrackShared *track)
+{
+	if (query->nFound < query->maxResults) {
+		query->results[query->nFound] = track;
+	}
+	++query->nFound;
+}
+
+// Calls fn once for each piece whose bounding box intersects min-max
+static void ForEachInBox(
+	const TrackGrid *grid,
+	const Scalar    min[3],
+	const Scalar    max[3],
+	void            (*fn)(QueryResults *query, TrackShared *track),
+	QueryResults    *query)
+{
+	if (!grid->nPieces) {
+		return;
+	}
+	int minX = GetCell(grid, min[0]),
+	    minZ = GetCell(grid, min[2]),
+	    maxX = GetCell(grid, max[0]),
+	    maxZ = GetCell(grid, max[2]);
+	minX = minX > grid->min[0] ? minX : grid->min[0];
+	minZ = minZ > grid->min[1] ? minZ : grid->min[1];
+	maxX = maxX < grid->max[0] ? maxX : grid->max[0];
+	maxZ = maxZ < grid->max[1] ? maxZ : grid->max[1];
+	for (int x = minX; x <= maxX; ++x) {
+		for (int z = minZ; z <= maxZ; ++z) {
+			const TrackGridBucket *bucket = GetBucket(grid, x, z);
+			for (unsigned i = 0; i < bucket->nEntries; ++i) {
+				const TrackGridEntry *entry = &bucket->entries[i];
+				if (entry->x != x || entry->z != z) {
+					continue;
+				}
+				Scalar (*bounds)[3] = entry->track->bounds;
+				bool overlaps = true;
+				for (unsigned j = 0; j < 3; ++j) {
+					overlaps = overlaps
+					           && bounds[0][j] <= max[j]
+					           && bounds[1][j] >= min[j];
+				}
+				// Report piece spanning several cells only from the cell
+				// holding the near corner of its overlap with the box
+				if (   overlaps
+				    && GetCell(grid, fmaxf(bounds[0][0], min[0])) == x
+				    && GetCell(grid, fmaxf(bounds[0][2], min[2])) == z)
+				{
+					fn(query, entry->track);
+				}
+			}
+		}
+	}
+}
+
+unsigned TrackGrid_QueryBox(
+	const TrackGrid *grid,
+	const Scalar    min[3],
+	const Scalar    max[3],
+	TrackShared     *results[],
+	unsigned        maxResults)
+{
+	QueryResults query = {results, maxResults, 0, NULL, 0};
+	ForEachInBox(grid, min, max, AddResult, &query);
+	return query.nFound;
+}
+
+static void AddResultInRadius(QueryResults *query, TrackShared *track)
+{
+	if (Track_GetDistance(track, query->point, NULL) <= query->radius) {
+		AddResult(query, track);
+	}
+}
+
+unsigned TrackGrid_QueryRadius(
+	const TrackGrid *grid,
+	const Scalar    point[3],
+	Scalar          radius,
+	TrackShared     *results[],
+	unsigned        maxResults)
+{
+	// Centre lines are at the bottom of bounding boxes
+	const Scalar min[3] = {point[0] - radius, -INFINITY, point[2] - radius},
+	             max[3] = {point[0] + radius, INFINITY, point[2] + radius};
+	QueryResults query = {results, maxResults, 0, point, radius};
+	ForEachInBox(grid, min, max, AddResultInRadius, &query);
+	return query.nFound;
+}
+
+TrackShared *TrackGrid_FindNearest(
+	const TrackGrid *grid,
+	const Scalar    point[3],
+	Scalar          maxDistance,
+	Scalar          *distance,
+	Scalar          *pos)
+{
+	if (!grid->nPieces) {
+		return NULL;
+	}
+	TrackShared *nearest = NULL;
+	Scalar nearestDistance = maxDistance,
+	       nearestPos      = 0;
+	int cellX = GetCell(grid, point[0]),
+	    cellZ = GetCell(grid, point[2]);
+
+	// Rings nearer than the occupied cells are empty, so start at them
+	int distanceX = GetCellDistance(cellX, grid->min[0], grid->max[0]),
+	    distanceZ = GetCellDistance(cellZ, grid->min[1], grid->max[1]),
+	    start     = distanceX > distanceZ ? distanceX : distanceZ;
+	if ((start - 1) * grid->cellSize > maxDistance) {
+		return NULL;
+	}
+
+	// Search square rings of cells outwards. After ring k, every centre line
+	// point within k cell widths has been seen.
+	for (int k = start; ; ++k) {
+		int minX = cellX - k > grid->min[0] ? cellX - k : grid->min[0],
+		    maxX = cellX + k < grid->max[0] ? cellX + k : grid->max[0],
+		    minZ = cellZ - k > grid->min[1] ? cellZ - k : grid->min[1],
+		    maxZ = cellZ + k < grid->max[1] ? cellZ + k : grid->max[1];
+		for (int x = minX; x <= maxX; ++x) {
+			// Only the edges of the ring are new
+			bool edge = x == cellX - k || x == cellX + k;
+			int  step = edge ? 1 : 2*k;
+			for (int z = edge ? minZ : cellZ - k; z <= maxZ; z += step) {
+				if (z < minZ) {
+					continue;
+				}
+				const TrackGridBucket *bucket = GetBucket(grid, x, z);
+				for (unsigned i = 0; i < bucket->nEntries; ++i) {
+					const TrackGridEntry *entry = &bucket->entries[i];
+					if (entry->x != x || entry->z != z) {
+						continue;
+					}
+					Scalar entryPos;
+					Scalar entryDistance =
+						Track_GetDistance(entry->track, point, &entryPos);
+					if (entryDistance <= nearestDistance) {
+						nearest = entry->track;
+						nearestDistance = entryDistance;
+						nearestPos = entryPos;
+					}
+				}
+			}
+		}
+
+		bool coversGrid =    cellX - k <= grid->min[0]
+		                  && cellX + k >= grid->max[0]
+		                  && cellZ - k <= grid->min[1]
+		                  && cellZ + k >= grid->max[1];
+		if (coversGrid || k*grid->cellSize >= nearestDistance) {
+			break;
+		}
+	}
+
+	if (nearest) {
+		if (distance) {
+			*distance = nearestDistance;
+		}
+		if (pos) {
+			*pos = nearestPos;
+		}
+	}
+	return nearest;
+}
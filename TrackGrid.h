@@ -0,0 +1,87 @@
+#ifndef TRACK_GRID_H_INCLUDED
+#define TRACK_GRID_H_INCLUDED
+
+// Spatial hash grid over track pieces, for finding pieces near a point or in
+// an area without walking the whole network
+
+#include "Scalar.h"
+#include "Track.h"
+
+// Default width of square grid cells
+#define TRACK_GRID_CELL_SIZE 8
+
+// Registration of a piece in one cell it overlaps
+typedef struct {
+	TrackShared *track;
+	int         x, z; // Cell coordinates
+} TrackGridEntry;
+
+typedef struct {
+	TrackGridEntry *entries;
+	unsigned       nEntries,
+	               size;
+} TrackGridBucket;
+
+// Pieces are registered in every cell their bounding box overlaps, in the
+// x-z plane. Cells are hashed into buckets, so only occupied ones cost memory.
+typedef struct {
+	Scalar          cellSize;
+	TrackGridBucket *buckets;
+	unsigned        nBuckets, // Power of 2, grown with nEntries
+	                nEntries,
+	                nPieces;
+	int             min[2],   // Range of cells occupied since last clear
+	                max[2];
+} TrackGrid;
+
+// Grid over main track network
+extern TrackGrid g_trackGrid;
+
+// Initializes empty grid with given cell width
+void TrackGrid_Init(TrackGrid *grid, Scalar cellSize);
+
+// Frees memory held by grid, leaving it empty
+void TrackGrid_Free(TrackGrid *grid);
+
+// Empties grid, then inserts every piece of index, on the ring and off it
+void TrackGrid_Build(TrackGrid *grid, const NetworkIndex *index);
+
+// Adds piece to grid, by its current bounding box
+void TrackGrid_Insert(TrackGrid *grid, TrackShared *track);
+
+// Removes piece from grid, if it is there. Its bounding box must not have
+// changed since it was inserted.
+void TrackGrid_Remove(TrackGrid *grid, TrackShared *track);
+
+// Finds pieces whose bounding boxes intersect box min-max. Stores up to
+// maxResults of them in results, returns how many were found in total.
+unsigned TrackGrid_QueryBox(
+	const TrackGrid *grid,
+	const Scalar    min[3],
+	const Scalar    max[3],
+	TrackShared     *results[],
+	unsigned        maxResults
+);
+
+// Finds pieces whose centre lines come within radius of point, in the x-z
+// plane. Stores up to maxResults of them in results, returns how many were
+// found in total.
+unsigned TrackGrid_QueryRadius(
+	const TrackGrid *grid,
+	const Scalar    point[3],
+	Scalar          radius,
+	TrackShared     *results[],
+	unsigned        maxResults
+);
+
+// Finds piece whose centre line is nearest point in the x-z plane, or null if
+// there is none within maxDistance
+TrackShared *TrackGrid_FindNearest(
+	const TrackGrid *grid,
+	const Scalar    point[3],
+	Scalar          maxDistance,
+	Scalar          *distance, // Stores distance to piece, or null
+	Scalar          *pos       // Stores distance along piece, or null
+);
+
+#endif // TRACK_GRID_H_INCLUDED
@@ -0,0 +1,1002 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "TrackLayout.h"
+
+#define MAGIC "TOYTRACK"
+
+// Binary file header, followed by the pieces in index order, then locations
+typedef struct {
+	char     magic[8];
+	uint32_t version,
+	         byteOrder,       // 1 as written, to reject byte-swapped files
+	         scalarSize,      // Sizes of types, to reject other piece layouts
+	         straightSize,
+	         curvedSize,
+	         nPieces,
+	         nLocations;
+	uint64_t headOffset,      // Offset of first piece from start of file
+	         locationsOffset, // Offset of first LocationRecord
+	         size;            // Size of whole file
+} Header;
+
+// Location in binary file
+typedef struct {
+	char     name[TRACK_LOCATION_NAME_SIZE];
+	uint64_t pieceOffset; // Offset of piece from start of file
+} LocationRecord;
+
+static size_t AlignPiece(size_t size)
+{
+	return   (size + TRACK_PIECE_ALIGN - 1)
+	       / TRACK_PIECE_ALIGN * TRACK_PIECE_ALIGN;
+}
+
+// Gets bytes needed to hold all pieces of index, each aligned
+static size_t GetNetworkSize(const NetworkIndex *index)
+{
+	size_t size = 0;
+	for (unsigned i = 0; i < index->nPieces + index->nBranchPieces; ++i) {
+		size += AlignPiece(Track_GetSize(index->pieces[i]));
+	}
+	return size;
+}
+
+// Gets copy of track stored in copies by its index, or null for null
+static TrackShared *GetCopy(TrackShared **copies, TrackShared *track)
+{
+	return track ? copies[track->index] : NULL;
+}
+
+// Copies all pieces of index into buffer in index order, linked to each other
+// as the originals are, and stores pointers to the copies in copies
+static void CopyNetwork(
+	char               *buffer,
+	const NetworkIndex *index,
+	TrackShared        **copies)
+{
+	unsigned n = index->nPieces + index->nBranchPieces;
+	size_t offset = 0;
+	for (unsigned i = 0; i < n; ++i) {
+		TrackShared *track = index->pieces[i];
+		copies[i] = (TrackShared *)(buffer + offset);
+		memcpy(copies[i], track, Track_GetSize(track));
+		copies[i]->index = i;
+		offset += AlignPiece(Track_GetSize(track));
+	}
+	for (unsigned i = 0; i < n; ++i) {
+		TrackShared *track = index->pieces[i];
+		Track_SetNext(copies[i], GetCopy(copies, Track_GetNext(track)));
+		Track_SetPrevious(copies[i], GetCopy(copies, Track_GetPrevious(track)));
+		for (TrackEnd end = TrackEnd_start; end <= TrackEnd_end; ++end) {
+			Track_SetBranch(
+				copies[i],
+				end,
+				GetCopy(copies, Track_GetBranch(track, end))
+			);
+		}
+	}
+}
+
+bool TrackLayout_Load(TrackLayout *layout, const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		perror(path);
+		return false;
+	}
+	char magic[sizeof MAGIC - 1];
+	bool binary = fread(magic, sizeof magic, 1, file) == 1
+	              && !memcmp(magic, MAGIC, sizeof magic);
+	fclose(file);
+	return binary
+		? TrackLayout_LoadBinary(layout, path)
+		: TrackLayout_LoadText(layout, path);
+}
+
+// Gets whether curve directions are usable by AllocCurvedTrack()
+static bool IsValidCurve(const Scalar startDir[2], const Scalar endDir[2])
+{
+	Scalar cross = startDir[0]*endDir[1] - startDir[1]*endDir[0],
+	       dot   = startDir[0]*endDir[0] + startDir[1]*endDir[1],
+	       scale = hypotf(startDir[0], startDir[1])
+	               * hypotf(endDir[0], endDir[1]);
+	return cross != 0 && dot >= -1e-6*scale;
+}
+
+// Reference from a chain to a piece by name, resolved once all are named
+typedef struct {
+	char        name[TRACK_LOCATION_NAME_SIZE];
+	TrackShared *track;      // First piece of branch, or last piece of join
+	TrackEnd    end;         // End of named piece: end to branch, start to join
+	unsigned    lineNumber;
+} PendingLink;
+
+// First piece of a chain off the ring, to check it is linked to the ring
+typedef struct {
+	TrackShared *track;
+	unsigned    lineNumber; // Of branch or buffer directive
+} ChainStart;
+
+// Makes room for one more element of given size in array holding n
+static void *Grow(void *array, unsigned n, unsigned *capacity, size_t size)
+{
+	if (n == *capacity) {
+		*capacity = *capacity ? 2 * *capacity : 16;
+		array = realloc(array, *capacity * size);
+		assert(array);
+	}
+	return array;
+}
+
+// Reads name after keyword into name. Returns whether there is one that fits.
+static bool ReadName(
+	const char *line,
+	char       name[TRACK_LOCATION_NAME_SIZE],
+	const char *path,
+	unsigned   lineNumber)
+{
+	char word[256];
+	if (sscanf(line, " %*s %255s", word) != 1) {
+		fprintf(stderr, "%s:%u: expected a name\n", path, lineNumber);
+		return false;
+	}
+	if (strlen(word) >= TRACK_LOCATION_NAME_SIZE) {
+		fprintf(
+			stderr,
+			"%s:%u: name longer than %d characters\n",
+			path,
+			lineNumber,
+			TRACK_LOCATION_NAME_SIZE - 1
+		);
+		return false;
+	}
+	strcpy(name, word);
+	return true;
+}
+
+// Gets index of piece with given name among n, or -1 if none
+static int FindName(
+	const TrackLocation *names,
+	unsigned            n,
+	const char          *name)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		if (!strcmp(names[i].name, name)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Links chains to the pieces they name, by label or by name directive.
+// Returns whether all names are known and no end of a piece has two branches.
+static bool ResolveLinks(
+	const TrackLayout   *layout,
+	const TrackLocation *names,
+	unsigned            nNames,
+	const PendingLink   *links,
+	unsigned            nLinks,
+	const char          *path)
+{
+	for (unsigned i = 0; i < nLinks; ++i) {
+		const PendingLink *link = &links[i];
+		int location = TrackLayout_FindLocation(layout, link->name),
+		    name     = FindName(names, nNames, link->name);
+		if (location < 0 && name < 0) {
+			fprintf(
+				stderr,
+				"%s:%u: no piece named '%s'\n",
+				path,
+				link->lineNumber,
+				link->name
+			);
+			return false;
+		}
+		TrackShared *named = location >= 0 ? layout->locations[location].track
+		                                   : names[name].track;
+		if (Track_GetBranch(named, link->end)) {
+			fprintf(
+				stderr,
+				"%s:%u: '%s' already has a branch at its %s\n",
+				path,
+				link->lineNumber,
+				link->name,
+				link->end == TrackEnd_end ? "end" : "start"
+			);
+			return false;
+		}
+		Track_SetBranch(named, link->end, link->track);
+		if (link->end == TrackEnd_end) {
+			Track_SetPrevious(link->track, named);
+		} else {
+			Track_SetNext(link->track, named);
+		}
+	}
+	return true;
+}
+
+// Checks that every chain is reached from the ring, through branches and
+// joins, so it is indexed with the rest of the network
+static bool CheckChainsLinked(
+	const TrackLayout *layout,
+	const ChainStart  *chains,
+	unsigned          nChains,
+	const char        *path)
+{
+	if (!nChains) {
+		return true;
+	}
+	NetworkIndex index = {0};
+	NetworkIndex_Build(&index, layout->head);
+	bool ok = true;
+	for (unsigned i = 0; i < nChains && ok; ++i) {
+		if (!NetworkIndex_Contains(&index, chains[i].track)) {
+			fprintf(
+				stderr,
+				"%s:%u: chain is not linked to the ring\n",
+				path,
+				chains[i].lineNumber
+			);
+			ok = false;
+		}
+	}
+	NetworkIndex_Free(&index);
+	return ok;
+}
+
+bool TrackLayout_LoadText(TrackLayout *layout, const char *path)
+{
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		perror(path);
+		return false;
+	}
+
+	// Allocate pieces from new arena
+	TrackArena arena     = {0},
+	           *oldArena = g_trackArena;
+	g_trackArena = &arena;
+
+	TrackLayout loaded = {0};
+	PendingLink *links = NULL;
+	ChainStart  *chains = NULL;
+	unsigned    nLinks = 0,
+	            linkCapacity = 0,
+	            nChains = 0,
+	            chainCapacity = 0,
+	            locationCapacity = 0;
+	TrackLocation *names = NULL; // Pieces named for links, not locations
+	unsigned      nNames = 0,
+	              nameCapacity = 0;
+	TrackShared *head = NULL,
+	            *tail = NULL;   // Last piece of current chain
+	bool        inRing = true,
+	            joined = false; // Current chain has ended
+	int         branch = -1;    // Link awaiting first piece of chain, if any
+	char line[256];
+	unsigned lineNumber = 0;
+	bool ok = true;
+	while (ok && fgets(line, sizeof line, file)) {
+		++lineNumber;
+		char keyword[16];
+		float v[8];
+		int n;
+		if (sscanf(line, " %15s", keyword) != 1 || keyword[0] == '#') {
+			continue;
+		}
+
+		// Directives
+		bool startsChain = !strcmp(keyword, "branch")
+		                   || !strcmp(keyword, "buffer");
+		if (startsChain || !strcmp(keyword, "join")) {
+			if (inRing && !head) {
+				fprintf(stderr, "%s:%u: ring has no pieces\n", path, lineNumber);
+				ok = false;
+				break;
+			}
+			if (!inRing && !tail && !joined) {
+				fprintf(stderr, "%s:%u: chain has no pieces\n", path, lineNumber);
+				ok = false;
+				break;
+			}
+		}
+		if (startsChain) {
+			if (inRing) {
+				// Close ring
+				Track_SetNext(tail, head);
+				Track_SetPrevious(head, tail);
+				inRing = false;
+			}
+			tail = NULL;
+			joined = false;
+			branch = -1;
+			chains = Grow(chains, nChains, &chainCapacity, sizeof *chains);
+			chains[nChains++] = (ChainStart){NULL, lineNumber};
+			if (!strcmp(keyword, "branch")) {
+				links = Grow(links, nLinks, &linkCapacity, sizeof *links);
+				PendingLink *link = &links[nLinks];
+				link->end = TrackEnd_end;
+				link->lineNumber = lineNumber;
+				ok = ReadName(line, link->name, path, lineNumber);
+				branch = nLinks++;
+			}
+			continue;
+		}
+		if (!strcmp(keyword, "join")) {
+			if (inRing || joined) {
+				fprintf(
+					stderr,
+					"%s:%u: join must end a chain off the ring\n",
+					path,
+					lineNumber
+				);
+				ok = false;
+				break;
+			}
+			links = Grow(links, nLinks, &linkCapacity, sizeof *links);
+			PendingLink *link = &links[nLinks++];
+			link->track = tail;
+			link->end = TrackEnd_start;
+			link->lineNumber = lineNumber;
+			ok = ReadName(line, link->name, path, lineNumber);
+			joined = true;
+			continue;
+		}
+		bool isLabel = !strcmp(keyword, "label");
+		if (isLabel || !strcmp(keyword, "name")) {
+			if (!tail) {
+				fprintf(
+					stderr,
+					"%s:%u: %s must follow a piece\n",
+					path,
+					lineNumber,
+					keyword
+				);
+				ok = false;
+				break;
+			}
+			char name[TRACK_LOCATION_NAME_SIZE];
+			if (!(ok = ReadName(line, name, path, lineNumber))) {
+				break;
+			}
+			if (   TrackLayout_FindLocation(&loaded, name) >= 0
+			    || FindName(names, nNames, name) >= 0)
+			{
+				fprintf(
+					stderr,
+					"%s:%u: name '%s' used twice\n",
+					path,
+					lineNumber,
+					name
+				);
+				ok = false;
+				break;
+			}
+			TrackLocation *location;
+			if (isLabel) {
+				loaded.locations = Grow(
+					loaded.locations,
+					loaded.nLocations,
+					&locationCapacity,
+					sizeof *loaded.locations
+				);
+				location = &loaded.locations[loaded.nLocations++];
+			} else {
+				names = Grow(names, nNames, &nameCapacity, sizeof *names);
+				location = &names[nNames++];
+			}
+			strcpy(location->name, name);
+			location->track = tail;
+			continue;
+		}
+
+		// Pieces
+		if (joined) {
+			fprintf(
+				stderr,
+				"%s:%u: pieces after join must start a new chain\n",
+				path,
+				lineNumber
+			);
+			ok = false;
+			break;
+		}
+		TrackShared *track;
+		if (!strcmp(keyword, "straight")) {
+			n = sscanf(line, " %*s %f %f %f %f", &v[0], &v[1], &v[2], &v[3]);
+			if (n != 4) {
+				fprintf(stderr, "%s:%u: expected 4 numbers\n", path, lineNumber);
+				ok = false;
+				break;
+			}
+			const Scalar start[2] = {v[0], v[1]},
+			             end[2]   = {v[2], v[3]};
+			track = (TrackShared *)AllocStraightTrack(start, end, NULL, tail);
+		} else if (!strcmp(keyword, "curved")) {
+			n = sscanf(
+				line,
+				" %*s %f %f %f %f %f %f %f %f",
+				&v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]
+			);
+			if (n != 8) {
+				fprintf(stderr, "%s:%u: expected 8 numbers\n", path, lineNumber);
+				ok = false;
+				break;
+			}
+			const Scalar start[2]    = {v[0], v[1]},
+			             startDir[2] = {v[2], v[3]},
+			             end[2]      = {v[4], v[5]},
+			             endDir[2]   = {v[6], v[7]};
+			if (!IsValidCurve(startDir, endDir)) {
+				fprintf(
+					stderr,
+					"%s:%u: curve must turn by more than 0 and at most 90 "
+					"degrees\n",
+					path,
+					lineNumber
+				);
+				ok = false;
+				break;
+			}
+			track = (TrackShared *)
+				AllocCurvedTrack(start, startDir, end, endDir, NULL, tail);
+		} else {
+			fprintf(
+				stderr,
+				"%s:%u: unknown piece type '%s'\n",
+				path,
+				lineNumber,
+				keyword
+			);
+			ok = false;
+			break;
+		}
+
+		if (tail) {
+			Track_SetNext(tail, track);
+		} else if (inRing) {
+			head = track;
+		} else {
+			chains[nChains - 1].track = track;
+			if (branch >= 0) {
+				links[branch].track = track;
+			}
+		}
+		tail = track;
+	}
+	if (ok && ferror(file)) {
+		perror(path);
+		ok = false;
+	}
+	fclose(file);
+	g_trackArena = oldArena;
+	if (ok && !head) {
+		fprintf(stderr, "%s: no track pieces\n", path);
+		ok = false;
+	} else if (ok && !inRing && !tail && !joined) {
+		fprintf(stderr, "%s:%u: chain has no pieces\n", path, lineNumber);
+		ok = false;
+	}
+	if (ok && inRing) {
+		// Close ring
+		Track_SetNext(tail, head);
+		Track_SetPrevious(head, tail);
+	}
+
+	loaded.head = head;
+	loaded.arena = arena;
+	ok = ok && ResolveLinks(&loaded, names, nNames, links, nLinks, path)
+	     && CheckChainsLinked(&loaded, chains, nChains, path);
+	free(links);
+	free(chains);
+	free(names);
+	if (!ok) {
+		TrackLayout_Free(&loaded);
+		return false;
+	}
+	*layout = loaded;
+	return true;
+}
+
+// Gets whether offset into file is the start of a piece, marked in starts
+static bool IsPieceStart(
+	const Header *header,
+	const bool   *starts,
+	uint64_t     offset)
+{
+	return    offset >= header->headOffset
+	       && offset < header->locationsOffset
+	       && (offset - header->headOffset) % TRACK_PIECE_ALIGN == 0
+	       && starts[(offset - header->headOffset) / TRACK_PIECE_ALIGN];
+}
+
+// Gets whether link from piece is null or to the start of a piece in mapping
+static bool IsValidLink(
+	const char        *mapping,
+	const Header      *header,
+	const bool        *starts,
+	const TrackShared *target)
+{
+	uint64_t offset = (intptr_t)target - (intptr_t)mapping;
+	return !target || IsPieceStart(header, starts, offset);
+}
+
+// Gets whether sample table of curved piece is one Track.c could have built:
+// none, or at least two samples spaced evenly and finitely over the arc
+static bool IsValidSampleTable(const CurvedTrack *curved)
+{
+	if (!curved->nSamples) {
+		return true;
+	}
+	Scalar step   = curved->sampleStep,
+	       length = curved->dims.arcLength;
+	if (   curved->nSamples < 2
+	    || !isfinite(step) || step <= 0
+	    || !isfinite(length) || length <= 0
+	    || fabs((double)length / step - (curved->nSamples - 1)) > 0.5)
+	{
+		return false;
+	}
+	for (unsigned i = 0; i < 4*curved->nSamples; ++i) {
+		if (!isfinite(curved->samples[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Checks that the pieces of mapped file are of known types with sample tables
+// matching their arcs, fill the space before the locations exactly, and link
+// only to each other, with the ring from the head closed. Marks in starts each
+// slot of TRACK_PIECE_ALIGN bytes after the head that starts a piece.
+static bool CheckPieces(char *mapping, const Header *header, bool *starts)
+{
+	// Find pieces one after another
+	uint64_t offset = header->headOffset,
+	         end    = header->locationsOffset;
+	unsigned n = 0;
+	while (offset < end && n < header->nPieces) {
+		const TrackShared *track = (const TrackShared *)(mapping + offset);
+		uint64_t room = end - offset;
+		if (room < sizeof (StraightTrack)) {
+			return false;
+		}
+		if (track->type == Type_curved) {
+			const CurvedTrack *curved = (const CurvedTrack *)track;
+			if (   room < sizeof *curved
+			    ||   (room - sizeof *curved) / (4 * sizeof *curved->samples)
+			       < curved->nSamples
+			    || !IsValidSampleTable(curved))
+			{
+				return false;
+			}
+		} else if (track->type != Type_straight) {
+			return false;
+		}
+		starts[(offset - header->headOffset) / TRACK_PIECE_ALIGN] = true;
+		offset += AlignPiece(Track_GetSize(track));
+		++n;
+	}
+	if (offset != end || n != header->nPieces) {
+		return false;
+	}
+
+	// Check links of each piece
+	for (offset = header->headOffset; offset < end;) {
+		TrackShared *track = (TrackShared *)(mapping + offset);
+		if (   !IsValidLink(mapping, header, starts, Track_GetNext(track))
+		    || !IsValidLink(mapping, header, starts, Track_GetPrevious(track))
+		    || !IsValidLink(
+		            mapping,
+		            header,
+		            starts,
+		            Track_GetBranch(track, TrackEnd_start)
+		        )
+		    || !IsValidLink(
+		            mapping,
+		            header,
+		            starts,
+		            Track_GetBranch(track, TrackEnd_end)
+		        ))
+		{
+			return false;
+		}
+		offset += AlignPiece(Track_GetSize(track));
+	}
+
+	// Ring must lead back to the head, or indexing it would never end
+	TrackShared *head = (TrackShared *)(mapping + header->headOffset),
+	            *track = head;
+	n = 0;
+	do {
+		track = Track_GetNext(track);
+	} while (track && track != head && ++n < header->nPieces);
+	return track == head;
+}
+
+bool TrackLayout_LoadBinary(TrackLayout *layout, const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st)) {
+		perror(path);
+		close(fd);
+		return false;
+	}
+	if ((size_t)st.st_size < sizeof (Header)) {
+		fprintf(stderr, "%s: truncated track file\n", path);
+		close(fd);
+		return false;
+	}
+
+	// Private mapping, so pieces can be written without changing the file
+	size_t size = st.st_size;
+	void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		perror(path);
+		return false;
+	}
+
+	const Header *header = mapping;
+	const char *error = NULL;
+	if (memcmp(header->magic, MAGIC, sizeof header->magic)) {
+		error = "not a binary track file";
+	} else if (header->version != TRACK_LAYOUT_VERSION) {
+		error = "unsupported track file version";
+	} else if (   header->byteOrder != 1
+	           || header->scalarSize != sizeof (Scalar)
+	           || header->straightSize != sizeof (StraightTrack)
+	           || header->curvedSize != sizeof (CurvedTrack))
+	{
+		error = "track file written by an incompatible build";
+	} else if (   header->size != size
+	           || !header->nPieces
+	           || header->headOffset + sizeof (StraightTrack) > size
+	           || header->locationsOffset > size
+	           ||   (size - header->locationsOffset) / sizeof (LocationRecord)
+	              < header->nLocations)
+	{
+		error = "truncated track file";
+	} else if (   header->headOffset % TRACK_PIECE_ALIGN
+	           ||   header->locationsOffset
+	              < header->headOffset + sizeof (StraightTrack))
+	{
+		error = "corrupt track file";
+	}
+
+	// Locations are copied out, so names are terminated. Pieces are only
+	// checked to lie in the file, so loading doesn't read every piece.
+	TrackLocation *locations = NULL;
+	unsigned nLocations = error ? 0 : header->nLocations;
+	if (nLocations) {
+		locations = malloc(nLocations * sizeof *locations);
+		assert(locations);
+	}
+	const LocationRecord *records = (const LocationRecord *)
+		((char *)mapping + header->locationsOffset);
+	for (unsigned i = 0; i < nLocations && !error; ++i) {
+		uint64_t offset = records[i].pieceOffset;
+		if (   offset < header->headOffset
+		    || offset > header->locationsOffset - sizeof (StraightTrack)
+		    || (offset - header->headOffset) % TRACK_PIECE_ALIGN
+		    || !memchr(records[i].name, 0, sizeof records[i].name))
+		{
+			error = "corrupt location in track file";
+			break;
+		}
+		strcpy(locations[i].name, records[i].name);
+		locations[i].track = (TrackShared *)((char *)mapping + offset);
+	}
+	if (error) {
+		fprintf(stderr, "%s: %s\n", path, error);
+		free(locations);
+		munmap(mapping, size);
+		return false;
+	}
+
+	*layout = (TrackLayout){
+		.head        = (TrackShared *)((char *)mapping + header->headOffset),
+		.locations   = locations,
+		.nLocations  = nLocations,
+		.mapping     = mapping,
+		.mappingSize = size
+	};
+	return true;
+}
+
+bool TrackLayout_Verify(const TrackLayout *layout, const char *path)
+{
+	if (!layout->mapping) {
+		return true;
+	}
+	char         *mapping = layout->mapping;
+	const Header *header  = layout->mapping;
+	size_t nSlots =
+		(header->locationsOffset - header->headOffset) / TRACK_PIECE_ALIGN;
+	bool *starts = calloc(nSlots, sizeof *starts);
+	assert(starts);
+	const char *error = NULL;
+	if (!CheckPieces(mapping, header, starts)) {
+		error = "corrupt piece in track file";
+	}
+	for (unsigned i = 0; i < layout->nLocations && !error; ++i) {
+		uint64_t offset = (char *)layout->locations[i].track - mapping;
+		if (!IsPieceStart(header, starts, offset)) {
+			error = "corrupt location in track file";
+		}
+	}
+	free(starts);
+	if (error) {
+		fprintf(stderr, "%s: %s\n", path, error);
+		return false;
+	}
+	return true;
+}
+
+// Writes a piece as a line of text
+static void WritePiece(FILE *file, const TrackShared *track)
+{
+	const StraightTrack *straight = (const StraightTrack *)track;
+	const CurvedTrack   *curved   = (const CurvedTrack *)track;
+	switch (track->type) {
+	case Type_straight:
+		fprintf(
+			file,
+			"straight %.9g %.9g %.9g %.9g\n",
+			straight->start[0], straight->start[1],
+			straight->end[0], straight->end[1]
+		);
+		break;
+	case Type_curved:
+		fprintf(
+			file,
+			"curved %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g\n",
+			curved->start[0], curved->start[1],
+			curved->startDir[0], curved->startDir[1],
+			curved->end[0], curved->end[1],
+			curved->endDir[0], curved->endDir[1]
+		);
+		break;
+	default:
+		abort();
+	}
+}
+
+// Gets whether next continues the same chain off the ring as track
+static bool IsChainLink(
+	const NetworkIndex *index,
+	TrackShared        *track,
+	TrackShared        *next)
+{
+	return    next
+	       && next->index >= index->nPieces
+	       && Track_GetNext(track) == next
+	       && Track_GetPrevious(next) == track;
+}
+
+bool TrackLayout_SaveText(const TrackLayout *layout, const char *path)
+{
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		perror(path);
+		return false;
+	}
+	NetworkIndex index = {0};
+	NetworkIndex_Build(&index, layout->head);
+	unsigned n = index.nPieces + index.nBranchPieces;
+
+	// Name labelled pieces, and make up names for other junctions, written
+	// with name rather than label so they don't load as locations
+	char (*names)[TRACK_LOCATION_NAME_SIZE] = calloc(n, sizeof *names);
+	bool *labelled = calloc(n, sizeof *labelled),
+	     *written  = calloc(n, sizeof *written);
+	assert(names && labelled && written);
+	for (unsigned i = 0; i < layout->nLocations; ++i) {
+		const TrackLocation *location = &layout->locations[i];
+		if (NetworkIndex_Contains(&index, location->track)) {
+			strcpy(names[location->track->index], location->name);
+			labelled[location->track->index] = true;
+		}
+	}
+	for (unsigned i = 0; i < n; ++i) {
+		TrackShared *track = index.pieces[i];
+		if (   !labelled[i]
+		    && (   Track_GetBranch(track, TrackEnd_start)
+		        || Track_GetBranch(track, TrackEnd_end)))
+		{
+			// Avoid labels that happen to look made up
+			sprintf(names[i], "junction%u", i);
+			for (unsigned j = 1;
+			     TrackLayout_FindLocation(layout, names[i]) >= 0;
+			     ++j)
+			{
+				sprintf(names[i], "junction%u_%u", i, j);
+			}
+		}
+	}
+
+	// Ring, then each chain off it from its first piece
+	for (unsigned i = 0; i < n; ++i) {
+		if (written[i]) {
+			continue;
+		}
+		TrackShared *track = index.pieces[i],
+		            *prev;
+		if (i >= index.nPieces) {
+			while (   (prev = Track_GetPrevious(track))
+			       && !written[prev->index]
+			       && IsChainLink(&index, prev, track))
+			{
+				track = prev;
+			}
+			if (prev && Track_GetBranch(prev, TrackEnd_end) == track) {
+				fprintf(file, "branch %s\n", names[prev->index]);
+			} else {
+				fprintf(file, "buffer\n");
+			}
+		}
+
+		TrackShared *next;
+		for (;;) {
+			WritePiece(file, track);
+			if (names[track->index][0]) {
+				fprintf(
+					file,
+					"%s %s\n",
+					labelled[track->index] ? "label" : "name",
+					names[track->index]
+				);
+			}
+			written[track->index] = true;
+			next = Track_GetNext(track);
+			bool onRing = track->index < index.nPieces;
+			if (onRing ? next == layout->head
+			           : !IsChainLink(&index, track, next)
+			             || written[next->index])
+			{
+				break;
+			}
+			track = next;
+		}
+		if (i >= index.nPieces && next) {
+			fprintf(file, "join %s\n", names[next->index]);
+		}
+	}
+	free(names);
+	free(labelled);
+	free(written);
+	NetworkIndex_Free(&index);
+
+	bool ok = !ferror(file);
+	ok = !fclose(file) && ok;
+	if (!ok) {
+		perror(path);
+	}
+	return ok;
+}
+
+bool TrackLayout_SaveBinary(const TrackLayout *layout, const char *path)
+{
+	NetworkIndex index = {0};
+	NetworkIndex_Build(&index, layout->head);
+	unsigned nPieces = index.nPieces + index.nBranchPieces;
+
+	// Locations of pieces not reached from the ring can't be written
+	unsigned nLocations = 0;
+	for (unsigned i = 0; i < layout->nLocations; ++i) {
+		nLocations += NetworkIndex_Contains(&index, layout->locations[i].track);
+	}
+
+	// Size file
+	Header header = {
+		.magic        = MAGIC,
+		.version      = TRACK_LAYOUT_VERSION,
+		.byteOrder    = 1,
+		.scalarSize   = sizeof (Scalar),
+		.straightSize = sizeof (StraightTrack),
+		.curvedSize   = sizeof (CurvedTrack),
+		.nPieces      = nPieces,
+		.nLocations   = nLocations,
+		.headOffset   = AlignPiece(sizeof header)
+	};
+	header.locationsOffset = header.headOffset + GetNetworkSize(&index);
+	size_t size =   header.locationsOffset
+	              + nLocations * sizeof (LocationRecord);
+	header.size = size;
+
+	// Copy pieces, relinking them within the file
+	char *buffer = calloc(size, 1);
+	TrackShared **copies = malloc(nPieces * sizeof *copies);
+	assert(buffer && copies);
+	memcpy(buffer, &header, sizeof header);
+	CopyNetwork(buffer + header.headOffset, &index, copies);
+	LocationRecord *record = (LocationRecord *)
+		(buffer + header.locationsOffset);
+	for (unsigned i = 0; i < layout->nLocations; ++i) {
+		const TrackLocation *location = &layout->locations[i];
+		if (!NetworkIndex_Contains(&index, location->track)) {
+			continue;
+		}
+		strcpy(record->name, location->name);
+		record->pieceOffset = (char *)copies[location->track->index] - buffer;
+		++record;
+	}
+	free(copies);
+	NetworkIndex_Free(&index);
+
+	FILE *file = fopen(path, "wb");
+	bool ok = file && fwrite(buffer, size, 1, file) == 1;
+	if (file) {
+		ok = !fclose(file) && ok;
+	}
+	if (!ok) {
+		perror(path);
+	}
+	free(buffer);
+	return ok;
+}
+
+void TrackLayout_Compact(TrackLayout *layout)
+{
+	NetworkIndex index = {0};
+	NetworkIndex_Build(&index, layout->head);
+	unsigned nPieces = index.nPieces + index.nBranchPieces;
+	TrackArena arena = {0};
+	char *buffer = TrackArena_Alloc(&arena, GetNetworkSize(&index));
+	TrackShared **copies = malloc(nPieces * sizeof *copies);
+	assert(copies);
+	CopyNetwork(buffer, &index, copies);
+
+	// Keep locations of copied pieces, pointing at the copies
+	TrackLocation *locations = layout->locations;
+	unsigned nLocations = 0;
+	for (unsigned i = 0; i < layout->nLocations; ++i) {
+		TrackShared *track = locations[i].track;
+		if (NetworkIndex_Contains(&index, track)) {
+			locations[nLocations] = locations[i];
+			locations[nLocations++].track = copies[track->index];
+		}
+	}
+	free(copies);
+	NetworkIndex_Free(&index);
+
+	layout->locations = NULL;
+	TrackLayout_Free(layout);
+	*layout = (TrackLayout){
+		.head       = (TrackShared *)buffer,
+		.locations  = locations,
+		.nLocations = nLocations,
+		.arena      = arena
+	};
+}
+
+int TrackLayout_FindLocation(const TrackLayout *layout, const char *name)
+{
+	return FindName(layout->locations, layout->nLocations, name);
+}
+
+void TrackLayout_Free(TrackLayout *layout)
+{
+	if (layout->mapping) {
+		munmap(layout->mapping, layout->mappingSize);
+	}
+	TrackArena_Free(&layout->arena);
+	free(layout->locations);
+	*layout = (TrackLayout){0};
+}
@@ -0,0 +1,88 @@
+#ifndef TRACK_LAYOUT_H_INCLUDED
+#define TRACK_LAYOUT_H_INCLUDED
+
+// Loading and saving networks of track pieces: a ring, and chains of pieces
+// branching off it.
+//
+// The text format is for authoring. Each line holds one piece or directive.
+// Pieces are added to the current chain, which is the ring at first:
+//   straight <start x> <start z> <end x> <end z>
+//   curved <start x> <start z> <start dir x> <start dir z>
+//          <end x> <end z> <end dir x> <end dir z>
+// Directives name pieces, and start and end chains off the ring:
+//   label <name>  Names the last piece, as a location to route trains to
+//   name <name>   Names the last piece only for branch and join to refer to
+//   branch <name> Starts a chain leaving the end of the named piece
+//   buffer        Starts a chain with a dead end at its start
+//   join <name>   Ends the chain by joining the start of the named piece
+// A chain that ends without joining has a dead end. Pieces may be named after
+// chains refer to them. Blank lines and lines starting with # are ignored.
+//
+// The binary format holds pieces exactly as in memory, with their dims and
+// sample tables precomputed, and is used in place by mapping the file. It is
+// only readable by builds with the same version and piece layout. Loading
+// checks only the header and locations, so startup doesn't grow with the
+// file; TrackLayout_Verify() checks the pieces of files from elsewhere.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "Track.h"
+
+// Binary file version, bumped whenever the piece structs change
+#define TRACK_LAYOUT_VERSION 2
+
+// Longest location name, including terminator
+#define TRACK_LOCATION_NAME_SIZE 32
+
+// Named piece of track
+typedef struct {
+	char        name[TRACK_LOCATION_NAME_SIZE];
+	TrackShared *track;
+} TrackLocation;
+
+// Network of track, and the memory holding its pieces
+typedef struct {
+	TrackShared   *head;        // First piece of ring
+	TrackLocation *locations;
+	unsigned      nLocations;
+	void          *mapping;     // Mapped binary file, or null
+	size_t        mappingSize;
+	TrackArena    arena;        // Allocated pieces
+} TrackLayout;
+
+// Loads layout from a text or binary file, detected by its contents. Returns
+// whether successful, otherwise prints an error to stderr.
+bool TrackLayout_Load(TrackLayout *layout, const char *path);
+
+// Loads layout from a text file, allocating pieces from its arena in order
+bool TrackLayout_LoadText(TrackLayout *layout, const char *path);
+
+// Maps layout from a binary file, without reading or allocating pieces
+bool TrackLayout_LoadBinary(TrackLayout *layout, const char *path);
+
+// Checks that every piece of a layout mapped from a binary file is of a known
+// type with a sample table matching its arc, that pieces and locations refer
+// only to pieces of the file, and that the ring is closed. Returns whether
+// so, otherwise prints an error to stderr. Layouts from text always pass.
+bool TrackLayout_Verify(const TrackLayout *layout, const char *path);
+
+// Saves the network of track as text
+bool TrackLayout_SaveText(const TrackLayout *layout, const char *path);
+
+// Saves the network of track as binary
+bool TrackLayout_SaveBinary(const TrackLayout *layout, const char *path);
+
+// Copies pieces into one block of a new arena in ring order, followed by the
+// pieces off the ring, so walks of the ring read memory sequentially, then
+// frees the old arena and mapping. Pointers to old pieces, including those in
+// indexes, are invalidated.
+void TrackLayout_Compact(TrackLayout *layout);
+
+// Gets index of location with given name, or -1 if none
+int TrackLayout_FindLocation(const TrackLayout *layout, const char *name);
+
+// Frees arena, locations and mapping of layout. Pieces allocated with malloc()
+// must be freed separately.
+void TrackLayout_Free(TrackLayout *layout);
+
+#endif // TRACK_LAYOUT_H_INCLUDED
@@ -1,252 +1,378 @@
+#include <stdlib.h>
+#include <math.h>
 #include <assert.h>
-#include <GL/gl.h>
-#include "DrawUtil.h"
 #include "Track.h"
-#include "Algebra.h"
 
 #include "Train.h"
 
-static GLuint trainDl,
-              carriageDl;
+// Distance between centres of consecutive vehicles
+#define CARRIAGE_SPACING 2.3
 
-unsigned g_nCarriages = 5;
+// Length of each vehicle, buffer to buffer
+#define VEHICLE_LENGTH 2
 
-GLfloat g_trainSpeed = 0.01;
+// Controls of trains added by TrainSet_Populate()
+#define DEFAULT_SPEED 0.6
+#define DEFAULT_CARRIAGES 5
 
-NetworkPos g_trainPos = {(TrackShared *)&g_initialTrackPiece, 1.5};
+// Distance of first train from start of ring
+#define FIRST_DISTANCE 1.5
 
-static GLfloat whiteColor[4] = {1, 1, 1, 1},
-               grayColor[4]  = {0.5, 0.5, 0.5, 1},
-               redColor[4]   = {1, 0.1, 0.1, 1},
-               darkColor[4]  = {0.2, 0.18, 0.14, 1},
-               metalColor[4] = {0.7, 0.7, 0.75, 1},
-               blackColor[4] = {0, 0, 0, 1};
+// Distance beyond a frame's travel to set switches ahead of trains, so they
+// are set before trains come in sight of them
+#define ROUTE_MARGIN 20
 
-static void DrawWheel(void)
+TrainSet g_trainSet;
+
+void TrainSet_Init(TrainSet *set, unsigned nThreads)
 {
-	glMaterialfv(GL_FRONT, GL_AMBIENT, metalColor);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, metalColor);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, whiteColor);
-	glMaterialf(GL_FRONT, GL_SHININESS, 50);
-	glPushMatrix();
-		glRotatef(-90, 1, 0, 0);
-		glScalef(0.3, 0.02, 0.3);
-		DrawHollowCylinder(24);
-		glTranslatef(0, 1, 0);
-		DrawDisc(24);
-	glPopMatrix();
-	glPushMatrix();
-		glRotatef(90, 1, 0, 0);
-		glPushMatrix();
-			glScalef(0.3, 1, 0.3);
-			glRotatef(180, 0, 1, 0);
-			DrawDisc(24);
-		glPopMatrix();
-		glScalef(0.25, 0.03, 0.25);
-		DrawHollowCylinder(16);
-		glTranslatef(0, 1, 0);
-		DrawDisc(16);
-	glPopMatrix();
+	*set = (TrainSet){.separation.headway = DEFAULT_HEADWAY};
+	ThreadPool_Init(&set->pool, nThreads);
 }
 
-static void DrawSpoke(void)
+void TrainSet_Free(TrainSet *set)
 {
-	glMaterialfv(GL_FRONT, GL_AMBIENT, metalColor);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, metalColor);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, whiteColor);
-	glMaterialf(GL_FRONT, GL_SHININESS, 50);
-	glPushMatrix();
-		glRotatef(90, 1, 0, 0);
-		glScalef(0.05, 1-0.08, 0.05);
-		glTranslatef(0, -0.5, 0);
-		DrawHollowCylinder(12);
-	glPopMatrix();
+	TrainSet_Wait(set);
+	ThreadPool_Free(&set->pool);
+	free(set->trains);
+	free(set->states[0]);
+	free(set->states[1]);
+	free(set->tickSpeeds);
+	free(set->drawPos);
+	free(set->poses.x);
+	free(set->poses.z);
+	free(set->poses.sine);
+	free(set->poses.cosine);
+	free(set->offsets);
+	TrackPoseScratch_Free(&set->poseScratch);
+	free(set->separation.events);
+	free(set->separation.order);
+	free(set->separation.states);
+	free(set->separation.aheads);
+	*set = (TrainSet){.nTrains = 0};
 }
 
-void InitTrain(void)
+unsigned TrainSet_Add(
+	TrainSet *set,
+	double   distance,
+	Scalar   speed,
+	unsigned nCarriages)
 {
-	// Compile train model
-	trainDl = glGenLists(1);
-	assert(trainDl);
-	glNewList(trainDl, GL_COMPILE);
-		// Draw locomotive carriage
-		glMaterialfv(GL_FRONT, GL_AMBIENT, redColor);
-		glMaterialfv(GL_FRONT, GL_DIFFUSE, redColor);
-		glMaterialfv(GL_FRONT, GL_SPECULAR, grayColor);
-		glMaterialf(GL_FRONT, GL_SHININESS, 50);
-		glPushMatrix();
-			glTranslatef(-1, 0.45, 0);
-			glScalef(0.5, 1, 1);
-			glTranslatef(0, 0, -0.5);
-			DrawCube();
-		glPopMatrix();
-
-		// Draw locomotive tank
-		glPushMatrix();
-			glTranslatef(-0.5, 0.45 + 1./3, 0);
-			glRotatef(-90, 0, 0, 1);
-			glScalef(2./3, 1.5, 2./3);
-			DrawHollowCylinder(32);
-			glTranslatef(0, 1, 0);
-			DrawDisc(32);
-		glPopMatrix();
-
-		// Draw tank chimney
-		glPushMatrix();
-			glTranslatef(0.5, 0.45 + 1./3, 0);
-			glScalef(0.3, 0.7, 0.3);
-			DrawHollowCylinder(32);
-			glTranslatef(0, 1, 0);
-			DrawDisc(32);
-		glPopMatrix();
-
-		// Draw undercarriage
-		glMaterialfv(GL_FRONT, GL_AMBIENT, darkColor);
-		glMaterialfv(GL_FRONT, GL_DIFFUSE, darkColor);
-		glMaterialfv(GL_FRONT, GL_SPECULAR, blackColor);
-		glMaterialf(GL_FRONT, GL_SHININESS, 0);
-		glPushMatrix();
-			glTranslatef(-1, 0.15, 0);
-			glScalef(2, 0.3, 0.7);
-			glTranslatef(0, 0, -0.5);
-			DrawCube();
-		glPopMatrix();
-
-		// Draw spokes
-		glPushMatrix();
-			glTranslatef(-0.5, 0.225, 0);
-			DrawSpoke();
-			glTranslatef(1, 0, 0);
-			DrawSpoke();
-		glPopMatrix();
-
-		// Draw wheels
-		glPushMatrix();
-			glTranslatef(-0.5, 0.225, 0.48);
-			DrawWheel();
-			glPushMatrix();
-				glTranslatef(0, 0, -0.96);
-				glRotatef(180, 0, 1, 0);
-				DrawWheel();
-				glTranslatef(-1, 0, 0);
-				DrawWheel();
-			glPopMatrix();
-			glTranslatef(1, 0, 0);
-			DrawWheel();
-		glPopMatrix();
-	glEndList();
-
-	// Compile carriage model
-	carriageDl = glGenLists(1);
-	assert(carriageDl);
-	glNewList(carriageDl, GL_COMPILE);
-		// Draw top carriage
-		glMaterialfv(GL_FRONT, GL_AMBIENT, redColor);
-		glMaterialfv(GL_FRONT, GL_DIFFUSE, redColor);
-		glMaterialfv(GL_FRONT, GL_SPECULAR, grayColor);
-		glMaterialf(GL_FRONT, GL_SHININESS, 50);
-		glPushMatrix();
-			glTranslatef(-1, 0.45, 0);
-			glScalef(2, 1, 1);
-			glTranslatef(0, 0, -0.5);
-			DrawCube();
-		glPopMatrix();
-
-		// Draw undercarriage
-		glMaterialfv(GL_FRONT, GL_AMBIENT, darkColor);
-		glMaterialfv(GL_FRONT, GL_DIFFUSE, darkColor);
-		glMaterialfv(GL_FRONT, GL_SPECULAR, blackColor);
-		glMaterialf(GL_FRONT, GL_SHININESS, 0);
-		glPushMatrix();
-			glTranslatef(-1, 0.15, 0);
-			glScalef(2, 0.3, 0.7);
-			glTranslatef(0, 0, -0.5);
-			DrawCube();
-		glPopMatrix();
-
-		// Draw hook
-		glPushMatrix();
-			glTranslatef(0.5, 0.45, 0);
-			glScalef(1, 1, 1);
-			glBegin(GL_TRIANGLES);
-				glNormal3f(0, 1, 0);
-				glVertex3f(0, 0, -0.25);
-				glVertex3f(0, 0, 0.25);
-				glVertex3f(1, 0, 0);
-			glEnd();
-		glPopMatrix();
-
-		// Draw spokes
-		glPushMatrix();
-			glTranslatef(-0.5, 0.225, 0);
-			DrawSpoke();
-			glTranslatef(1, 0, 0);
-			DrawSpoke();
-		glPopMatrix();
-
-		// Draw wheels
-		glPushMatrix();
-			glTranslatef(-0.5, 0.225, 0.48);
-			DrawWheel();
-			glPushMatrix();
-				glTranslatef(0, 0, -0.96);
-				glRotatef(180, 0, 1, 0);
-				DrawWheel();
-				glTranslatef(-1, 0, 0);
-				DrawWheel();
-			glPopMatrix();
-			glTranslatef(1, 0, 0);
-			DrawWheel();
-		glPopMatrix();
-	glEndList();
+	TrainSet_Wait(set);
+	if (set->nTrains == set->capacity) {
+		set->capacity = set->capacity ? 2*set->capacity : 16;
+		unsigned n = set->capacity;
+		set->trains = realloc(set->trains, n * sizeof *set->trains);
+		set->states[0] = realloc(set->states[0], n * sizeof *set->states[0]);
+		set->states[1] = realloc(set->states[1], n * sizeof *set->states[1]);
+		set->tickSpeeds = realloc(set->tickSpeeds, n * sizeof *set->tickSpeeds);
+		set->drawPos = realloc(set->drawPos, n * sizeof *set->drawPos);
+		assert(   set->trains && set->states[0] && set->states[1]
+		       && set->tickSpeeds && set->drawPos);
+
+		TrainSeparation *sep = &set->separation;
+		sep->order = realloc(sep->order, n * sizeof *sep->order);
+		sep->states = realloc(sep->states, n * sizeof *sep->states);
+		sep->aheads = realloc(sep->aheads, n * sizeof *sep->aheads);
+		assert(sep->order && sep->states && sep->aheads);
+	}
+
+	unsigned i = set->nTrains++;
+	set->trains[i] = (Train){speed, nCarriages, TRAIN_NO_DESTINATION};
+	TrainState *state = &set->states[set->front][i];
+	NetworkPos_SetDistance(&state->pos, distance);
+	state->prevPos = state->pos;
+	state->lastMove = 0;
+	set->states[!set->front][i] = *state;
+	set->drawPos[i] = state->pos;
+	set->separation.states[i] = Separation_clear;
+	set->separation.aheads[i] = i;
+	set->separation.nOrdered = 0;
+	return i;
 }
 
-void DrawTrain(void)
+void TrainSet_Populate(TrainSet *set, unsigned nTrains)
 {
-	// Draw locomotive
-	GLfloat wheelPos[2][3];
-	NetworkPos wheelNp = g_trainPos;
-	NetworkPos_Move(&wheelNp, -0.5);
-	Track_GetCoords(wheelNp.track, wheelPos[0], wheelNp.pos);
-	NetworkPos_Move(&wheelNp, 1);
-	Track_GetCoords(wheelNp.track, wheelPos[1], wheelNp.pos);
-	GLfloat forward[3], pos[3];
-	Normalize3(forward, Saxpy3(forward, wheelPos[1], -1, wheelPos[0]));
-	Saxpy3(pos, wheelPos[0], 0.5, forward);
-	glPushMatrix();
-		// Train location
-		glTranslatef(pos[0], pos[1], pos[2]);
-		// Train orientation
-		Normalize3(forward, forward);
-		GLfloat angle = Angle3((GLfloat [3]){1}, forward);
-		if (Cross3((GLfloat [3]){0}, (GLfloat [3]){1}, forward)[1] < 0) {
-			angle *= -1;
+	TrainSet_Wait(set);
+	set->nTrains = 0;
+	double spacing = NetworkIndex_GetLength(&g_networkIndex) / nTrains;
+	for (unsigned i = 0; i < nTrains; ++i) {
+		// Vary speeds so trains close in on each other
+		TrainSet_Add(
+			set,
+			FIRST_DISTANCE + i*spacing,
+			DEFAULT_SPEED * (1 + 0.25*(i % 4)),
+			DEFAULT_CARRIAGES
+		);
+	}
+}
+
+void TrainSet_QueueTick(TrainSet *set, Scalar dt)
+{
+	++set->nTicks;
+	set->tickLength = dt;
+}
+
+// Runs queued ticks for trains begin to end - 1
+static void TickTrains(void *context, unsigned begin, unsigned end)
+{
+	const TrainSet   *set   = context;
+	const TrainState *front = set->states[set->front];
+	TrainState       *back  = set->states[!set->front];
+	for (unsigned i = begin; i < end; ++i) {
+		TrainState state = front[i];
+		Scalar move = set->tickSpeeds[i]*set->tickLength;
+		for (unsigned tick = 0; tick < set->nTicks; ++tick) {
+			state.prevPos = state.pos;
+			state.lastMove = move;
+			NetworkPos_Move(&state.pos, move);
+		}
+		back[i] = state;
+	}
+}
+
+static int CompareOrder(const void *a, const void *b)
+{
+	double distanceA = ((const TrainOrder *)a)->distance,
+	       distanceB = ((const TrainOrder *)b)->distance;
+	return (distanceA > distanceB) - (distanceA < distanceB);
+}
+
+// Gets separation of trains with given gap between them
+static Separation GetSeparation(const TrainSeparation *sep, Scalar gap)
+{
+	return gap < 0            ? Separation_collision
+	     : gap < sep->headway ? Separation_headway
+	     :                      Separation_clear;
+}
+
+static void AddEvent(TrainSeparation *sep, SeparationEvent event)
+{
+	if (sep->nEvents == sep->eventCapacity) {
+		sep->eventCapacity = sep->eventCapacity ? 2*sep->eventCapacity : 16;
+		sep->events = realloc(
+			sep->events,
+			sep->eventCapacity * sizeof *sep->events
+		);
+		assert(sep->events);
+	}
+	sep->events[sep->nEvents++] = event;
+}
+
+// Checks gap from each train to the train ahead over the ticks starting,
+// from the front state. Speeds are constant over them, so each gap changes
+// linearly and the tick it crosses a threshold in is found without stepping.
+static void CheckSeparation(TrainSet *set)
+{
+	TrainSeparation  *sep   = &set->separation;
+	const TrainState *front = set->states[set->front];
+	sep->pending = (SeparationStats){.minGap = INFINITY};
+
+	// Same trains are on the ring as at last check if as many are, and all
+	// those ordered then still are
+	unsigned n = 0;
+	for (unsigned i = 0; i < set->nTrains; ++i) {
+		n += NetworkPos_IsOnRing(&front[i].pos);
+	}
+	bool sameTrains = sep->nOrdered == n;
+	for (unsigned i = 0; i < n && sameTrains; ++i) {
+		sameTrains = NetworkPos_IsOnRing(&front[sep->order[i].train].pos);
+	}
+	if (n < 2) {
+		sep->nOrdered = 0;
+		return;
+	}
+
+	// Sort trains along the ring, so each only need be compared with the next.
+	// Few pass each other or the start of the ring between checks, so the
+	// last order is nearly sorted, and insertion sort takes close to linear
+	// time. It is sorted from scratch when trains have been added, or have
+	// left or joined the ring.
+	if (!sameTrains) {
+		n = 0;
+		for (unsigned i = 0; i < set->nTrains; ++i) {
+			if (NetworkPos_IsOnRing(&front[i].pos)) {
+				sep->order[n++] = (TrainOrder){
+					NetworkPos_GetDistance(&front[i].pos),
+					i
+				};
+			}
+		}
+		qsort(sep->order, n, sizeof *sep->order, CompareOrder);
+		sep->nOrdered = n;
+	} else {
+		for (unsigned i = 0; i < n; ++i) {
+			TrainOrder entry = {
+				NetworkPos_GetDistance(&front[sep->order[i].train].pos),
+				sep->order[i].train
+			};
+			unsigned j = i;
+			for (; j > 0 && sep->order[j - 1].distance > entry.distance; --j) {
+				sep->order[j] = sep->order[j - 1];
+			}
+			sep->order[j] = entry;
 		}
-		glRotatef(angle, 0, 1, 0);
-		// Draw train
-		glCallList(trainDl);
-	glPopMatrix();
-
-	// Draw carriages
-	for (unsigned i = 0; i < g_nCarriages; ++i) {
-		NetworkPos_Move(&wheelNp, -3.3);
-		Track_GetCoords(wheelNp.track, wheelPos[0], wheelNp.pos);
-		NetworkPos_Move(&wheelNp, 1);
-		Track_GetCoords(wheelNp.track, wheelPos[1], wheelNp.pos);
-		Normalize3(forward, Saxpy3(forward, wheelPos[1], -1, wheelPos[0]));
-		Saxpy3(pos, wheelPos[0], 0.5, forward);
-		glPushMatrix();
-			// Carriage location
-			glTranslatef(pos[0], pos[1], pos[2]);
-			// Carriage orientation
-			Normalize3(forward, forward);
-			angle = Angle3((GLfloat [3]){1}, forward);
-			if (Cross3((GLfloat [3]){0}, (GLfloat [3]){1}, forward)[1] < 0) {
-				angle *= -1;
+	}
+
+	double length = NetworkIndex_GetLength(&g_networkIndex);
+	for (unsigned i = 0; i < n; ++i) {
+		const TrainOrder *behind = &sep->order[i],
+		                 *ahead  = &sep->order[(i + 1) % n];
+		unsigned a = behind->train,
+		         b = ahead->train;
+
+		// Gap from front of train behind to back of train ahead, before and
+		// after ticks, wrapping around ring past the last train
+		double distance = ahead->distance + (i + 1 < n ? 0 : length);
+		Scalar gap = distance - behind->distance
+		           - CARRIAGE_SPACING*set->trains[b].nCarriages
+		           - VEHICLE_LENGTH,
+		       closing = (set->tickSpeeds[a] - set->tickSpeeds[b])
+		               * set->tickLength,
+		       endGap  = gap - closing*set->nTicks,
+		       minGap  = gap < endGap ? gap : endGap;
+
+		// Report trains closing past a threshold since last check, including
+		// when the pair were the other way round, having just passed. Gaps
+		// can't change without ticks, so leave that to the next check.
+		Separation end = GetSeparation(sep, endGap);
+		if (set->nTicks) {
+			Separation worst = GetSeparation(sep, minGap),
+			           last  = sep->aheads[a] == b ? sep->states[a]
+			                 : sep->aheads[b] == a ? sep->states[b]
+			                 :                       Separation_clear;
+			if (worst > last) {
+				Scalar threshold = worst == Separation_collision
+				                 ? 0
+				                 : sep->headway;
+				unsigned tick = 1;
+				if (gap >= threshold && closing > 0) {
+					tick += (gap - threshold) / closing;
+				}
+				if (tick > set->nTicks) {
+					tick = set->nTicks;
+				}
+				AddEvent(sep, (SeparationEvent){
+					worst,
+					a,
+					b,
+					set->nTicksRun + tick,
+					gap - closing*tick
+				});
 			}
-			glRotatef(angle, 0, 1, 0);
-			// Draw carriage
-			glCallList(carriageDl);
-		glPopMatrix();
+			sep->states[a] = end;
+			sep->aheads[a] = b;
+		}
+
+		if (minGap < sep->pending.minGap) {
+			sep->pending.minGap = minGap;
+			sep->pending.minBehind = a;
+		}
+		sep->pending.nHeadway += end == Separation_headway;
+		sep->pending.nCollisions += end == Separation_collision;
+	}
+}
+
+void TrainSet_Start(TrainSet *set, Scalar alpha)
+{
+	assert(!set->running);
+
+	// Snapshot controls, which may change while ticks run
+	for (unsigned i = 0; i < set->nTrains; ++i) {
+		set->tickSpeeds[i] = set->trains[i].speed;
+	}
+
+	// Set switches for as far as trains can go in these ticks
+	const TrainState *front = set->states[set->front];
+	for (unsigned i = 0; i < set->nTrains && set->routes; ++i) {
+		unsigned destination = set->trains[i].destination;
+		if (destination == TRAIN_NO_DESTINATION) {
+			continue;
+		}
+		Scalar speed = set->tickSpeeds[i];
+		RouteTable_SetSwitches(
+			set->routes,
+			&front[i].pos,
+			speed >= 0,
+			destination,
+			fabs(speed)*set->tickLength*set->nTicks + ROUTE_MARGIN
+		);
+	}
+	set->alpha = alpha;
+	set->running = true;
+	ThreadPool_Start(&set->pool, TickTrains, set, set->nTrains);
+
+	// Front state is only read while ticks run, so check it meanwhile
+	CheckSeparation(set);
+	set->nTicksRun += set->nTicks;
+}
+
+void TrainSet_Wait(TrainSet *set)
+{
+	if (!set->running) {
+		return;
+	}
+	ThreadPool_Wait(&set->pool);
+	set->running = false;
+	set->nTicks = 0;
+	set->front = !set->front;
+
+	const TrainState *states = set->states[set->front];
+	for (unsigned i = 0; i < set->nTrains; ++i) {
+		set->drawPos[i] = states[i].prevPos;
+		NetworkPos_Move(&set->drawPos[i], set->alpha*states[i].lastMove);
+	}
+
+	TrainSeparation *sep = &set->separation;
+	sep->stats = sep->pending;
+	for (unsigned i = 0; i < sep->nEvents && sep->onEvent; ++i) {
+		sep->onEvent(&sep->events[i]);
+	}
+	sep->nEvents = 0;
+}
+
+void TrainSet_UpdatePoses(TrainSet *set)
+{
+	// Grow pose buffers as trains get longer
+	unsigned n = 0;
+	for (unsigned i = 0; i < set->nTrains; ++i) {
+		n += set->trains[i].nCarriages + 1;
+	}
+	TrackPoses *poses = &set->poses;
+	if (set->poseCapacity < n) {
+		set->poseCapacity = n;
+		poses->x = realloc(poses->x, n * sizeof *poses->x);
+		poses->z = realloc(poses->z, n * sizeof *poses->z);
+		poses->sine = realloc(poses->sine, n * sizeof *poses->sine);
+		poses->cosine = realloc(poses->cosine, n * sizeof *poses->cosine);
+		set->offsets = realloc(set->offsets, n * sizeof *set->offsets);
+		assert(   poses->x && poses->z && poses->sine && poses->cosine
+		       && set->offsets);
+	}
+	set->nPoses = n;
+
+	// Locomotive first, then each carriage behind
+	for (unsigned j = 0; j < n; ++j) {
+		set->offsets[j] = -CARRIAGE_SPACING*j;
+	}
+	unsigned first = 0;
+	for (unsigned i = 0; i < set->nTrains; ++i) {
+		unsigned nVehicles = set->trains[i].nCarriages + 1;
+		TrackPoses train = {
+			&poses->x[first],
+			&poses->z[first],
+			&poses->sine[first],
+			&poses->cosine[first],
+			NULL
+		};
+		Track_GetPosesBatch(
+			&set->drawPos[i],
+			set->offsets,
+			nVehicles,
+			1,
+			&train,
+			&set->poseScratch
+		);
+		first += nVehicles;
 	}
 }
@@ -1,15 +1,150 @@
-#ifndef DRAW_TRAIN_H_INCLUDED
-#define DRAW_TRAIN_H_INCLUDED
+#ifndef TRAIN_H_INCLUDED
+#define TRAIN_H_INCLUDED
 
-#include <GL/gl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include "Scalar.h"
 #include "Track.h"
+#include "ThreadPool.h"
+#include "RouteTable.h"
 
-extern unsigned g_nCarriages;
-extern GLfloat g_trainSpeed;
-extern NetworkPos g_trainPos;
+// Longest train, in carriages behind the locomotive
+#define MAX_CARRIAGES 10000
 
-void InitTrain(void);
+// Destination of a train that follows switches as they are set
+#define TRAIN_NO_DESTINATION UINT_MAX
 
-void DrawTrain(void);
+// Controls of a train, only changed by the main thread
+typedef struct {
+	Scalar   speed;       // Distance per second
+	unsigned nCarriages,  // Behind the locomotive
+	         destination; // Location in routes to set switches towards
+} Train;
 
-#endif // DRAW_TRAIN_H_INCLUDED
+// Simulated state of a train
+typedef struct {
+	NetworkPos pos,
+	           prevPos;  // Position before last tick
+	Scalar     lastMove; // Distance moved in last tick
+} TrainState;
+
+// Gap to the train ahead below which trains are too close, by default
+#define DEFAULT_HEADWAY 4
+
+// Separation of a train from the train ahead, in increasing severity
+typedef enum {
+	Separation_clear,     // Gap at least headway
+	Separation_headway,   // Gap below headway
+	Separation_collision  // Trains overlap
+} Separation;
+
+// Train closing on the train ahead past a separation threshold
+typedef struct {
+	Separation    type;
+	unsigned      behind,
+	              ahead;
+	unsigned long tick;   // Number of tick in which it happened
+	Scalar        gap;    // Gap after that tick, negative if overlapping
+} SeparationEvent;
+
+// Separation of neighbouring trains over a set of ticks
+typedef struct {
+	Scalar   minGap;      // Smallest gap at any tick, negative if overlapping
+	unsigned minBehind,   // Train behind smallest gap
+	         nHeadway,    // Gaps below headway after the last tick
+	         nCollisions; // Overlapping pairs after the last tick
+} SeparationStats;
+
+// Train and its distance along the ring
+typedef struct {
+	double   distance;
+	unsigned train;
+} TrainOrder;
+
+// Checks of gaps between trains and the trains ahead, made by sorting the
+// trains on the ring along it while ticks run. Trains off the ring are not
+// checked.
+typedef struct {
+	Scalar          headway;
+	SeparationStats stats,     // For ticks up to front state
+	                pending;   // For ticks in flight
+	SeparationEvent *events;   // Of ticks in flight
+	unsigned        nEvents,
+	                eventCapacity;
+	TrainOrder      *order;    // Trains along the ring at last check
+	unsigned        nOrdered;  // Trains in order, 0 if added since
+	uint8_t         *states;   // Separation of each train at last check
+	unsigned        *aheads;   // Train ahead of each train at last check
+
+	// Called with each event when its ticks finish, if not null
+	void            (*onEvent)(const SeparationEvent *event);
+} TrainSeparation;
+
+// Trains on the indexed network, ticked in parallel. Ticks read the front
+// state buffer and write the back one, which become front when they finish,
+// so the main thread draws a consistent snapshot while the next ticks run.
+typedef struct {
+	Train            *trains;
+	TrainState       *states[2];
+	Scalar           *tickSpeeds; // Speeds of trains for ticks in flight
+	NetworkPos       *drawPos;    // Where to draw, between last two ticks
+	TrackPoses       poses;       // Of vehicles at draw positions, each train's
+	                              // locomotive then carriages in turn
+	Scalar           *offsets;    // Of vehicles from their locomotive
+	TrackPoseScratch poseScratch; // For posing vehicles
+	unsigned         nPoses,      // Vehicles in poses
+	                 poseCapacity;
+	unsigned         front,       // Index of front state buffer
+	                 nTrains,
+	                 capacity,
+	                 nTicks;      // Ticks queued or in flight
+	unsigned long    nTicksRun;   // Ticks started in total
+	Scalar           tickLength,  // Seconds per tick
+	                 alpha;       // Fraction of a tick to draw at, when done
+	bool             running;
+	ThreadPool       pool;
+	TrainSeparation  separation;
+	RouteTable       *routes;     // To destinations of trains, or null
+} TrainSet;
+
+extern TrainSet g_trainSet;
+
+// Initializes empty set, ticked by nThreads worker threads, or by the
+// calling thread if 0
+void TrainSet_Init(TrainSet *set, unsigned nThreads);
+
+// Waits for ticks, then frees trains and threads
+void TrainSet_Free(TrainSet *set);
+
+// Adds train at given distance from start of g_networkIndex, waiting for
+// ticks in flight. Returns its index.
+unsigned TrainSet_Add(
+	TrainSet *set,
+	double   distance,
+	Scalar   speed,
+	unsigned nCarriages
+);
+
+// Replaces trains with nTrains spread evenly along g_networkIndex, the first
+// at its start, e.g. after loading a new network
+void TrainSet_Populate(TrainSet *set, unsigned nTrains);
+
+// Queues a tick of dt seconds for the next TrainSet_Start()
+void TrainSet_QueueTick(TrainSet *set, Scalar dt);
+
+// Sets switches ahead of trains with destinations, then starts running queued
+// ticks on the thread pool, and checks separation of trains during them.
+// Positions to draw will be fraction alpha of the way through the last of
+// them. Switches must not be changed until TrainSet_Wait().
+void TrainSet_Start(TrainSet *set, Scalar alpha);
+
+// Waits for ticks in flight to finish, makes their states front, interpolates
+// positions to draw from them and reports their separation events
+void TrainSet_Wait(TrainSet *set);
+
+// Calculates poses of every vehicle at the draw positions, once per frame
+// after TrainSet_Wait(), and again after changing trains, before drawing them
+void TrainSet_UpdatePoses(TrainSet *set);
+
+#endif // TRAIN_H_INCLUDED
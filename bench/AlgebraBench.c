@@ -0,0 +1,97 @@
+// Micro-benchmark of batched Algebra kernels, reports vectors per second
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "Algebra.h"
+#include "BenchLayout.h"
+
+#define N_VECTORS 4096
+#define MIN_SECONDS 0.2
+
+static Scalar buffers[9][N_VECTORS],
+               dots[N_VECTORS];
+
+static const Vec3Array a = {buffers[0], buffers[1], buffers[2]},
+                       b = {buffers[3], buffers[4], buffers[5]},
+                       r = {buffers[6], buffers[7], buffers[8]};
+
+enum {
+	Kernel_add3N,
+	Kernel_saxpy3N,
+	Kernel_cross3N,
+	Kernel_dot3N,
+	Kernel_normalize3N,
+	Kernel_nKernels
+};
+
+static const char *const kernelNames[Kernel_nKernels] = {
+	"Add3N",
+	"Saxpy3N",
+	"Cross3N",
+	"Dot3N",
+	"Normalize3N"
+};
+
+static void RunKernel(unsigned kernel)
+{
+	switch (kernel) {
+	case Kernel_add3N:
+		Add3N(r, a, b, N_VECTORS);
+		break;
+	case Kernel_saxpy3N:
+		Saxpy3N(r, a, 0.5, b, N_VECTORS);
+		break;
+	case Kernel_cross3N:
+		Cross3N(r, a, b, N_VECTORS);
+		break;
+	case Kernel_dot3N:
+		Dot3N(dots, a, b, N_VECTORS);
+		break;
+	case Kernel_normalize3N:
+		Normalize3N(r, a, N_VECTORS);
+		break;
+	default:
+		abort();
+	}
+}
+
+// Gets vectors processed per second by kernel
+static double Measure(unsigned kernel)
+{
+	unsigned long iterations = 0;
+	double start = BenchLayout_Now(), elapsed;
+	do {
+		for (unsigned i = 0; i < 64; ++i) {
+			RunKernel(kernel);
+		}
+		iterations += 64;
+	} while ((elapsed = BenchLayout_Now() - start) < MIN_SECONDS);
+	return iterations * N_VECTORS / elapsed;
+}
+
+int main(void)
+{
+	srand(1);
+	for (unsigned i = 0; i < 6; ++i) {
+		for (unsigned j = 0; j < N_VECTORS; ++j) {
+			buffers[i][j] = 1 + (Scalar)rand()/RAND_MAX;
+		}
+	}
+
+	printf("%-12s %-9s %12s\n", "kernel", "isa", "Mvectors/s");
+	for (unsigned isa = 0; isa < AlgebraKernels_nKernels; ++isa) {
+		if (!Algebra_SetKernels(isa)) {
+			continue;
+		}
+		for (unsigned kernel = 0; kernel < Kernel_nKernels; ++kernel) {
+			printf(
+				"%-12s %-9s %12.1f\n",
+				kernelNames[kernel],
+				Algebra_GetKernelsName(isa),
+				Measure(kernel) / 1e6
+			);
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <assert.h>
+
+#include "BenchLayout.h"
+
+#define SPACING BENCH_LAYOUT_SPACING
+
+double BenchLayout_Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+TrackShared **BenchLayout_Build(unsigned n, bool shuffled)
+{
+	unsigned side = ceil(sqrt(n));
+	TrackShared **pieces = malloc(n * sizeof *pieces);
+	assert(pieces);
+	for (unsigned i = 0; i < n; ++i) {
+		Scalar x = i % side * SPACING,
+		       z = i / side * SPACING;
+		const Scalar start[2] = {x, z};
+		if (i % 2) {
+			const Scalar startDir[2] = {1, 0},
+			             end[2]      = {x + SPACING/2, z + SPACING/2},
+			             endDir[2]   = {0, 1};
+			pieces[i] = (TrackShared *)
+				AllocCurvedTrack(start, startDir, end, endDir, NULL, NULL);
+		} else {
+			const Scalar end[2] = {x + SPACING/2, z};
+			pieces[i] = (TrackShared *)
+				AllocStraightTrack(start, end, NULL, NULL);
+		}
+	}
+
+	if (shuffled) {
+		srand(1);
+		for (unsigned i = n - 1; i > 0; --i) {
+			unsigned j = rand() % (i + 1);
+			TrackShared *swap = pieces[i];
+			pieces[i] = pieces[j];
+			pieces[j] = swap;
+		}
+	}
+	for (unsigned i = 0; i < n; ++i) {
+		Track_SetNext(pieces[i], pieces[(i + 1) % n]);
+		Track_SetPrevious(pieces[(i + 1) % n], pieces[i]);
+	}
+	return pieces;
+}
+
+Scalar BenchLayout_GetExtent(unsigned n)
+{
+	return ceil(sqrt(n)) * SPACING;
+}
+
+void BenchLayout_Free(TrackShared **pieces, unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		free(pieces[i]);
+	}
+	free(pieces);
+}
@@ -0,0 +1,29 @@
+#ifndef BENCH_LAYOUT_H_INCLUDED
+#define BENCH_LAYOUT_H_INCLUDED
+
+// Timing and generated track layouts shared by the benchmarks
+
+#include <stdbool.h>
+#include "Scalar.h"
+#include "Track.h"
+
+// Distance between neighbouring pieces of generated layouts
+#define BENCH_LAYOUT_SPACING 4
+
+// Gets seconds on a monotonic clock
+double BenchLayout_Now(void);
+
+// Allocates n pieces on a square lattice, alternating straight pieces and
+// quarter curves, and links them into a ring. With shuffled, they are linked
+// in random order, as if the network had been edited many times. Returns the
+// pieces in ring order, in an array to free with BenchLayout_Free().
+TrackShared **BenchLayout_Build(unsigned n, bool shuffled);
+
+// Gets width of the square covered by a layout of n pieces
+Scalar BenchLayout_GetExtent(unsigned n);
+
+// Frees n pieces built by BenchLayout_Build() without an arena, and their
+// array
+void BenchLayout_Free(TrackShared **pieces, unsigned n);
+
+#endif // BENCH_LAYOUT_H_INCLUDED
@@ -0,0 +1,156 @@
+// Benchmark of traversing a ring of track through piece pointers and through
+// a FlatNetwork, with pieces scattered through the heap as after edits.
+// Reports nanoseconds per operation.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+#include "Track.h"
+#include "FlatNetwork.h"
+#include "BenchLayout.h"
+
+#define N_POSITIONS 1024
+#define MAX_MOVE 200
+#define MIN_SECONDS 0.2
+
+static const unsigned layoutSizes[] = {1000, 10000, 100000, 300000};
+
+static TrackShared **pieces;
+static unsigned    nPieces;
+static FlatNetwork flat;
+
+// Results written here, so they aren't optimized away
+static volatile double sink;
+
+static NetworkPos positions[N_POSITIONS];
+static FlatPos    flatPositions[N_POSITIONS];
+static Scalar     moves[N_POSITIONS],
+                  x[N_POSITIONS],
+                  z[N_POSITIONS];
+
+// Builds n scattered pieces, and positions on them to measure
+static void BuildScattered(unsigned n)
+{
+	pieces = BenchLayout_Build(n, true);
+	nPieces = n;
+
+	// Same random positions in both representations
+	for (unsigned i = 0; i < N_POSITIONS; ++i) {
+		unsigned piece = rand() % n;
+		Scalar pos = Track_GetLength(pieces[piece]) * rand() / RAND_MAX;
+		positions[i] = (NetworkPos){pieces[piece], pos};
+		flatPositions[i] = (FlatPos){piece, pos};
+		moves[i] = MAX_MOVE * (2.0*rand()/RAND_MAX - 1);
+	}
+}
+
+enum {
+	Op_walk,   // Sum lengths of whole ring, per piece
+	Op_move,   // Move a position up to MAX_MOVE either way, per position
+	Op_coords, // Get coordinates of a position, per position
+	Op_nOps
+};
+
+static const char *const opNames[Op_nOps] = {
+	"walk",
+	"move",
+	"coords"
+};
+
+// Runs operation once, returns how many pieces or positions it covered
+static unsigned RunOp(unsigned op, bool useFlat)
+{
+	switch (op) {
+	case Op_walk:
+		if (useFlat) {
+			double length = 0;
+			uint32_t piece = 0;
+			do {
+				length += flat.lengths[piece];
+				piece = flat.next[piece];
+			} while (piece != 0);
+			sink = length;
+		} else {
+			double length = 0;
+			TrackShared *track = pieces[0];
+			do {
+				length += Track_GetLength(track);
+				track = Track_GetNext(track);
+			} while (track != pieces[0]);
+			sink = length;
+		}
+		return nPieces;
+	case Op_move:
+		for (unsigned i = 0; i < N_POSITIONS; ++i) {
+			if (useFlat) {
+				FlatPos fp = flatPositions[i];
+				sink = FlatPos_Move(&flat, &fp, moves[i])->pos;
+			} else {
+				NetworkPos np = positions[i];
+				sink = NetworkPos_Move(&np, moves[i])->pos;
+			}
+		}
+		return N_POSITIONS;
+	case Op_coords:
+		if (useFlat) {
+			FlatNetwork_GetCoordsBatch(&flat, flatPositions, N_POSITIONS, x, z);
+		} else {
+			Track_GetCoordsBatch(positions, N_POSITIONS, x, z);
+		}
+		sink = x[0];
+		return N_POSITIONS;
+	default:
+		abort();
+	}
+}
+
+// Gets nanoseconds per piece or position covered by operation
+static double Measure(unsigned op, bool useFlat)
+{
+	unsigned long n = 0;
+	double start = BenchLayout_Now(), elapsed;
+	do {
+		n += RunOp(op, useFlat);
+	} while ((elapsed = BenchLayout_Now() - start) < MIN_SECONDS);
+	return elapsed / n * 1e9;
+}
+
+int main(void)
+{
+	printf("%8s %-8s %12s %12s\n", "pieces", "op", "pointer ns", "flat ns");
+	for (unsigned s = 0; s < sizeof layoutSizes/sizeof *layoutSizes; ++s) {
+		BuildScattered(layoutSizes[s]);
+		FlatNetwork_Build(&flat, pieces[0]);
+
+		// Check representations agree
+		for (unsigned i = 0; i < N_POSITIONS; ++i) {
+			NetworkPos np = positions[i];
+			FlatPos fp = flatPositions[i];
+			NetworkPos_Move(&np, moves[i]);
+			FlatPos_Move(&flat, &fp, moves[i]);
+			assert(np.track == flat.pieces[fp.piece] && np.pos == fp.pos);
+
+			// Pointer curves read sample tables, flat ones the exact arc
+			Scalar coords[3], flatCoords[3];
+			Track_GetCoords(np.track, coords, np.pos);
+			FlatNetwork_GetCoords(&flat, &fp, flatCoords);
+			assert(   fabsf(coords[0] - flatCoords[0]) < 2*g_trackSampleTolerance
+			       && fabsf(coords[2] - flatCoords[2]) < 2*g_trackSampleTolerance);
+		}
+
+		for (unsigned op = 0; op < Op_nOps; ++op) {
+			printf(
+				"%8u %-8s %12.2f %12.2f\n",
+				nPieces,
+				opNames[op],
+				Measure(op, false),
+				Measure(op, true)
+			);
+		}
+
+		FlatNetwork_Free(&flat);
+		BenchLayout_Free(pieces, nPieces);
+	}
+}
@@ -0,0 +1,211 @@
+// Benchmark of TrackGrid against a walk of the whole ring, on synthetic
+// layouts of straight and curved pieces. Reports operations per second.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+#include "Track.h"
+#include "TrackGrid.h"
+#include "BenchLayout.h"
+
+#define N_QUERIES 1024
+#define MAX_RESULTS 256
+#define QUERY_RADIUS 6
+#define QUERY_BOX 16
+#define N_VERIFIED 64
+#define MIN_SECONDS 0.2
+
+static const unsigned layoutSizes[] = {1000, 10000, 100000};
+
+static TrackShared **pieces;
+static unsigned    nPieces;
+static Scalar      queries[N_QUERIES][3];
+static Scalar      extent;
+
+// Lays out n pieces, and queries over them
+static void BuildLayout(unsigned n)
+{
+	pieces = BenchLayout_Build(n, false);
+	nPieces = n;
+	extent = BenchLayout_GetExtent(n);
+
+	srand(1);
+	for (unsigned i = 0; i < N_QUERIES; ++i) {
+		queries[i][0] = extent * rand() / RAND_MAX;
+		queries[i][1] = 0;
+		queries[i][2] = extent * rand() / RAND_MAX;
+	}
+}
+
+static TrackShared *ScanNearest(const Scalar point[3], Scalar *distance)
+{
+	TrackShared *nearest = NULL;
+	*distance = INFINITY;
+	for (unsigned i = 0; i < nPieces; ++i) {
+		Scalar d = Track_GetDistance(pieces[i], point, NULL);
+		if (d < *distance) {
+			*distance = d;
+			nearest = pieces[i];
+		}
+	}
+	return nearest;
+}
+
+static unsigned ScanRadius(const Scalar point[3], Scalar radius)
+{
+	unsigned n = 0;
+	for (unsigned i = 0; i < nPieces; ++i) {
+		n += Track_GetDistance(pieces[i], point, NULL) <= radius;
+	}
+	return n;
+}
+
+static unsigned ScanBox(const Scalar min[3], const Scalar max[3])
+{
+	unsigned n = 0;
+	for (unsigned i = 0; i < nPieces; ++i) {
+		const Scalar (*bounds)[3] = (const Scalar (*)[3])pieces[i]->bounds;
+		bool overlaps = true;
+		for (unsigned j = 0; j < 3; ++j) {
+			overlaps = overlaps
+			           && bounds[0][j] <= max[j]
+			           && bounds[1][j] >= min[j];
+		}
+		n += overlaps;
+	}
+	return n;
+}
+
+static void GetQueryBox(unsigned i, Scalar min[3], Scalar max[3])
+{
+	min[0] = queries[i][0] - QUERY_BOX/2;
+	min[1] = -1;
+	min[2] = queries[i][2] - QUERY_BOX/2;
+	max[0] = queries[i][0] + QUERY_BOX/2;
+	max[1] = 1;
+	max[2] = queries[i][2] + QUERY_BOX/2;
+}
+
+enum {
+	Query_nearest,
+	Query_radius,
+	Query_box,
+	Query_nQueries
+};
+
+static const char *const queryNames[Query_nQueries] = {
+	"nearest",
+	"radius",
+	"box"
+};
+
+// Runs query i of given kind, by grid or by scan, returns a checksum
+static unsigned RunQuery(TrackGrid *grid, unsigned kind, unsigned i)
+{
+	TrackShared *results[MAX_RESULTS];
+	Scalar min[3], max[3], distance;
+	switch (kind) {
+	case Query_nearest:
+		return grid
+			? TrackGrid_FindNearest(grid, queries[i], INFINITY, &distance, NULL)
+			  != NULL
+			: ScanNearest(queries[i], &distance) != NULL;
+	case Query_radius:
+		return grid
+			? TrackGrid_QueryRadius(
+				grid,
+				queries[i],
+				QUERY_RADIUS,
+				results,
+				MAX_RESULTS
+			)
+			: ScanRadius(queries[i], QUERY_RADIUS);
+	case Query_box:
+		GetQueryBox(i, min, max);
+		return grid
+			? TrackGrid_QueryBox(grid, min, max, results, MAX_RESULTS)
+			: ScanBox(min, max);
+	default:
+		abort();
+	}
+}
+
+// Checks grid queries agree with scans
+static void Verify(TrackGrid *grid)
+{
+	for (unsigned i = 0; i < N_VERIFIED; ++i) {
+		Scalar gridDistance, scanDistance;
+		TrackGrid_FindNearest(grid, queries[i], INFINITY, &gridDistance, NULL);
+		ScanNearest(queries[i], &scanDistance);
+		assert(gridDistance == scanDistance);
+		for (unsigned kind = Query_radius; kind <= Query_box; ++kind) {
+			assert(RunQuery(grid, kind, i) == RunQuery(NULL, kind, i));
+		}
+	}
+}
+
+// Gets queries per second, by grid or by scan if grid is null
+static double Measure(TrackGrid *grid, unsigned kind)
+{
+	unsigned long n = 0;
+	unsigned checksum = 0;
+	double start = BenchLayout_Now(), elapsed;
+	do {
+		for (unsigned i = 0; i < N_QUERIES; ++i) {
+			checksum += RunQuery(grid, kind, (n + i) % N_QUERIES);
+		}
+		n += N_QUERIES;
+	} while ((elapsed = BenchLayout_Now() - start) < MIN_SECONDS);
+	assert(checksum || !n);
+	return n / elapsed;
+}
+
+int main(void)
+{
+	printf(
+		"%8s %-10s %14s %14s\n",
+		"pieces", "operation", "grid ops/s", "scan ops/s"
+	);
+	for (unsigned s = 0; s < sizeof layoutSizes/sizeof *layoutSizes; ++s) {
+		BuildLayout(layoutSizes[s]);
+		NetworkIndex index = {0};
+		NetworkIndex_Build(&index, pieces[0]);
+
+		TrackGrid grid;
+		TrackGrid_Init(&grid, TRACK_GRID_CELL_SIZE);
+		double start = BenchLayout_Now();
+		TrackGrid_Build(&grid, &index);
+		printf(
+			"%8u %-10s %14.0f %14s\n",
+			nPieces, "build", nPieces / (BenchLayout_Now() - start), "-"
+		);
+
+		// Remove and reinsert every piece, as when a layout is edited
+		start = BenchLayout_Now();
+		for (unsigned i = 0; i < nPieces; ++i) {
+			TrackGrid_Remove(&grid, pieces[i]);
+			TrackGrid_Insert(&grid, pieces[i]);
+		}
+		printf(
+			"%8u %-10s %14.0f %14s\n",
+			nPieces, "update", nPieces / (BenchLayout_Now() - start), "-"
+		);
+
+		Verify(&grid);
+		for (unsigned kind = 0; kind < Query_nQueries; ++kind) {
+			printf(
+				"%8u %-10s %14.0f %14.0f\n",
+				nPieces,
+				queryNames[kind],
+				Measure(&grid, kind),
+				Measure(NULL, kind)
+			);
+		}
+
+		TrackGrid_Free(&grid);
+		NetworkIndex_Free(&index);
+		BenchLayout_Free(pieces, nPieces);
+	}
+}
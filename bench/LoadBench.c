@@ -0,0 +1,103 @@
+// Benchmark of loading track layouts of growing size, from text and from
+// mapped binary files. Reports milliseconds per load.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "Track.h"
+#include "TrackLayout.h"
+#include "BenchLayout.h"
+
+#define MIN_SECONDS 0.2
+
+static const unsigned layoutSizes[] = {1000, 10000, 100000, 300000};
+
+enum {
+	Load_text,
+	Load_binary,
+	Load_binaryIndexed, // Mapped, then walked once to build network index
+	Load_nKinds
+};
+
+static const char *const loadNames[Load_nKinds] = {
+	"text",
+	"binary",
+	"binary+index"
+};
+
+// Gets mean seconds to load file and free it again
+static double Measure(const char *path, unsigned kind)
+{
+	unsigned n = 0;
+	double start = BenchLayout_Now(), elapsed;
+	do {
+		TrackLayout layout;
+		bool ok = kind == Load_text
+			? TrackLayout_LoadText(&layout, path)
+			: TrackLayout_LoadBinary(&layout, path);
+		assert(ok);
+		(void)ok;
+		if (kind == Load_binaryIndexed) {
+			NetworkIndex_Build(&g_networkIndex, layout.head);
+		}
+		TrackLayout_Free(&layout);
+		++n;
+	} while ((elapsed = BenchLayout_Now() - start) < MIN_SECONDS);
+	return elapsed / n;
+}
+
+static double GetMegabytes(const char *path)
+{
+	struct stat st;
+	return stat(path, &st) ? 0 : st.st_size / 1e6;
+}
+
+int main(void)
+{
+	char textPath[]   = "/tmp/load-bench-text-XXXXXX",
+	     binaryPath[] = "/tmp/load-bench-binary-XXXXXX";
+	int textFd   = mkstemp(textPath),
+	    binaryFd = mkstemp(binaryPath);
+	assert(textFd >= 0 && binaryFd >= 0);
+	close(textFd);
+	close(binaryFd);
+
+	printf(
+		"%8s %-13s %8s %10s\n",
+		"pieces", "format", "MB", "ms/load"
+	);
+	for (unsigned s = 0; s < sizeof layoutSizes/sizeof *layoutSizes; ++s) {
+		TrackLayout layout = {0};
+		g_trackArena = &layout.arena;
+		TrackShared **pieces = BenchLayout_Build(layoutSizes[s], false);
+		g_trackArena = NULL;
+		layout.head = pieces[0];
+		free(pieces);
+		bool ok = TrackLayout_SaveText(&layout, textPath)
+		          && TrackLayout_SaveBinary(&layout, binaryPath);
+		assert(ok);
+		(void)ok;
+		TrackLayout_Free(&layout);
+
+		for (unsigned kind = 0; kind < Load_nKinds; ++kind) {
+			const char *path = kind == Load_text ? textPath : binaryPath;
+			printf(
+				"%8u %-13s %8.2f %10.3f\n",
+				layoutSizes[s],
+				loadNames[kind],
+				GetMegabytes(path),
+				Measure(path, kind) * 1e3
+			);
+		}
+	}
+
+	NetworkIndex_Free(&g_networkIndex);
+	remove(textPath);
+	remove(binaryPath);
+}
@@ -0,0 +1,116 @@
+// Benchmark of ticking sets of trains across thread pools of several sizes,
+// each frame queueing a frame's worth of ticks, then starting and waiting for
+// them. Checks every pool size leaves trains where the calling thread does.
+// Reports microseconds per frame and nanoseconds per train per tick.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "Track.h"
+#include "Train.h"
+#include "BenchLayout.h"
+
+#define N_PIECES 10000
+#define TICK_RATE 1000
+#define TICKS_PER_FRAME 16
+#define N_VERIFIED_FRAMES 100
+#define MIN_SECONDS 0.2
+
+static const unsigned trainCounts[] = {100, 1000, 10000},
+                      threadCounts[] = {0, 1, 2, 4, 8};
+
+// Queues, starts and waits for one frame of ticks
+static void RunFrame(TrainSet *set)
+{
+	for (unsigned tick = 0; tick < TICKS_PER_FRAME; ++tick) {
+		TrainSet_QueueTick(set, 1./TICK_RATE);
+	}
+	TrainSet_Start(set, 0.5);
+	TrainSet_Wait(set);
+}
+
+// Runs frames on nTrains trains with nThreads threads, and gets distance
+// of each train from start of ring afterwards
+static void Simulate(unsigned nTrains, unsigned nThreads, double distances[])
+{
+	TrainSet set;
+	TrainSet_Init(&set, nThreads);
+	TrainSet_Populate(&set, nTrains);
+	for (unsigned frame = 0; frame < N_VERIFIED_FRAMES; ++frame) {
+		RunFrame(&set);
+	}
+	for (unsigned i = 0; i < nTrains; ++i) {
+		distances[i] = NetworkPos_GetDistance(&set.drawPos[i]);
+	}
+	TrainSet_Free(&set);
+}
+
+// Gets seconds per frame for nTrains trains on nThreads threads
+static double Measure(unsigned nTrains, unsigned nThreads)
+{
+	TrainSet set;
+	TrainSet_Init(&set, nThreads);
+	TrainSet_Populate(&set, nTrains);
+	unsigned long frames = 0;
+	double start = BenchLayout_Now(),
+	       elapsed;
+	do {
+		RunFrame(&set);
+		++frames;
+	} while ((elapsed = BenchLayout_Now() - start) < MIN_SECONDS);
+	TrainSet_Free(&set);
+	return elapsed / frames;
+}
+
+int main(void)
+{
+	TrackShared **pieces = BenchLayout_Build(N_PIECES, false);
+	NetworkIndex_Build(&g_networkIndex, pieces[0]);
+	unsigned nCounts   = sizeof trainCounts/sizeof *trainCounts,
+	         nPools    = sizeof threadCounts/sizeof *threadCounts,
+	         maxTrains = trainCounts[nCounts - 1];
+	double *expected = malloc(maxTrains * sizeof *expected),
+	       *actual   = malloc(maxTrains * sizeof *actual);
+	assert(expected && actual);
+
+	printf(
+		"%8s %8s %14s %18s\n",
+		"trains", "threads", "us/frame", "ns/train-tick"
+	);
+	for (unsigned t = 0; t < nCounts; ++t) {
+		unsigned nTrains = trainCounts[t];
+		Simulate(nTrains, 0, expected);
+		for (unsigned p = 0; p < nPools; ++p) {
+			unsigned nThreads = threadCounts[p];
+			Simulate(nTrains, nThreads, actual);
+			for (unsigned i = 0; i < nTrains; ++i) {
+				if (actual[i] != expected[i]) {
+					fprintf(
+						stderr,
+						"Train %u differs with %u threads: %f, expected %f\n",
+						i,
+						nThreads,
+						actual[i],
+						expected[i]
+					);
+					return EXIT_FAILURE;
+				}
+			}
+
+			double seconds = Measure(nTrains, nThreads);
+			printf(
+				"%8u %8u %14.2f %18.2f\n",
+				nTrains,
+				nThreads,
+				seconds * 1e6,
+				seconds / nTrains / TICKS_PER_FRAME * 1e9
+			);
+		}
+	}
+
+	free(expected);
+	free(actual);
+	NetworkIndex_Free(&g_networkIndex);
+	BenchLayout_Free(pieces, N_PIECES);
+}
@@ -0,0 +1,52 @@
+// Benchmark of walking rings of track piece by piece, with pieces scattered
+// through the heap as after edits, and after compaction. Reports nanoseconds
+// per piece.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "Track.h"
+#include "TrackLayout.h"
+#include "BenchLayout.h"
+
+#define MIN_SECONDS 0.2
+
+static const unsigned layoutSizes[] = {1000, 10000, 100000, 300000};
+
+// Gets nanoseconds per piece to walk ring, summing lengths
+static double Measure(TrackShared *head, unsigned n)
+{
+	unsigned long walks = 0;
+	double length = 0,
+	       start  = BenchLayout_Now(),
+	       elapsed;
+	do {
+		TrackShared *track = head;
+		do {
+			length += Track_GetLength(track);
+			track = Track_GetNext(track);
+		} while (track != head);
+		++walks;
+	} while ((elapsed = BenchLayout_Now() - start) < MIN_SECONDS);
+	assert(length > 0);
+	return elapsed / walks / n * 1e9;
+}
+
+int main(void)
+{
+	printf("%8s %14s %14s\n", "pieces", "scattered ns", "compacted ns");
+	for (unsigned s = 0; s < sizeof layoutSizes/sizeof *layoutSizes; ++s) {
+		unsigned n = layoutSizes[s];
+		TrackShared **pieces = BenchLayout_Build(n, true);
+		TrackLayout layout = {.head = pieces[0]};
+		double scattered = Measure(layout.head, n);
+
+		TrackLayout_Compact(&layout);
+		BenchLayout_Free(pieces, n);
+		double compacted = Measure(layout.head, n);
+
+		printf("%8u %14.2f %14.2f\n", n, scattered, compacted);
+		TrackLayout_Free(&layout);
+	}
+}
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
 #include <GL/gl.h>
@@ -12,12 +13,26 @@
 #endif
 
 #include "Train.h"
+#include "DrawTrain.h"
 #include "Camera.h"
 #include "Screen.h"
 #include "Algebra.h"
 #include "Lighting.h"
 #include "DrawUtil.h"
 #include "Track.h"
+#include "DrawTrack.h"
+#include "Clock.h"
+#include "FixedStep.h"
+#include "GlExt.h"
+#include "Multisample.h"
+#include "Mesh.h"
+#include "Bench.h"
+#include "Instancing.h"
+#include "TrackGrid.h"
+#include "TrackLayout.h"
+#include "RouteTable.h"
+#include "Recorder.h"
+#include "Profiler.h"
 
 #define UNUSED(x) (void)(x)
 
@@ -25,15 +40,82 @@
 
 #define PI 3.14159265358979323846264338327950288
 
-// Frees allocated track on exit
+// Simulation ticks per second, independent of frame rate
+#define TICK_RATE 1000
+
+// Most ticks to catch up on per frame before the simulation slows down
+#define MAX_TICKS_PER_FRAME (TICK_RATE/4)
+
+static FixedStep simulation;
+
+static Mesh groundMesh;
+
+// Samples per pixel to anti-alias with, 0 to use the accumulation buffer
+static unsigned nSamples = 4;
+
+// Queues one tick of simulation, run with the rest of the frame's ticks
+static void SimulationTick(Scalar dt)
+{
+	TrainSet_QueueTick(&g_trainSet, dt);
+}
+
+// Trains to run, and threads to tick them, by default one per processor
+static unsigned nTrains  = 1,
+                nThreads = 0;
+
+// Carriages per train, or -1 to keep each train's default
+static long nCarriages = -1;
+
+// Track layout file to load instead of built-in network, or null
+static const char *layoutPath = NULL;
+
+// Network in use
+static TrackLayout network = {.head = (TrackShared *)&g_initialTrackPiece};
+
+// Routes to the network's locations
+static RouteTable routes;
+
+// Frames are recorded to a video file, if given one
+static const char *recordPath = NULL;
+static Recorder   recorder;
+
+// Reports trains getting too close
+static void PrintSeparationEvent(const SeparationEvent *event)
+{
+	printf(
+		"Tick %lu: train %u %s train %u, gap %.2f\n",
+		event->tick,
+		event->behind,
+		event->type == Separation_collision ? "collided with"
+		                                    : "within headway of",
+		event->ahead,
+		event->gap
+	);
+}
+
+// Finishes recording, as the program exits from GLUT's main loop
+static void StopRecording(void)
+{
+	Recorder_Stop(&recorder);
+}
+
+// CSV file of per-frame phase times, if given one
+static const char *profilePath = NULL;
+
+// Writes out last frames' times on exit
+static void StopProfiling(void)
+{
+	Profiler_Free();
+}
+
+// Frees trains and allocated track on exit
 static void FreeNetwork(void)
 {
-	TrackShared *next,
-	            *track = (TrackShared *)g_initialTrackPiece.next;
-	for (; track != (TrackShared *)&g_initialTrackPiece; track = next) {
-		next = Track_GetNext(track);
-		free(track);
-	}
+	TrainSet_Free(&g_trainSet);
+	RouteTable_Free(&routes);
+	TrackLayout_Free(&network);
+	NetworkIndex_Free(&g_networkIndex);
+	TrackGrid_Free(&g_trackGrid);
 }
 
 // Initialize stuff: called once from main() before main loop
@@ -63,43 +145,123 @@ static void Init(void)
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_LIGHTING);
 
-	InitUtilFns();
+	GlExt_Load();
+	if (!Multisample_Init(nSamples)) {
+		fprintf(
+			stderr,
+			"Multisampling unavailable, anti-aliasing with accumulation buffer\n"
+		);
+	}
+
+	Instancing_Init();
 	InitLighting();
 
+	// Build ground
+	static const Material groundMaterial = {
+		{0.2, 0.75, 0.1, 1}, {0.2, 0.75, 0.1, 1}, {0, 0, 0, 1}, 0
+	};
+	MeshBuilder builder;
+	MeshBuilder_Init(&builder);
+	MeshBuilder_SetMaterial(&builder, &groundMaterial);
+	MeshBuilder_Scale(&builder, 1000, 1, 1000);
+	BuildSquare(&builder);
+	Mesh_Build(&groundMesh, &builder);
+
 	InitTrain();
 	InitTrack();
 
-	// Build track to use
-	CurvedTrack *current = AllocCurvedTrack(
-		curves[0][0],
-		curves[0][1],
-		curves[1][0],
-		curves[1][1],
-		NULL,
-		(TrackShared *)&g_initialTrackPiece
+	// Load track to use, or build it from table
+	if (layoutPath) {
+		if (!TrackLayout_Load(&network, layoutPath)) {
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		g_trackArena = &network.arena;
+		TrackShared *current = network.head;
+		for (unsigned i = 0; i + 1 < ASIZE(curves); ++i) {
+			TrackShared *next = (TrackShared *)AllocCurvedTrack(
+				curves[i][0],
+				curves[i][1],
+				curves[i+1][0],
+				curves[i+1][1],
+				NULL,
+				current
+			);
+			Track_SetNext(current, next);
+			current = next;
+		}
+		Track_SetNext(current, network.head);
+		Track_SetPrevious(network.head, current);
+		g_trackArena = NULL;
+	}
+	NetworkIndex_Build(&g_networkIndex, network.head);
+	TrackGrid_Build(&g_trackGrid, &g_networkIndex);
+	RouteTable_Build(
+		&routes,
+		&g_networkIndex,
+		network.locations,
+		network.nLocations
 	);
-	g_initialTrackPiece.next = (TrackShared *)current;
-	for (unsigned i = 1; i + 1 < ASIZE(curves); ++i) {
-		current->next = (TrackShared *)AllocCurvedTrack(
-			curves[i][0],
-			curves[i][1],
-			curves[i+1][0],
-			curves[i+1][1],
-			NULL,
-			(TrackShared *)current
-		);
-		current = (CurvedTrack *)current->next;
+	TrainSet_Init(&g_trainSet, nThreads);
+	g_trainSet.separation.onEvent = PrintSeparationEvent;
+	g_trainSet.routes = &routes;
+	TrainSet_Populate(&g_trainSet, nTrains);
+	for (unsigned i = 0; i < g_trainSet.nTrains && nCarriages >= 0; ++i) {
+		g_trainSet.trains[i].nCarriages = nCarriages;
 	}
-	current->next = (TrackShared *)&g_initialTrackPiece;
-	g_initialTrackPiece.prev = (TrackShared *)current;
 
 	atexit(FreeNetwork);
+
+	FixedStep_Init(&simulation, TICK_RATE, MAX_TICKS_PER_FRAME);
 }
 
 static bool antiAliasing = false;
 
-// GLUT display callback
-static void Display(void)
+// Clears and draws the whole scene, with view offset by given pixel fraction
+static void DrawScene(GLdouble pixdx, GLdouble pixdy)
+{
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// Set camera position
+	Bench_BeginPhase(BenchPhase_camera);
+	DrawCamera(pixdx, pixdy);
+	LodView lodView;
+	LodView_FromGl(&lodView);
+
+	// Draw ground
+	Bench_BeginPhase(BenchPhase_ground);
+	Mesh_Draw(&groundMesh);
+
+	// Position lights
+	Bench_BeginPhase(BenchPhase_lighting);
+	DrawLighting();
+
+	// Draw train
+	Bench_BeginPhase(BenchPhase_train);
+	DrawTrain(&lodView);
+
+	// Draw rails in view, on the ring and off it
+	Bench_BeginPhase(BenchPhase_track);
+	Frustum frustum;
+	Frustum_FromGl(&frustum);
+	g_trackCullStats = (CullStats){0};
+	DrawRails(&frustum, &lodView);
+
+	// Draw track slats
+	Bench_BeginPhase(BenchPhase_slats);
+	DrawSlats(0.7);
+	Bench_EndPhase();
+}
+
+// Draws a frame for benchmarking, with no simulation or anti-aliasing
+static void DrawBenchFrame(void)
+{
+	DrawScene(0.5, 0.5);
+}
+
+// Simulates up to given time, and draws and shows a frame, then waits for it
+// to be rendered if finish, within the frame's swap phase
+static void RunFrame(double seconds, bool finish)
 {
 	static const GLdouble j8[8][2] = {
 		{0.5625, 0.4375},
@@ -111,66 +273,48 @@ static void Display(void)
 		{0.4375, 0.0625},
 		{0.1875, 0.3125}
 	};
-	static const GLfloat groundColor[4] = {0.2, 0.75, 0.1, 1},
-	                     blackColor[4]  = {0, 0, 0, 1},
-	                     groundSize     = 1000;
-
-	GLint viewport[4];
-	glGetIntegerv(GL_VIEWPORT, viewport);
 
-	if (antiAliasing) {
+	// Take trains ticked during last frame to draw, then tick them up to now
+	// while this frame is drawn
+	Bench_BeginPhase(BenchPhase_simulation);
+	TrainSet_Wait(&g_trainSet);
+	Scalar alpha = FixedStep_Advance(&simulation, seconds, SimulationTick);
+	TrainSet_Start(&g_trainSet, alpha);
+	// Pose vehicles to draw once, while the ticks run
+	TrainSet_UpdatePoses(&g_trainSet);
+	Bench_EndPhase();
+
+	if (!antiAliasing) {
+		DrawScene(j8[0][0], j8[0][1]);
+	} else if (Multisample_GetSamples()) {
+		// Draw once with multisampling, resolve to window
+		Multisample_Begin();
+		DrawScene(0, 0);
+		Multisample_End();
+	} else {
+		// Fall back to averaging jittered draws in accumulation buffer
 		glClear(GL_ACCUM_BUFFER_BIT);
-	}
-
-	for (unsigned jitter = 0; jitter < 8; ++jitter) {
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		// Set camera position
-		DrawCamera(j8[jitter][0], j8[jitter][1]);
-
-		// Draw ground
-		glMaterialfv(GL_FRONT, GL_AMBIENT, groundColor);
-		glMaterialfv(GL_FRONT, GL_DIFFUSE, groundColor);
-		glMaterialfv(GL_FRONT, GL_SPECULAR, blackColor);
-		glMaterialf(GL_FRONT, GL_SHININESS, 0);
-		glBegin(GL_QUADS);
-			glNormal3f(0, 1, 0);
-			glVertex3f(groundSize/2, 0, -groundSize/2);
-			glVertex3f(-groundSize/2, 0, -groundSize/2);
-			glVertex3f(-groundSize/2, 0, groundSize/2);
-			glVertex3f(groundSize/2, 0, groundSize/2);
-		glEnd();
-
-		// Position lights
-		DrawLighting();
-
-		// Draw train
-		DrawTrain();
-
-		// Draw track
-		Track_Draw((TrackShared *)&g_initialTrackPiece);
-		for (CurvedTrack *track = (CurvedTrack *)g_initialTrackPiece.next;
-	     	     (TrackShared *)track != (TrackShared *)&g_initialTrackPiece;
-	     	     track = (CurvedTrack *)track->next)
-		{
-			Track_Draw((TrackShared *)track);
+		for (unsigned jitter = 0; jitter < ASIZE(j8); ++jitter) {
+			DrawScene(j8[jitter][0], j8[jitter][1]);
+			glAccum(GL_ACCUM, 1./ASIZE(j8));
 		}
-
-		// Draw track slats
-		DrawSlats(0.7);
-
-		if (!antiAliasing) {
-			break;
-		}
-		glAccum(GL_ACCUM, 1./8);
-	}
-
-	if (antiAliasing) {
 		glAccum(GL_RETURN, 1);
 	}
 
-	// Process buffered OpenGL routines and display
+	Profiler_DrawOverlay(g_screenWidth, g_screenHeight);
+
+	// Process buffered OpenGL routines and display, recording frame first as
+	// the back buffer is undefined after swapping
+	Bench_BeginPhase(BenchPhase_swap);
+	if (recordPath) {
+		Recorder_Capture(&recorder);
+	}
 	glutSwapBuffers();
+	if (finish) {
+		glFinish();
+	}
+	Bench_EndPhase();
+	Profiler_EndFrame();
 
 	// Log GL errors, if any
 	GLenum error;
@@ -179,8 +323,74 @@ static void Display(void)
 	}
 }
 
+// Runs a frame of a benchmark, waiting for it to be rendered
+static void RunBenchFrame(double seconds)
+{
+	RunFrame(seconds, true);
+}
+
+// GLUT display callback
+static void Display(void)
+{
+	RunFrame(Clock_GetSeconds(), false);
+}
+
 #define MOVE_AMOUNT 0.2
 
+// Cycles first train's destination through the network's locations and none
+static void CycleDestination(void)
+{
+	Train *train = &g_trainSet.trains[0];
+	unsigned destination = train->destination + 1;
+	if (train->destination == TRAIN_NO_DESTINATION) {
+		destination = 0;
+	}
+	if (destination >= network.nLocations) {
+		train->destination = TRAIN_NO_DESTINATION;
+		printf("Train 0 following switches as set\n");
+		return;
+	}
+	train->destination = destination;
+	printf(
+		"Train 0 heading for %s, %.1f away\n",
+		network.locations[destination].name,
+		RouteTable_GetDistance(
+			&routes,
+			&g_trainSet.drawPos[0],
+			train->speed >= 0,
+			destination
+		)
+	);
+}
+
+// Flips the next facing switch ahead of the first train
+static void FlipNextSwitch(void)
+{
+	// Ticks in flight read switches
+	TrainSet_Wait(&g_trainSet);
+	TrackEnd    end   = g_trainSet.trains[0].speed >= 0 ? TrackEnd_end
+	                                                    : TrackEnd_start;
+	TrackShared *track = g_trainSet.drawPos[0].track;
+	unsigned nPieces = g_networkIndex.nPieces + g_networkIndex.nBranchPieces;
+	for (unsigned i = 0; i < nPieces && track; ++i) {
+		if (Track_GetBranch(track, end)) {
+			SwitchState state = track->switches[end] == Switch_normal
+			                  ? Switch_reverse
+			                  : Switch_normal;
+			Track_SetSwitch(track, end, state);
+			printf(
+				"Switch at %s of piece %u set %s\n",
+				end == TrackEnd_end ? "end" : "start",
+				track->index,
+				state == Switch_reverse ? "to branch" : "straight on"
+			);
+			return;
+		}
+		track = Track_Follow(track, end);
+	}
+	printf("No switch ahead of train 0\n");
+}
+
 // GLUT keyboard callback
 static void KeyboardCallback(unsigned char key, int x, int y)
 {
@@ -195,34 +405,76 @@ static void KeyboardCallback(unsigned char key, int x, int y)
 	case 'a':
 		antiAliasing = !antiAliasing;
 		break;
+	case 'i':
+		g_instancedTrain = !g_instancedTrain;
+		break;
+	case 'c':
+		printf(
+			"Track chunks: %u visible, %u culled\n",
+			g_trackCullStats.visible,
+			g_trackCullStats.culled
+		);
+		break;
+	case 'd':
+		CycleDestination();
+		break;
+	case 'p':
+		FlipNextSwitch();
+		break;
+	case 't':
+		Profiler_ToggleOverlay();
+		break;
+	case 'g':
+		{
+			const SeparationStats *stats = &g_trainSet.separation.stats;
+			printf(
+				"Trains: minimum gap %.2f behind train %u, %u within headway,"
+				" %u colliding\n",
+				stats->minGap,
+				stats->minBehind,
+				stats->nHeadway,
+				stats->nCollisions
+			);
+		}
+		break;
 	}
 }
 
-// GLUT special key callback
+// GLUT special key callback, controls first train
 static void SpecialKeyCallback(int key, int x, int y)
 {
 	UNUSED(x); UNUSED(y);
+	Train *train = &g_trainSet.trains[0];
 	switch (key) {
 	case GLUT_KEY_LEFT:
-		if (g_nCarriages) {
-			--g_nCarriages;
+		if (train->nCarriages) {
+			--train->nCarriages;
 		}
 		break;
 	case GLUT_KEY_RIGHT:
-		if (g_nCarriages < 88) {
-			++g_nCarriages;
+		if (train->nCarriages < MAX_CARRIAGES) {
+			++train->nCarriages;
 		}
 		break;
+	case GLUT_KEY_PAGE_DOWN:
+		train->nCarriages = train->nCarriages > 100 ? train->nCarriages - 100
+		                                            : 0;
+		break;
+	case GLUT_KEY_PAGE_UP:
+		train->nCarriages = train->nCarriages + 100 < MAX_CARRIAGES
+		                  ? train->nCarriages + 100
+		                  : MAX_CARRIAGES;
+		break;
 	case GLUT_KEY_UP:
-		g_trainSpeed += 0.004;
-		if (g_trainSpeed > 0.2) {
-			g_trainSpeed = 0.2;
+		train->speed += 0.24;
+		if (train->speed > 12) {
+			train->speed = 12;
 		}
 		break;
 	case GLUT_KEY_DOWN:
-		g_trainSpeed -= 0.004;
-		if (g_trainSpeed < -0.1) {
-			g_trainSpeed = -0.2;
+		train->speed -= 0.24;
+		if (train->speed < -6) {
+			train->speed = -12;
 		}
 		break;
 	}
@@ -233,14 +485,14 @@ static void ResizeCallback(int width, int height)
 	glViewport(0, 0, width, height);
 	g_screenWidth = width;
 	g_screenHeight = height;
+	Multisample_Resize(width, height);
 }
 
-// GLUT animation/logic callback
+// GLUT animation callback, simulation is advanced when drawing
 static void MainStep(int value)
 {
 	glutTimerFunc(value, MainStep, value);
 	glutPostRedisplay();
-	NetworkPos_Move(&g_trainPos, g_trainSpeed);
 }
 
 int main(int argc, char *argv[])
@@ -254,6 +506,54 @@ int main(int argc, char *argv[])
 	glutInitWindowPosition(100, 100);
 	glutCreateWindow("Toy Train");
 
+	// Parse remaining arguments, after GLUT has taken its own
+	bool benchCarriages = false;
+	BenchScenario bench = {.format = BenchFormat_json};
+	nThreads = ThreadPool_GetCpuCount();
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--samples") && i + 1 < argc) {
+			nSamples = strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "--layout") && i + 1 < argc) {
+			layoutPath = argv[++i];
+		} else if (!strcmp(argv[i], "--trains") && i + 1 < argc) {
+			nTrains = strtoul(argv[++i], NULL, 10);
+			if (!nTrains) {
+				nTrains = 1;
+			}
+		} else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+			nThreads = strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "--carriages") && i + 1 < argc) {
+			nCarriages = strtoul(argv[++i], NULL, 10);
+			if (nCarriages > MAX_CARRIAGES) {
+				nCarriages = MAX_CARRIAGES;
+			}
+		} else if (!strcmp(argv[i], "--camera") && i + 1 < argc) {
+			g_cameraMode = strtoul(argv[++i], NULL, 10) % CameraMode_nModes;
+		} else if (!strcmp(argv[i], "--aa")) {
+			antiAliasing = true;
+		} else if (!strcmp(argv[i], "--bench") && i + 1 < argc) {
+			bench.nFrames = strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "--csv")) {
+			bench.format = BenchFormat_csv;
+		} else if (!strcmp(argv[i], "--profile") && i + 1 < argc) {
+			profilePath = argv[++i];
+		} else if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+			recordPath = argv[++i];
+		} else if (!strcmp(argv[i], "--bench-carriages")) {
+			benchCarriages = true;
+		} else {
+			fprintf(
+				stderr,
+				"Usage: %s [--samples N] [--layout FILE] [--trains N]"
+				" [--threads N] [--carriages N] [--camera N] [--aa]"
+				" [--bench FRAMES [--csv]] [--bench-carriages]"
+				" [--profile FILE] [--record FILE]\n",
+				argv[0]
+			);
+			return EXIT_FAILURE;
+		}
+	}
+
 	GLenum error;
 	if ((error = glGetError()) != GL_NO_ERROR) {
 		fprintf(stderr, "GL error: %d\n", error);
@@ -267,6 +567,39 @@ int main(int argc, char *argv[])
 		fprintf(stderr, "GL error: %d\n", error);
 	}
 
+	Profiler_Init(profilePath);
+	atexit(StopProfiling);
+
+	if (recordPath) {
+		if (!Recorder_Start(
+			&recorder,
+			recordPath,
+			g_screenWidth,
+			g_screenHeight))
+		{
+			return EXIT_FAILURE;
+		}
+		atexit(StopRecording);
+	}
+
+	if (benchCarriages) {
+		Bench_Carriages(DrawBenchFrame);
+		return EXIT_SUCCESS;
+	}
+	if (bench.nFrames) {
+		// Keep stdout to results
+		g_trainSet.separation.onEvent = NULL;
+		bench.cameraMode = g_cameraMode;
+		bench.nCarriages = g_trainSet.trains[0].nCarriages;
+		bench.nTrains = nTrains;
+		bench.nThreads = nThreads;
+		bench.nSamples = Multisample_GetSamples();
+		bench.antiAliasing = antiAliasing;
+		bench.layout = layoutPath;
+		Bench_Run(&bench, RunBenchFrame);
+		return EXIT_SUCCESS;
+	}
+
 	// Register GLUT callbacks, start GLUT main loop
 	glutDisplayFunc(Display);
 	glutKeyboardFunc(KeyboardCallback);
@@ -0,0 +1,108 @@
+// Checks that coordinates looked up in the sample tables of curved pieces stay
+// within g_trackSampleTolerance of the exact arc, for each layout given.
+// Exits with failure if any point strays further.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "Track.h"
+#include "TrackLayout.h"
+
+// Points checked along each piece
+#define N_POINTS 10007
+
+// Slack for rounding of single precision coordinates, relative to their size
+#define ROUNDING 4e-7
+
+// Compares every curved piece of tabulated against the same piece of exact.
+// Returns whether all are within tolerance, and raises *maxError to the
+// largest distance seen.
+static bool CheckLayout(
+	const NetworkIndex *tabulated,
+	const NetworkIndex *exact,
+	Scalar             tolerance,
+	Scalar             *maxError)
+{
+	bool ok = true;
+	unsigned n = tabulated->nPieces + tabulated->nBranchPieces;
+	for (unsigned i = 0; i < n; ++i) {
+		TrackShared *track = tabulated->pieces[i],
+		            *reference = exact->pieces[i];
+		if (track->type != Type_curved) {
+			continue;
+		}
+		Scalar length = Track_GetLength(track);
+		for (unsigned j = 0; j <= N_POINTS; ++j) {
+			Scalar pos = j*length/N_POINTS,
+			       coords[3],
+			       expected[3];
+			Track_GetCoords(track, coords, pos);
+			Track_GetCoords(reference, expected, pos);
+			Scalar error = hypotf(
+				coords[0] - expected[0],
+				coords[2] - expected[2]
+			);
+			Scalar size = fmaxf(fabsf(expected[0]), fabsf(expected[2]));
+			*maxError = fmaxf(*maxError, error);
+			if (error > tolerance + ROUNDING*size) {
+				fprintf(
+					stderr,
+					"Piece %u at %g: %g from arc\n",
+					i,
+					pos,
+					error
+				);
+				ok = false;
+				break;
+			}
+		}
+	}
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s LAYOUT...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	bool ok = true;
+	Scalar tolerance = g_trackSampleTolerance;
+	for (int i = 1; i < argc; ++i) {
+		// Load each layout twice, with and without sample tables
+		TrackLayout layouts[2];
+		NetworkIndex indices[2] = {{0}};
+		for (unsigned j = 0; j < 2; ++j) {
+			g_trackSampleTolerance = j ? 0 : tolerance;
+			if (!TrackLayout_LoadText(&layouts[j], argv[i])) {
+				return EXIT_FAILURE;
+			}
+			NetworkIndex_Build(&indices[j], layouts[j].head);
+		}
+		g_trackSampleTolerance = tolerance;
+
+		Scalar maxError = 0;
+		bool layoutOk = CheckLayout(
+			&indices[0],
+			&indices[1],
+			tolerance,
+			&maxError
+		);
+		printf(
+			"%s: %s, largest error %g of tolerance %g\n",
+			argv[i],
+			layoutOk ? "ok" : "FAILED",
+			maxError,
+			tolerance
+		);
+		ok = ok && layoutOk;
+		for (unsigned j = 0; j < 2; ++j) {
+			NetworkIndex_Free(&indices[j]);
+			TrackLayout_Free(&layouts[j]);
+		}
+	}
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,41 @@
+// Converts track layouts between text and binary formats, e.g. to compile
+// authored layouts for fast loading, or checks a binary layout
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "TrackLayout.h"
+
+int main(int argc, char *argv[])
+{
+	bool verify = argc == 3 && !strcmp(argv[1], "--verify"),
+	     text   = argc == 4 && !strcmp(argv[1], "--text");
+	if (!verify && argc != 3 + text) {
+		fprintf(
+			stderr,
+			"Usage: %s [--text] INPUT OUTPUT\n"
+			"       %s --verify INPUT\n",
+			argv[0],
+			argv[0]
+		);
+		return EXIT_FAILURE;
+	}
+	const char *input  = argv[1 + (text || verify)],
+	           *output = argv[2 + text];
+
+	// Check every piece of binary input, as loading only checks the header
+	TrackLayout layout;
+	if (!TrackLayout_Load(&layout, input)) {
+		return EXIT_FAILURE;
+	}
+	bool ok = TrackLayout_Verify(&layout, input);
+	if (ok && !verify) {
+		ok = text
+			? TrackLayout_SaveText(&layout, output)
+			: TrackLayout_SaveBinary(&layout, output);
+	}
+	TrackLayout_Free(&layout);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}